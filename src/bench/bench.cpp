@@ -13,7 +13,11 @@
 
 void benchmark::ConsolePrinter::header()
 {
-    std::cout << "# Benchmark, evals, iterations, total, min, max, median" << std::endl;
+    std::cout << "# Benchmark, evals, iterations, total, min, max, median";
+    if (m_cpu_hz > 0) {
+        std::cout << ", cycles/byte";
+    }
+    std::cout << std::endl;
 }
 
 void benchmark::ConsolePrinter::result(const State& state)
@@ -39,7 +43,15 @@ void benchmark::ConsolePrinter::result(const State& state)
     }
 
     std::cout << std::setprecision(6);
-    std::cout << state.m_name << ", " << state.m_num_evals << ", " << state.m_num_iters << ", " << total << ", " << front << ", " << back << ", " << median << std::endl;
+    std::cout << state.m_name << ", " << state.m_num_evals << ", " << state.m_num_iters << ", " << total << ", " << front << ", " << back << ", " << median;
+    if (m_cpu_hz > 0) {
+        if (state.m_bytes_per_iter > 0) {
+            std::cout << ", " << median * m_cpu_hz / state.m_bytes_per_iter;
+        } else {
+            std::cout << ", -";
+        }
+    }
+    std::cout << std::endl;
 }
 
 void benchmark::ConsolePrinter::footer() {}
@@ -93,7 +105,7 @@ benchmark::BenchRunner::BenchRunner(std::string name, benchmark::BenchFunction f
     benchmarks().insert(std::make_pair(name, Bench{func, num_iters_for_one_second}));
 }
 
-void benchmark::BenchRunner::RunAll(Printer& printer, uint64_t num_evals, double scaling, const std::string& filter, bool is_list_only)
+void benchmark::BenchRunner::RunAll(Printer& printer, uint64_t num_evals, double scaling, const std::string& filter, bool is_list_only, const std::vector<Variant>& variants)
 {
     if (!std::ratio_less_equal<benchmark::clock::period, std::micro>::value) {
         std::cerr << "WARNING: Clock precision is worse than microsecond - benchmarks may be less accurate!\n";
@@ -107,20 +119,26 @@ void benchmark::BenchRunner::RunAll(Printer& printer, uint64_t num_evals, double
 
     printer.header();
 
-    for (const auto& p : benchmarks()) {
-        if (!std::regex_match(p.first, baseMatch, reFilter)) {
-            continue;
-        }
-
-        uint64_t num_iters = static_cast<uint64_t>(p.second.num_iters_for_one_second * scaling);
-        if (0 == num_iters) {
-            num_iters = 1;
+    for (const auto& variant : variants) {
+        if (variant.second) {
+            variant.second();
         }
-        State state(p.first, num_evals, num_iters, printer);
-        if (!is_list_only) {
-            p.second.func(state);
+        for (const auto& p : benchmarks()) {
+            if (!std::regex_match(p.first, baseMatch, reFilter)) {
+                continue;
+            }
+
+            uint64_t num_iters = static_cast<uint64_t>(p.second.num_iters_for_one_second * scaling);
+            if (0 == num_iters) {
+                num_iters = 1;
+            }
+            std::string name = variant.first.empty() ? p.first : p.first + "[" + variant.first + "]";
+            State state(name, num_evals, num_iters, printer);
+            if (!is_list_only) {
+                p.second.func(state);
+            }
+            printer.result(state);
         }
-        printer.result(state);
     }
 
     printer.footer();
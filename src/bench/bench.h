@@ -60,6 +60,8 @@ public:
     const uint64_t m_num_evals;
     std::vector<double> m_elapsed_results;
     time_point m_start_time;
+    //! Bytes processed per iteration, set by benchmarks that measure throughput (0 if not set)
+    uint64_t m_bytes_per_iter = 0;
 
     bool UpdateTimer(time_point finish_time);
 
@@ -92,9 +94,12 @@ class BenchRunner
     static BenchmarkMap& benchmarks();
 
 public:
+    //! A named setup step; benchmarks are run once after each, with the name appended as "[name]".
+    typedef std::pair<std::string, std::function<void()>> Variant;
+
     BenchRunner(std::string name, BenchFunction func, uint64_t num_iters_for_one_second);
 
-    static void RunAll(Printer& printer, uint64_t num_evals, double scaling, const std::string& filter, bool is_list_only);
+    static void RunAll(Printer& printer, uint64_t num_evals, double scaling, const std::string& filter, bool is_list_only, const std::vector<Variant>& variants = {Variant{}});
 };
 
 // interface to output benchmark results.
@@ -108,12 +113,17 @@ public:
 };
 
 // default printer to console, shows min, max, median.
+// Given a CPU frequency, also shows median cycles/byte for benchmarks that set m_bytes_per_iter.
 class ConsolePrinter : public Printer
 {
 public:
+    explicit ConsolePrinter(double cpu_hz = 0) : m_cpu_hz(cpu_hz) {}
     void header() override;
     void result(const State& state) override;
     void footer() override;
+
+private:
+    double m_cpu_hz;
 };
 
 // creates box plot with plotly.js
@@ -4,14 +4,21 @@
 
 #include <bench/bench.h>
 
+#include <crypto/aes.h>
 #include <crypto/sha256.h>
+#include <crypto/sha512.h>
 #include <key.h>
 #include <random.h>
 #include <util/system.h>
 #include <util/strencodings.h>
 #include <validation.h>
 
+#include <map>
 #include <memory>
+#include <set>
+
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
 
 const std::function<std::string(const char*)> G_TRANSLATION_FUN = nullptr;
 
@@ -22,6 +29,33 @@ static const char* DEFAULT_BENCH_PRINTER = "console";
 static const char* DEFAULT_PLOT_PLOTLYURL = "https://cdn.plot.ly/plotly-latest.min.js";
 static const int64_t DEFAULT_PLOT_WIDTH = 1024;
 static const int64_t DEFAULT_PLOT_HEIGHT = 768;
+static const char* DEFAULT_SHA256_IMPL = "auto";
+
+/** SHA256 backend combinations tried by -sha256-impl=all, in order. */
+static const char* const ALL_SHA256_IMPLS[] = {"standard", "sse4", "sse4+avx2", "shani", "neon", "armv8"};
+
+/** Parse a '+'-separated list of SHA256 backends ("standard", "sse4", "avx2", "shani", "neon", "armv8"). */
+static bool ParseSHA256Impl(const std::string& str, sha256_implementation::UseImplementation& use_implementation)
+{
+    static const std::map<std::string, sha256_implementation::UseImplementation> names{
+        {"standard", sha256_implementation::STANDARD},
+        {"sse4", sha256_implementation::USE_SSE4},
+        {"avx2", sha256_implementation::USE_AVX2},
+        {"shani", sha256_implementation::USE_SHANI},
+        {"neon", sha256_implementation::USE_NEON},
+        {"armv8", sha256_implementation::USE_ARMV8},
+    };
+    std::vector<std::string> parts;
+    boost::split(parts, str, boost::is_any_of("+"));
+    uint8_t mask = 0;
+    for (const std::string& part : parts) {
+        auto it = names.find(part);
+        if (it == names.end()) return false;
+        mask |= it->second;
+    }
+    use_implementation = static_cast<sha256_implementation::UseImplementation>(mask);
+    return true;
+}
 
 static void SetupBenchArgs()
 {
@@ -34,6 +68,8 @@ static void SetupBenchArgs()
     gArgs.AddArg("-plot-plotlyurl=<uri>", strprintf("URL to use for plotly.js (default: %s)", DEFAULT_PLOT_PLOTLYURL), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-plot-width=<x>", strprintf("Plot width in pixel (default: %u)", DEFAULT_PLOT_WIDTH), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-plot-height=<x>", strprintf("Plot height in pixel (default: %u)", DEFAULT_PLOT_HEIGHT), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-sha256-impl=<impl>", strprintf("SHA256 backends to run the benchmarks with, comma-separated. Each is auto, all, or a '+'-separated combination of standard, sse4, avx2, shani, neon and armv8; all runs every combination available on this CPU (default: %s)", DEFAULT_SHA256_IMPL), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-cpufreq=<mhz>", "CPU clock frequency in MHz. When set, the console printer adds a cycles/byte column for throughput benchmarks", false, OptionsCategory::OPTIONS);
 
     // Hidden
     gArgs.AddArg("-h", "", false, OptionsCategory::HIDDEN);
@@ -67,6 +103,8 @@ int main(int argc, char** argv)
     const fs::path bench_datadir{SetDataDir()};
 
     SHA256AutoDetect();
+    SHA512AutoDetect();
+    AESAutoDetect();
     RandomInit();
     ECC_Start();
     SetupEnvironment();
@@ -82,7 +120,40 @@ int main(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
-    std::unique_ptr<benchmark::Printer> printer = MakeUnique<benchmark::ConsolePrinter>();
+    double cpu_mhz = 0;
+    if (gArgs.IsArgSet("-cpufreq") && (!ParseDouble(gArgs.GetArg("-cpufreq", ""), &cpu_mhz) || cpu_mhz <= 0)) {
+        fprintf(stderr, "Error parsing CPU frequency: %s\n", gArgs.GetArg("-cpufreq", "").c_str());
+        return EXIT_FAILURE;
+    }
+
+    // Resolve -sha256-impl into one benchmark variant per backend combination,
+    // skipping combinations that select the same implementation on this CPU.
+    std::vector<benchmark::BenchRunner::Variant> variants;
+    std::set<std::string> sha256_impl_names;
+    std::vector<std::string> sha256_impl_args;
+    boost::split(sha256_impl_args, gArgs.GetArg("-sha256-impl", DEFAULT_SHA256_IMPL), boost::is_any_of(","));
+    for (const std::string& arg : sha256_impl_args) {
+        std::vector<std::string> candidates{arg};
+        if (arg == "all") candidates.assign(std::begin(ALL_SHA256_IMPLS), std::end(ALL_SHA256_IMPLS));
+        for (const std::string& candidate : candidates) {
+            sha256_implementation::UseImplementation use_implementation = sha256_implementation::USE_ALL;
+            if (candidate != "auto" && !ParseSHA256Impl(candidate, use_implementation)) {
+                fprintf(stderr, "Error parsing SHA256 implementation: %s\n", candidate.c_str());
+                return EXIT_FAILURE;
+            }
+            std::string impl_name = SHA256AutoDetect(use_implementation);
+            if (sha256_impl_names.insert(impl_name).second) {
+                fprintf(stderr, "# SHA256 implementation [%s]: %s\n", candidate.c_str(), impl_name.c_str());
+                variants.emplace_back(candidate, [use_implementation] { SHA256AutoDetect(use_implementation); });
+            }
+        }
+    }
+    if (variants.size() == 1) {
+        // A single backend keeps the plain benchmark names.
+        variants[0].first.clear();
+    }
+
+    std::unique_ptr<benchmark::Printer> printer = MakeUnique<benchmark::ConsolePrinter>(cpu_mhz * 1e6);
     std::string printer_arg = gArgs.GetArg("-printer", DEFAULT_BENCH_PRINTER);
     if ("plot" == printer_arg) {
         printer.reset(new benchmark::PlotlyPrinter(
@@ -91,7 +162,7 @@ int main(int argc, char** argv)
             gArgs.GetArg("-plot-height", DEFAULT_PLOT_HEIGHT)));
     }
 
-    benchmark::BenchRunner::RunAll(*printer, evaluations, scaling_factor, regex_filter, is_list_only);
+    benchmark::BenchRunner::RunAll(*printer, evaluations, scaling_factor, regex_filter, is_list_only, variants);
 
     fs::remove_all(bench_datadir);
 
@@ -5,8 +5,10 @@
 #include <bench/bench.h>
 #include <coins.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <wallet/crypter.h>
 
+#include <unordered_map>
 #include <vector>
 
 // FIXME: Dedup with SetupDummyInputs in test/transaction_tests.cpp.
@@ -85,3 +87,81 @@ static void CCoinsCaching(benchmark::State& state)
 }
 
 BENCHMARK(CCoinsCaching, 170 * 1000);
+
+// Lookups in a UTXO cache too large for the CPU caches: half of them hit, half
+// miss. Compares CCoinsMap with the std::unordered_map it replaced.
+static const size_t COINS_MAP_ENTRIES = 500 * 1000;
+static const size_t COINS_MAP_LOOKUPS = 1000;
+
+template <typename Map>
+static void CoinsMapLookup(benchmark::State& state, Map& map)
+{
+    FastRandomContext rng(true);
+    std::vector<COutPoint> present;
+    CScript script;
+    script.assign(25, (unsigned char)OP_DUP);
+    for (size_t i = 0; i < COINS_MAP_ENTRIES; ++i) {
+        COutPoint outpoint(rng.rand256(), rng.randrange(4));
+        CCoinsCacheEntry& entry = map[outpoint];
+        entry.coin.Compress(Coin(CTxOut(i, script), 1, false));
+        entry.flags = CCoinsCacheEntry::DIRTY;
+        present.push_back(outpoint);
+    }
+    std::vector<COutPoint> lookups;
+    for (size_t i = 0; i < COINS_MAP_LOOKUPS; ++i) {
+        lookups.push_back(i % 2 ? present[rng.randrange(present.size())] : COutPoint(rng.rand256(), 0));
+    }
+
+    CAmount total = 0;
+    while (state.KeepRunning()) {
+        for (const COutPoint& outpoint : lookups) {
+            auto it = map.find(outpoint);
+            if (it != map.end()) total += it->second.flags;
+        }
+    }
+    assert(total >= 0);
+}
+
+static void CoinsMapLookupFlat(benchmark::State& state)
+{
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map(&resource);
+    CoinsMapLookup(state, map);
+}
+
+static void CoinsMapLookupNode(benchmark::State& state)
+{
+    std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> map;
+    CoinsMapLookup(state, map);
+}
+
+// Shaped like ConnectBlock: a block-sized child cache on top of a large
+// chainstate cache spends 2000 coins and creates 2000, then is flushed. The
+// new coins replace the spent ones, so the chainstate cache keeps its size.
+static void CCoinsViewCacheConnect(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    CCoinsView dummy;
+    CCoinsViewCache base(&dummy);
+    std::vector<COutPoint> present;
+    for (size_t i = 0; i < COINS_MAP_ENTRIES; ++i) {
+        COutPoint outpoint(rng.rand256(), 0);
+        base.AddCoin(outpoint, Coin(CTxOut(1, CScript() << OP_TRUE), 1, false), false);
+        present.push_back(outpoint);
+    }
+
+    while (state.KeepRunning()) {
+        CCoinsViewCache view(&base);
+        for (int i = 0; i < 2000; ++i) {
+            COutPoint& outpoint = present[rng.randrange(present.size())];
+            view.SpendCoin(outpoint);
+            outpoint = COutPoint(rng.rand256(), 0);
+            view.AddCoin(outpoint, Coin(CTxOut(1, CScript() << OP_TRUE), 2, false), false);
+        }
+        view.Flush();
+    }
+}
+
+BENCHMARK(CoinsMapLookupFlat, 5000);
+BENCHMARK(CoinsMapLookupNode, 5000);
+BENCHMARK(CCoinsViewCacheConnect, 100);
@@ -6,6 +6,7 @@
 #include <util/system.h>
 #include <validation.h>
 #include <checkqueue.h>
+#include <crypto/sha256.h>
 #include <prevector.h>
 #include <vector>
 #include <boost/thread/thread.hpp>
@@ -60,3 +61,55 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.join_all();
 }
 BENCHMARK(CCheckQueueSpeedPrevectorJob, 1400);
+
+// This Benchmark measures how the CheckQueue scales with the number of
+// threads, with checks that each hash for about as long as a signature
+// check takes, added in small batches like the inputs of a block.
+static void CCheckQueueScaling(benchmark::State& state, int threads)
+{
+    struct HashJob {
+        unsigned char data[CSHA256::OUTPUT_SIZE] = {};
+        bool operator()()
+        {
+            for (int i = 0; i < 200; ++i) {
+                CSHA256().Write(data, sizeof(data)).Finalize(data);
+            }
+            return true;
+        }
+        void swap(HashJob& x) { std::swap(data, x.data); }
+    };
+    CCheckQueue<HashJob> queue {QUEUE_BATCH_SIZE};
+    boost::thread_group tg;
+    // The master thread is one of the threads.
+    for (auto x = 1; x < threads; ++x) {
+       tg.create_thread([&]{queue.Thread();});
+    }
+    while (state.KeepRunning()) {
+        CCheckQueueControl<HashJob> control(&queue);
+        for (size_t batch = 0; batch < BATCHES; ++batch) {
+            std::vector<HashJob> vChecks(3);
+            control.Add(vChecks);
+        }
+        control.Wait();
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+static void CCheckQueueScaling1(benchmark::State& state) { CCheckQueueScaling(state, 1); }
+static void CCheckQueueScaling2(benchmark::State& state) { CCheckQueueScaling(state, 2); }
+static void CCheckQueueScaling4(benchmark::State& state) { CCheckQueueScaling(state, 4); }
+static void CCheckQueueScaling8(benchmark::State& state) { CCheckQueueScaling(state, 8); }
+static void CCheckQueueScaling16(benchmark::State& state) { CCheckQueueScaling(state, 16); }
+static void CCheckQueueScaling32(benchmark::State& state) { CCheckQueueScaling(state, 32); }
+static void CCheckQueueScaling64(benchmark::State& state) { CCheckQueueScaling(state, 64); }
+static void CCheckQueueScalingCores(benchmark::State& state) { CCheckQueueScaling(state, GetNumCores()); }
+
+BENCHMARK(CCheckQueueScaling1, 20);
+BENCHMARK(CCheckQueueScaling2, 20);
+BENCHMARK(CCheckQueueScaling4, 20);
+BENCHMARK(CCheckQueueScaling8, 20);
+BENCHMARK(CCheckQueueScaling16, 20);
+BENCHMARK(CCheckQueueScaling32, 20);
+BENCHMARK(CCheckQueueScaling64, 20);
+BENCHMARK(CCheckQueueScalingCores, 20);
@@ -10,6 +10,11 @@
 #include <random.h>
 #include <uint256.h>
 #include <util/time.h>
+#include <crypto/aes.h>
+#include <crypto/chacha20.h>
+#include <crypto/common.h>
+#include <crypto/hmac_sha512.h>
+#include <crypto/muhash.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
@@ -23,6 +28,7 @@ static void RIPEMD160(benchmark::State& state)
 {
     uint8_t hash[CRIPEMD160::OUTPUT_SIZE];
     std::vector<uint8_t> in(BUFFER_SIZE,0);
+    state.m_bytes_per_iter = BUFFER_SIZE;
     while (state.KeepRunning())
         CRIPEMD160().Write(in.data(), in.size()).Finalize(hash);
 }
@@ -31,6 +37,7 @@ static void SHA1(benchmark::State& state)
 {
     uint8_t hash[CSHA1::OUTPUT_SIZE];
     std::vector<uint8_t> in(BUFFER_SIZE,0);
+    state.m_bytes_per_iter = BUFFER_SIZE;
     while (state.KeepRunning())
         CSHA1().Write(in.data(), in.size()).Finalize(hash);
 }
@@ -39,6 +46,7 @@ static void SHA256(benchmark::State& state)
 {
     uint8_t hash[CSHA256::OUTPUT_SIZE];
     std::vector<uint8_t> in(BUFFER_SIZE,0);
+    state.m_bytes_per_iter = BUFFER_SIZE;
     while (state.KeepRunning())
         CSHA256().Write(in.data(), in.size()).Finalize(hash);
 }
@@ -46,6 +54,7 @@ static void SHA256(benchmark::State& state)
 static void SHA256_32b(benchmark::State& state)
 {
     std::vector<uint8_t> in(32,0);
+    state.m_bytes_per_iter = 32;
     while (state.KeepRunning()) {
         CSHA256()
             .Write(in.data(), in.size())
@@ -56,28 +65,139 @@ static void SHA256_32b(benchmark::State& state)
 static void SHA256D64_1024(benchmark::State& state)
 {
     std::vector<uint8_t> in(64 * 1024, 0);
+    state.m_bytes_per_iter = 64 * 1024;
     while (state.KeepRunning()) {
         SHA256D64(in.data(), in.data(), 1024);
     }
 }
 
+static void RIPEMD160_32_1024(benchmark::State& state)
+{
+    std::vector<uint8_t> in(32 * 1024, 0);
+    state.m_bytes_per_iter = 32 * 1024;
+    while (state.KeepRunning()) {
+        RIPEMD160_32(in.data(), in.data(), 1024);
+    }
+}
+
+static void Hash160_33b_1024(benchmark::State& state)
+{
+    std::vector<std::vector<uint8_t>> in(1024, std::vector<uint8_t>(33, 0x02));
+    uint160 out;
+    state.m_bytes_per_iter = 33 * 1024;
+    while (state.KeepRunning()) {
+        for (const auto& pubkey : in) {
+            out = Hash160(pubkey);
+        }
+    }
+}
+
+static void Hash160Many_33b_1024(benchmark::State& state)
+{
+    std::vector<std::vector<uint8_t>> in(1024, std::vector<uint8_t>(33, 0x02));
+    std::vector<uint160> out(in.size());
+    state.m_bytes_per_iter = 33 * 1024;
+    while (state.KeepRunning()) {
+        Hash160Many(out.data(), in.data(), in.size());
+    }
+}
+
 static void SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
     std::vector<uint8_t> in(BUFFER_SIZE,0);
+    state.m_bytes_per_iter = BUFFER_SIZE;
     while (state.KeepRunning())
         CSHA512().Write(in.data(), in.size()).Finalize(hash);
 }
 
+// Shaped like a BIP32 child key derivation: 32-byte chain code as key, 37-byte message.
+static void HMAC_SHA512_37b(benchmark::State& state)
+{
+    uint8_t hash[CHMAC_SHA512::OUTPUT_SIZE];
+    std::vector<uint8_t> key(32, 0);
+    std::vector<uint8_t> in(37, 0);
+    state.m_bytes_per_iter = 37;
+    while (state.KeepRunning()) {
+        CHMAC_SHA512(key.data(), key.size()).Write(in.data(), in.size()).Finalize(hash);
+        key[0] = hash[0];
+    }
+}
+
 static void SipHash_32b(benchmark::State& state)
 {
     uint256 x;
     uint64_t k1 = 0;
+    state.m_bytes_per_iter = 32;
     while (state.KeepRunning()) {
         *((uint64_t*)x.begin()) = SipHashUint256(0, ++k1, x);
     }
 }
 
+static void SipHashExtraMany_32b_1024(benchmark::State& state)
+{
+    std::vector<uint256> vals(1024);
+    std::vector<const uint256*> ptrs;
+    std::vector<uint32_t> extras(vals.size());
+    for (size_t i = 0; i < vals.size(); ++i) {
+        *((uint64_t*)vals[i].begin()) = i;
+        ptrs.push_back(&vals[i]);
+    }
+    std::vector<uint64_t> out(vals.size());
+    uint64_t k1 = 0;
+    state.m_bytes_per_iter = 36 * 1024;
+    while (state.KeepRunning()) {
+        SipHashUint256ExtraMany(0, ++k1, ptrs.data(), extras.data(), out.data(), out.size());
+    }
+}
+
+static void AES256CBCDecrypt_48b(benchmark::State& state)
+{
+    // The size of an encrypted wallet private key.
+    uint8_t key[AES256_KEYSIZE] = {0};
+    uint8_t iv[AES_BLOCKSIZE] = {0};
+    std::vector<uint8_t> in(48, 0), out(48);
+    state.m_bytes_per_iter = 48;
+    while (state.KeepRunning()) {
+        AES256CBCDecrypt dec(key, iv, false);
+        dec.Decrypt(in.data(), in.size(), out.data());
+    }
+}
+
+static void CHACHA20_1MB(benchmark::State& state)
+{
+    uint8_t key[32] = {0};
+    ChaCha20 ctx(key, 32);
+    std::vector<uint8_t> out(1024 * 1024);
+    state.m_bytes_per_iter = 1024 * 1024;
+    while (state.KeepRunning()) {
+        ctx.Output(out.data(), out.size());
+    }
+}
+
+// Adding one coin to a MuHash, as the coin statistics index does per output.
+static void MuHash_Insert(benchmark::State& state)
+{
+    MuHash3072 acc;
+    unsigned char key[45] = {0};
+    uint32_t i = 0;
+    while (state.KeepRunning()) {
+        WriteLE32(key, i++);
+        acc.Insert(key, sizeof(key));
+    }
+}
+
+static void MuHash_Finalize(benchmark::State& state)
+{
+    MuHash3072 acc;
+    unsigned char key[45] = {0};
+    acc.Remove(key, sizeof(key));
+    uint256 out;
+    while (state.KeepRunning()) {
+        acc.Finalize(out.begin());
+    }
+}
+
 static void FastRandom_32bit(benchmark::State& state)
 {
     FastRandomContext rng(true);
@@ -94,13 +214,40 @@ static void FastRandom_1bit(benchmark::State& state)
     }
 }
 
+static void FastRandom_64bit(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    while (state.KeepRunning()) {
+        rng.rand64();
+    }
+}
+
+static void FastRandom_randrange(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    while (state.KeepRunning()) {
+        rng.randrange(1000);
+    }
+}
+
 BENCHMARK(RIPEMD160, 440);
 BENCHMARK(SHA1, 570);
 BENCHMARK(SHA256, 340);
 BENCHMARK(SHA512, 330);
+BENCHMARK(HMAC_SHA512_37b, 900 * 1000);
 
 BENCHMARK(SHA256_32b, 4700 * 1000);
 BENCHMARK(SipHash_32b, 40 * 1000 * 1000);
+BENCHMARK(SipHashExtraMany_32b_1024, 40 * 1000);
 BENCHMARK(SHA256D64_1024, 7400);
+BENCHMARK(RIPEMD160_32_1024, 7400);
+BENCHMARK(Hash160_33b_1024, 2000);
+BENCHMARK(Hash160Many_33b_1024, 2000);
 BENCHMARK(FastRandom_32bit, 110 * 1000 * 1000);
 BENCHMARK(FastRandom_1bit, 440 * 1000 * 1000);
+BENCHMARK(FastRandom_64bit, 50 * 1000 * 1000);
+BENCHMARK(FastRandom_randrange, 40 * 1000 * 1000);
+BENCHMARK(CHACHA20_1MB, 340);
+BENCHMARK(AES256CBCDecrypt_48b, 50 * 1000);
+BENCHMARK(MuHash_Insert, 20 * 1000);
+BENCHMARK(MuHash_Finalize, 10);
@@ -0,0 +1,110 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <dbwrapper.h>
+#include <fs.h>
+#include <random.h>
+#include <uint256.h>
+#include <util/system.h>
+
+#include <utility>
+#include <vector>
+
+// Keys and values shaped roughly like those of the chainstate.
+static const size_t NUM_ENTRIES = 100000;
+static const size_t OPS_PER_ITERATION = 1000;
+
+static std::pair<char, uint256> Key(FastRandomContext& rng)
+{
+    return std::make_pair('C', rng.rand256());
+}
+
+static std::vector<unsigned char> Value(FastRandomContext& rng)
+{
+    return rng.randbytes(40);
+}
+
+static void Fill(CDBWrapper& db, FastRandomContext& rng, std::vector<std::pair<char, uint256>>& keys)
+{
+    CDBBatch batch(db);
+    for (size_t i = 0; i < NUM_ENTRIES; ++i) {
+        keys.push_back(Key(rng));
+        batch.Write(keys.back(), Value(rng));
+        if (batch.SizeEstimate() > (1 << 20)) {
+            db.WriteBatch(batch);
+            batch.Clear();
+        }
+    }
+    db.WriteBatch(batch);
+}
+
+// A database in the benchmark's temporary datadir, as the profiles mostly
+// differ in how they use the disk.
+static fs::path DBPath(const std::string& profile)
+{
+    return GetDataDir(false) / "dbbench" / profile;
+}
+
+// Point lookups, half of them for keys that are not in the database, like
+// the coin lookups of block validation.
+static void DBRandomRead(benchmark::State& state, const std::string& profile)
+{
+    DBTuning tuning;
+    bool found = GetDBProfile(profile, tuning);
+    assert(found);
+    {
+        CDBWrapper db(DBPath(profile), 8 << 20, false, true, false, tuning);
+        FastRandomContext rng(true);
+        std::vector<std::pair<char, uint256>> keys;
+        Fill(db, rng, keys);
+
+        std::vector<unsigned char> value;
+        while (state.KeepRunning()) {
+            for (size_t i = 0; i < OPS_PER_ITERATION; ++i) {
+                if (i % 2) {
+                    db.Read(keys[rng.randrange(keys.size())], value);
+                } else {
+                    db.Read(Key(rng), value);
+                }
+            }
+        }
+    }
+    fs::remove_all(DBPath(profile));
+}
+
+// Batches of new entries, like the flushes of the coins cache.
+static void DBBatchWrite(benchmark::State& state, const std::string& profile)
+{
+    DBTuning tuning;
+    bool found = GetDBProfile(profile, tuning);
+    assert(found);
+    {
+        CDBWrapper db(DBPath(profile), 8 << 20, false, true, false, tuning);
+        FastRandomContext rng(true);
+
+        while (state.KeepRunning()) {
+            CDBBatch batch(db);
+            for (size_t i = 0; i < OPS_PER_ITERATION; ++i) {
+                batch.Write(Key(rng), Value(rng));
+            }
+            db.WriteBatch(batch);
+        }
+    }
+    fs::remove_all(DBPath(profile));
+}
+
+static void DBRandomReadDefault(benchmark::State& state) { DBRandomRead(state, "default"); }
+static void DBRandomReadRandomRead(benchmark::State& state) { DBRandomRead(state, "randomread"); }
+static void DBRandomReadBulkWrite(benchmark::State& state) { DBRandomRead(state, "bulkwrite"); }
+static void DBBatchWriteDefault(benchmark::State& state) { DBBatchWrite(state, "default"); }
+static void DBBatchWriteRandomRead(benchmark::State& state) { DBBatchWrite(state, "randomread"); }
+static void DBBatchWriteBulkWrite(benchmark::State& state) { DBBatchWrite(state, "bulkwrite"); }
+
+BENCHMARK(DBRandomReadDefault, 300);
+BENCHMARK(DBRandomReadRandomRead, 300);
+BENCHMARK(DBRandomReadBulkWrite, 300);
+BENCHMARK(DBBatchWriteDefault, 200);
+BENCHMARK(DBBatchWriteRandomRead, 200);
+BENCHMARK(DBBatchWriteBulkWrite, 200);
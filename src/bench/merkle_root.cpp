@@ -8,11 +8,11 @@
 #include <random.h>
 #include <consensus/merkle.h>
 
-static void MerkleRoot(benchmark::State& state)
+static void MerkleRootLeaves(benchmark::State& state, size_t num_leaves)
 {
     FastRandomContext rng(true);
     std::vector<uint256> leaves;
-    leaves.resize(9001);
+    leaves.resize(num_leaves);
     for (auto& item : leaves) {
         item = rng.rand256();
     }
@@ -23,4 +23,24 @@ static void MerkleRoot(benchmark::State& state)
     }
 }
 
+static void MerkleRoot(benchmark::State& state)
+{
+    MerkleRootLeaves(state, 9001);
+}
+
+// Roughly the transaction count of a full block; every tree level is hashed
+// through SHA256D64, so this tracks the multi-lane SHA256D64 kernels directly.
+static void MerkleRoot_2k(benchmark::State& state)
+{
+    MerkleRootLeaves(state, 2000);
+}
+
+// Small trees only ever fill the narrow lanes and the 1-way tail.
+static void MerkleRoot_20(benchmark::State& state)
+{
+    MerkleRootLeaves(state, 20);
+}
+
 BENCHMARK(MerkleRoot, 800);
+BENCHMARK(MerkleRoot_2k, 3600);
+BENCHMARK(MerkleRoot_20, 360 * 1000);
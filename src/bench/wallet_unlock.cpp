@@ -0,0 +1,57 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <key.h>
+#include <random.h>
+#include <wallet/crypter.h>
+
+#include <assert.h>
+
+namespace {
+
+class UnlockBenchKeyStore : public CCryptoKeyStore
+{
+public:
+    using CCryptoKeyStore::EncryptKeys;
+    using CCryptoKeyStore::Unlock;
+
+    void CopyCryptedKeys(const UnlockBenchKeyStore& other)
+    {
+        LOCK2(cs_KeyStore, other.cs_KeyStore);
+        mapCryptedKeys = other.mapCryptedKeys;
+    }
+};
+
+} // namespace
+
+// Unlock a key store holding 100k encrypted keys, as CWallet::Unlock does for
+// a large encrypted wallet. The first unlock of a key store decrypts and
+// verifies every key, so each iteration uses a fresh copy.
+static void WalletUnlock_100k(benchmark::State& state)
+{
+    static const int NUM_KEYS = 100 * 1000;
+
+    CKeyingMaterial master_key(32);
+    GetStrongRandBytes(master_key.data(), master_key.size());
+
+    UnlockBenchKeyStore keystore;
+    for (int i = 0; i < NUM_KEYS; ++i) {
+        CKey key;
+        key.MakeNewKey(true);
+        bool added = keystore.AddKeyPubKey(key, key.GetPubKey());
+        assert(added);
+    }
+    bool encrypted = keystore.EncryptKeys(master_key);
+    assert(encrypted);
+
+    while (state.KeepRunning()) {
+        UnlockBenchKeyStore unlock;
+        unlock.CopyCryptedKeys(keystore);
+        bool unlocked = unlock.Unlock(master_key);
+        assert(unlocked);
+    }
+}
+
+BENCHMARK(WalletUnlock_100k, 1);
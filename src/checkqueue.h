@@ -8,6 +8,9 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -16,6 +19,9 @@
 template <typename T>
 class CCheckQueueControl;
 
+/** Default maximum number of threads (including the master) with their own queue */
+static const unsigned int DEFAULT_CHECKQUEUE_WORKERS = 256;
+
 /**
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
@@ -25,12 +31,27 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every thread has its own queue of verifications, which the master fills
+  * in turn. A thread takes work from its own queue first and steals from
+  * the others when it runs dry, so threads only contend for a queue lock
+  * when stealing. The shared mutex is only taken to put idle threads to
+  * sleep and to wake them up.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! The verifications queued for one thread.
+    struct WorkerQueue {
+        std::mutex mutex;
+        //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
+        std::vector<T> checks;
+        //! Size of checks, readable without the lock to skip empty queues
+        std::atomic<size_t> size{0};
+    };
+
+    //! Mutex to put idle threads to sleep and wake them up
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,87 +60,115 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! One queue per thread. The master uses the first one.
+    const std::unique_ptr<WorkerQueue[]> queues;
+    const unsigned int nMaxWorkers;
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
+    //! The number of worker threads (excluding the master) that took a queue.
+    std::atomic<unsigned int> nWorkers{0};
 
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! Queue the master adds the next batch to. Only used by the master.
+    unsigned int nNextQueue{0};
+
+    //! The number of workers (including the master) that are idle.
+    std::atomic<int> nIdle{0};
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk{true};
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo{0};
+
+    //! Number of verifications in the queues, not yet taken by a thread.
+    std::atomic<size_t> nQueued{0};
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! Number of queues in use: the master's and the registered workers'.
+    unsigned int ActiveQueues() const
+    {
+        return std::min(nMaxWorkers, nWorkers.load() + 1);
+    }
+
+    /**
+     * Move a batch of verifications into vChecks, from queue nSelf if it has
+     * any and from another thread's queue otherwise.
+     */
+    bool Take(unsigned int nSelf, std::vector<T>& vChecks)
+    {
+        const unsigned int nQueues = ActiveQueues();
+        for (unsigned int i = 0; i < nQueues; i++) {
+            WorkerQueue& q = queues[(nSelf + i) % nQueues];
+            if (q.size.load(std::memory_order_relaxed) == 0) continue;
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.checks.empty()) continue;
+            // Take half of the queue, so that a thief leaves work for the
+            // owner and the owner leaves work for thieves, but no more than
+            // nBatchSize at once.
+            const size_t nNow = std::max<size_t>(1, std::min<size_t>(nBatchSize, q.checks.size() / 2));
+            vChecks.resize(nNow);
+            for (size_t j = 0; j < nNow; j++) {
+                // Swap jobs instead of copying them.
+                vChecks[j].swap(q.checks.back());
+                q.checks.pop_back();
+            }
+            q.size.store(q.checks.size(), std::memory_order_relaxed);
+            nQueued -= nNow;
+            return true;
+        }
+        return false;
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
+        // Workers beyond nMaxWorkers share a queue with another worker.
+        unsigned int nSelf = 0;
+        if (!fMaster) {
+            const unsigned int nWorker = nWorkers++;
+            if (nMaxWorkers > 1) nSelf = 1 + nWorker % (nMaxWorkers - 1);
+        }
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
         do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if (fMaster && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
-                    }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
-                }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
+            if (Take(nSelf, vChecks)) {
+                const unsigned int nNow = vChecks.size();
                 // Check whether we need to do work at all
-                fOk = fAllOk;
+                bool fOk = fAllOk.load(std::memory_order_relaxed);
+                // execute work
+                for (T& check : vChecks)
+                    if (fOk)
+                        fOk = check();
+                // The checks must be destroyed before the master can return.
+                vChecks.clear();
+                if (!fOk) fAllOk = false;
+                if (nTodo.fetch_sub(nNow) == nNow && !fMaster) {
+                    // We processed the last element; inform the master it can exit and return the result
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    condMaster.notify_one();
+                }
+                continue;
+            }
+            if (fMaster && nTodo == 0) {
+                // return the current status, and reset it for new work later
+                return fAllOk.exchange(true);
             }
-            // execute work
-            for (T& check : vChecks)
-                if (fOk)
-                    fOk = check();
-            vChecks.clear();
+            boost::unique_lock<boost::mutex> lock(mutex);
+            // Adding work reads nIdle after updating nQueued, so either the
+            // check below sees the work or the adder sees this thread idle
+            // and notifies it under the mutex.
+            nIdle++;
+            if (fMaster) {
+                while (nTodo != 0 && nQueued == 0) condMaster.wait(lock);
+            } else {
+                while (nQueued == 0) condWorker.wait(lock);
+            }
+            nIdle--;
         } while (true);
     }
 
@@ -127,8 +176,9 @@ public:
     //! Mutex to ensure only one concurrent CCheckQueueControl
     boost::mutex ControlMutex;
 
-    //! Create a new check queue
-    explicit CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn) {}
+    //! Create a new check queue, for up to nMaxWorkersIn threads (including the master)
+    explicit CCheckQueue(unsigned int nBatchSizeIn, unsigned int nMaxWorkersIn = DEFAULT_CHECKQUEUE_WORKERS)
+        : queues(new WorkerQueue[std::max(1U, nMaxWorkersIn)]), nMaxWorkers(std::max(1U, nMaxWorkersIn)), nBatchSize(nBatchSizeIn) {}
 
     //! Worker thread
     void Thread()
@@ -145,16 +195,30 @@ public:
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
+        if (vChecks.empty()) return;
+        const size_t nAdd = vChecks.size();
+        nTodo += nAdd;
+        // Hand the batches to the workers in turn. Without workers the master
+        // keeps them.
+        const unsigned int nQueues = ActiveQueues();
+        WorkerQueue& q = queues[nQueues > 1 ? 1 + nNextQueue++ % (nQueues - 1) : 0];
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+            for (T& check : vChecks) {
+                q.checks.push_back(T());
+                check.swap(q.checks.back());
+            }
+            q.size.store(q.checks.size(), std::memory_order_relaxed);
+            nQueued += nAdd;
+        }
+        const int nSleeping = nIdle;
+        if (nSleeping > 0) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (nAdd == 1)
+                condWorker.notify_one();
+            else
+                condWorker.notify_all();
         }
-        nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
     }
 
     ~CCheckQueue()
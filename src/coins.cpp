@@ -8,11 +8,115 @@
 #include <random.h>
 #include <version.h>
 
+#include <algorithm>
+#include <ios>
+
+#include <string.h>
+
+namespace {
+
+/** Minimal stream appending to a prevector, to serialize a Coin into a CompressedCoin. */
+template <typename Data>
+class PrevectorWriter
+{
+    Data& m_data;
+
+public:
+    explicit PrevectorWriter(Data& data) : m_data(data) {}
+
+    void write(const char* pch, size_t size)
+    {
+        m_data.insert(m_data.end(), (const unsigned char*)pch, (const unsigned char*)pch + size);
+    }
+
+    template <typename T>
+    PrevectorWriter& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj);
+        return *this;
+    }
+
+    int GetVersion() const { return PROTOCOL_VERSION; }
+    int GetType() const { return SER_DISK; }
+};
+
+/** Minimal stream reading from a byte range, to expand a CompressedCoin. */
+class SpanReader
+{
+    const unsigned char* m_pos;
+    const unsigned char* const m_end;
+
+public:
+    SpanReader(const unsigned char* begin, const unsigned char* end) : m_pos(begin), m_end(end) {}
+
+    void read(char* dst, size_t size)
+    {
+        if (size > (size_t)(m_end - m_pos)) {
+            throw std::ios_base::failure("SpanReader::read(): end of data");
+        }
+        memcpy(dst, m_pos, size);
+        m_pos += size;
+    }
+
+    void ignore(size_t size)
+    {
+        if (size > (size_t)(m_end - m_pos)) {
+            throw std::ios_base::failure("SpanReader::ignore(): end of data");
+        }
+        m_pos += size;
+    }
+
+    template <typename T>
+    SpanReader& operator>>(T&& obj)
+    {
+        ::Unserialize(*this, obj);
+        return *this;
+    }
+
+    int GetVersion() const { return PROTOCOL_VERSION; }
+    int GetType() const { return SER_DISK; }
+};
+
+} // namespace
+
+void CompressedCoin::Compress(const Coin& coin)
+{
+    Clear();
+    if (coin.IsSpent()) return;
+    PrevectorWriter<decltype(m_data)> writer(m_data);
+    coin.Serialize(writer);
+}
+
+Coin CompressedCoin::Expand() const
+{
+    Coin coin;
+    if (!IsSpent()) {
+        SpanReader reader(m_data.data(), m_data.data() + m_data.size());
+        coin.Unserialize(reader);
+    }
+    return coin;
+}
+
 bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const { return false; }
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
 std::vector<uint256> CCoinsView::GetHeadBlocks() const { return std::vector<uint256>(); }
 bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return false; }
 CCoinsViewCursor *CCoinsView::Cursor() const { return nullptr; }
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsView::RangeCursors(size_t num_ranges) const
+{
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    std::unique_ptr<CCoinsViewCursor> cursor(Cursor());
+    if (cursor) cursors.push_back(std::move(cursor));
+    return cursors;
+}
+
+void CCoinsView::GetCoins(const std::vector<COutPoint>& outpoints, std::vector<Coin>& coins) const
+{
+    coins.resize(outpoints.size());
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        if (!GetCoin(outpoints[i], coins[i])) coins[i].Clear();
+    }
+}
 
 bool CCoinsView::HaveCoin(const COutPoint &outpoint) const
 {
@@ -28,11 +132,37 @@ std::vector<uint256> CCoinsViewBacked::GetHeadBlocks() const { return base->GetH
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
 bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return base->BatchWrite(mapCoins, hashBlock); }
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsViewBacked::RangeCursors(size_t num_ranges) const { return base->RangeCursors(num_ranges); }
 size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+void SaltedOutpointHasher::HashMany(const COutPoint* const* ids, size_t* out, size_t count) const
+{
+    static const size_t BATCH_SIZE = 64;
+    const uint256* hashes[BATCH_SIZE];
+    uint32_t ns[BATCH_SIZE];
+    uint64_t result[BATCH_SIZE];
+    while (count) {
+        size_t n = std::min(count, BATCH_SIZE);
+        for (size_t i = 0; i < n; ++i) {
+            hashes[i] = &ids[i]->hash;
+            ns[i] = ids[i]->n;
+        }
+        SipHashUint256ExtraMany(k0, k1, hashes, ns, result, n);
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = result[i];
+        }
+        ids += n;
+        out += n;
+        count -= n;
+    }
+}
+
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) :
+    CCoinsViewBacked(baseIn),
+    cacheCoins(&m_cache_coins_memory_resource),
+    cachedCoinsUsage(0) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
     return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
@@ -45,7 +175,7 @@ CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const
     Coin tmp;
     if (!base->GetCoin(outpoint, tmp))
         return cacheCoins.end();
-    CCoinsMap::iterator ret = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(tmp))).first;
+    CCoinsMap::iterator ret = cacheCoins.try_emplace(outpoint, tmp).first;
     if (ret->second.coin.IsSpent()) {
         // The parent only has an empty entry for this outpoint; we can consider our
         // version as fresh.
@@ -58,7 +188,7 @@ CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const
 bool CCoinsViewCache::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     CCoinsMap::const_iterator it = FetchCoin(outpoint);
     if (it != cacheCoins.end()) {
-        coin = it->second.coin;
+        coin = it->second.coin.Expand();
         return !coin.IsSpent();
     }
     return false;
@@ -69,7 +199,7 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possi
     if (coin.out.scriptPubKey.IsUnspendable()) return;
     CCoinsMap::iterator it;
     bool inserted;
-    std::tie(it, inserted) = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::tuple<>());
+    std::tie(it, inserted) = cacheCoins.try_emplace(outpoint);
     bool fresh = false;
     if (!inserted) {
         cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
@@ -80,11 +210,20 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possi
         }
         fresh = !(it->second.flags & CCoinsCacheEntry::DIRTY);
     }
-    it->second.coin = std::move(coin);
+    it->second.coin.Compress(coin);
     it->second.flags |= CCoinsCacheEntry::DIRTY | (fresh ? CCoinsCacheEntry::FRESH : 0);
     cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
 }
 
+void CCoinsViewCache::GetCoins(const std::vector<COutPoint>& outpoints, std::vector<Coin>& coins) const
+{
+    Prefetch(outpoints);
+    coins.resize(outpoints.size());
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        coins[i] = AccessCoin(outpoints[i]);
+    }
+}
+
 void AddCoins(CCoinsViewCache& cache, const CTransaction &tx, int nHeight, bool check) {
     bool fCoinbase = tx.IsCoinBase();
     const uint256& txid = tx.GetHash();
@@ -101,7 +240,7 @@ bool CCoinsViewCache::SpendCoin(const COutPoint &outpoint, Coin* moveout) {
     if (it == cacheCoins.end()) return false;
     cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
     if (moveout) {
-        *moveout = std::move(it->second.coin);
+        *moveout = it->second.coin.Expand();
     }
     if (it->second.flags & CCoinsCacheEntry::FRESH) {
         cacheCoins.erase(it);
@@ -112,14 +251,12 @@ bool CCoinsViewCache::SpendCoin(const COutPoint &outpoint, Coin* moveout) {
     return true;
 }
 
-static const Coin coinEmpty;
-
-const Coin& CCoinsViewCache::AccessCoin(const COutPoint &outpoint) const {
+Coin CCoinsViewCache::AccessCoin(const COutPoint &outpoint) const {
     CCoinsMap::const_iterator it = FetchCoin(outpoint);
     if (it == cacheCoins.end()) {
-        return coinEmpty;
+        return Coin();
     } else {
-        return it->second.coin;
+        return it->second.coin.Expand();
     }
 }
 
@@ -133,6 +270,13 @@ bool CCoinsViewCache::HaveCoinInCache(const COutPoint &outpoint) const {
     return (it != cacheCoins.end() && !it->second.coin.IsSpent());
 }
 
+bool CCoinsViewCache::GetCoinInCache(const COutPoint &outpoint, Coin &coin) const {
+    CCoinsMap::const_iterator it = cacheCoins.find(outpoint);
+    if (it == cacheCoins.end() || it->second.coin.IsSpent()) return false;
+    coin = it->second.coin.Expand();
+    return true;
+}
+
 uint256 CCoinsViewCache::GetBestBlock() const {
     if (hashBlock.IsNull())
         hashBlock = base->GetBestBlock();
@@ -203,11 +347,45 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
 
 bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
-    cacheCoins.clear();
-    cachedCoinsUsage = 0;
+    ReallocateCache();
     return fOk;
 }
 
+bool CCoinsViewCache::Sync()
+{
+    // The base consumes the map it is given, so hand it copies of the dirty
+    // entries and clean up our own copies afterwards.
+    CCoinsMapMemoryResource resource;
+    CCoinsMap dirty_coins(&resource);
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end();) {
+        if (!(it->second.flags & CCoinsCacheEntry::DIRTY)) {
+            ++it;
+            continue;
+        }
+        CCoinsCacheEntry& entry = dirty_coins[it->first];
+        entry.flags = it->second.flags;
+        if (it->second.coin.IsSpent()) {
+            cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+            it = cacheCoins.erase(it);
+        } else {
+            entry.coin = it->second.coin;
+            it->second.flags = 0;
+            ++it;
+        }
+    }
+    return base->BatchWrite(dirty_coins, hashBlock);
+}
+
+void CCoinsViewCache::ReallocateCache()
+{
+    // The map must be destroyed before its memory resource, and rebuilt after it.
+    cacheCoins.~CCoinsMap();
+    m_cache_coins_memory_resource.~CCoinsMapMemoryResource();
+    ::new (&m_cache_coins_memory_resource) CCoinsMapMemoryResource();
+    ::new (&cacheCoins) CCoinsMap(&m_cache_coins_memory_resource);
+    cachedCoinsUsage = 0;
+}
+
 void CCoinsViewCache::Uncache(const COutPoint& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
@@ -245,16 +423,55 @@ bool CCoinsViewCache::HaveInputs(const CTransaction& tx) const
     return true;
 }
 
+void CCoinsViewCache::Prefetch(const std::vector<COutPoint>& outpoints) const
+{
+    std::vector<const COutPoint*> ids;
+    ids.reserve(outpoints.size());
+    for (const COutPoint& outpoint : outpoints) {
+        ids.push_back(&outpoint);
+    }
+    std::vector<size_t> hashes(ids.size());
+    cacheCoins.hash_function().HashMany(ids.data(), hashes.data(), ids.size());
+
+    // Start loading the index entries for all outpoints before probing any.
+    for (size_t hash : hashes) {
+        cacheCoins.PrefetchHash(hash);
+    }
+    std::vector<COutPoint> missing;
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        if (cacheCoins.find(outpoints[i], hashes[i]) == cacheCoins.end()) {
+            missing.push_back(outpoints[i]);
+        }
+    }
+    if (missing.empty()) return;
+
+    std::vector<Coin> coins;
+    base->GetCoins(missing, coins);
+    ImportCoins(missing, coins);
+}
+
+void CCoinsViewCache::ImportCoins(const std::vector<COutPoint>& outpoints, const std::vector<Coin>& coins) const
+{
+    assert(outpoints.size() == coins.size());
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        if (coins[i].IsSpent()) continue;
+        CCoinsMap::iterator it;
+        bool inserted;
+        std::tie(it, inserted) = cacheCoins.try_emplace(outpoints[i], coins[i]);
+        if (inserted) cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+    }
+}
+
 static const size_t MIN_TRANSACTION_OUTPUT_WEIGHT = WITNESS_SCALE_FACTOR * ::GetSerializeSize(CTxOut(), PROTOCOL_VERSION);
 static const size_t MAX_OUTPUTS_PER_BLOCK = MAX_BLOCK_WEIGHT / MIN_TRANSACTION_OUTPUT_WEIGHT;
 
-const Coin& AccessByTxid(const CCoinsViewCache& view, const uint256& txid)
+Coin AccessByTxid(const CCoinsViewCache& view, const uint256& txid)
 {
     COutPoint iter(txid, 0);
     while (iter.n < MAX_OUTPUTS_PER_BLOCK) {
-        const Coin& alternate = view.AccessCoin(iter);
+        Coin alternate = view.AccessCoin(iter);
         if (!alternate.IsSpent()) return alternate;
         ++iter.n;
     }
-    return coinEmpty;
+    return Coin();
 }
@@ -10,14 +10,18 @@
 #include <compressor.h>
 #include <core_memusage.h>
 #include <crypto/siphash.h>
+#include <flatnodemap.h>
 #include <memusage.h>
+#include <prevector.h>
 #include <serialize.h>
 #include <uint256.h>
 
 #include <assert.h>
 #include <stdint.h>
 
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 /**
  * A UTXO entry.
@@ -81,6 +85,50 @@ public:
     }
 };
 
+/**
+ * A Coin kept in its serialized form (see Coin), which compresses the amount
+ * and the common script templates. This is how CCoinsViewCache stores coins,
+ * so that more of them fit into a given amount of memory; they are expanded
+ * into a Coin when accessed. It serializes exactly like the Coin it holds,
+ * without having to recompress it. An empty CompressedCoin is a spent coin.
+ */
+class CompressedCoin
+{
+    //! Serialized Coin. P2PKH, P2SH and P2WPKH outputs are stored inline;
+    //! larger ones (P2PK, P2WSH, ...) need an allocation, like in CScript.
+    prevector<39, unsigned char> m_data;
+
+public:
+    CompressedCoin() {}
+    explicit CompressedCoin(const Coin& coin) { Compress(coin); }
+
+    //! Replace the stored coin. A spent coin clears it.
+    void Compress(const Coin& coin);
+
+    //! Return the stored coin, or a spent one if empty.
+    Coin Expand() const;
+
+    bool IsSpent() const {
+        return m_data.empty();
+    }
+
+    void Clear() {
+        // The default prevector::clear() does not release memory
+        m_data.clear();
+        m_data.shrink_to_fit();
+    }
+
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        assert(!IsSpent());
+        s.write((const char*)m_data.data(), m_data.size());
+    }
+
+    size_t DynamicMemoryUsage() const {
+        return memusage::DynamicUsage(m_data);
+    }
+};
+
 class SaltedOutpointHasher
 {
 private:
@@ -98,11 +146,13 @@ public:
     size_t operator()(const COutPoint& id) const {
         return SipHashUint256Extra(k0, k1, id.hash, id.n);
     }
+    /** Hash count outpoints at once: out[i] = (*this)(*ids[i]). */
+    void HashMany(const COutPoint* const* ids, size_t* out, size_t count) const;
 };
 
 struct CCoinsCacheEntry
 {
-    Coin coin; // The actual cached data.
+    CompressedCoin coin; // The actual cached data.
     unsigned char flags;
 
     enum Flags {
@@ -116,10 +166,12 @@ struct CCoinsCacheEntry
     };
 
     CCoinsCacheEntry() : flags(0) {}
-    explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
+    explicit CCoinsCacheEntry(const Coin& coin_) : coin(coin_), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+typedef FlatNodeMap<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+
+typedef CCoinsMap::ResourceType CCoinsMapMemoryResource;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -141,6 +193,21 @@ private:
     uint256 hashBlock;
 };
 
+/** Number of distinct txid prefixes by which CCoinsView::RangeCursors() partitions the coins. */
+static const uint32_t COINS_RANGE_PREFIXES = 0x10000;
+
+/** The prefix of a txid used to partition the coins: its first two bytes as stored, big endian. */
+inline uint32_t CoinsRangePrefix(const uint256& txid)
+{
+    return 0x100 * *txid.begin() + *(txid.begin() + 1);
+}
+
+/** The first prefix of range i when the coins are split into num_ranges ranges. */
+inline uint32_t CoinsRangeBegin(size_t i, size_t num_ranges)
+{
+    return (uint32_t)(uint64_t{COINS_RANGE_PREFIXES} * i / num_ranges);
+}
+
 /** Abstract view on the open txout dataset. */
 class CCoinsView
 {
@@ -151,6 +218,12 @@ public:
      */
     virtual bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
 
+    /** Retrieve the Coins for many outpoints at once. coins is resized to the
+     *  number of outpoints; those without an unspent coin get a spent one.
+     *  Views that can look up several coins concurrently override this.
+     */
+    virtual void GetCoins(const std::vector<COutPoint>& outpoints, std::vector<Coin>& coins) const;
+
     //! Just check whether a given outpoint is unspent.
     virtual bool HaveCoin(const COutPoint &outpoint) const;
 
@@ -170,6 +243,13 @@ public:
     //! Get a cursor to iterate over the whole state
     virtual CCoinsViewCursor *Cursor() const;
 
+    //! Get cursors over disjoint ranges of the state that can be iterated
+    //! concurrently. Cursor i of the n returned covers the coins whose txid
+    //! prefix lies in [CoinsRangeBegin(i, n), CoinsRangeBegin(i + 1, n)), and
+    //! all of them see the same state. Views that cannot split their state
+    //! return a single cursor over all of it, or none if Cursor() returns none.
+    virtual std::vector<std::unique_ptr<CCoinsViewCursor>> RangeCursors(size_t num_ranges) const;
+
     //! As we use CCoinsViews polymorphically, have a virtual destructor
     virtual ~CCoinsView() {}
 
@@ -179,6 +259,11 @@ public:
 
 
 /** CCoinsView backed by another CCoinsView */
+/**
+ * CCoinsView that forwards to another one. GetCoins() is deliberately not
+ * forwarded, as subclasses that override GetCoin() (like the mempool view)
+ * must see every lookup.
+ */
 class CCoinsViewBacked : public CCoinsView
 {
 protected:
@@ -193,6 +278,7 @@ public:
     void SetBackend(CCoinsView &viewIn);
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
+    std::vector<std::unique_ptr<CCoinsViewCursor>> RangeCursors(size_t num_ranges) const override;
     size_t EstimateSize() const override;
 };
 
@@ -206,6 +292,8 @@ protected:
      * declared as "const".
      */
     mutable uint256 hashBlock;
+    /* Backs the nodes of cacheCoins; must be declared before it. */
+    mutable CCoinsMapMemoryResource m_cache_coins_memory_resource;
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
@@ -221,6 +309,7 @@ public:
 
     // Standard CCoinsView methods
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    void GetCoins(const std::vector<COutPoint>& outpoints, std::vector<Coin>& coins) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     void SetBestBlock(const uint256 &hashBlock);
@@ -228,6 +317,9 @@ public:
     CCoinsViewCursor* Cursor() const override {
         throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
     }
+    std::vector<std::unique_ptr<CCoinsViewCursor>> RangeCursors(size_t num_ranges) const override {
+        throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
+    }
 
     /**
      * Check if we have the given utxo already loaded in this cache.
@@ -237,16 +329,22 @@ public:
     bool HaveCoinInCache(const COutPoint &outpoint) const;
 
     /**
-     * Return a reference to Coin in the cache, or a pruned one if not found. This is
-     * more efficient than GetCoin.
+     * Get the given utxo if this cache already has it unspent. Like
+     * HaveCoinInCache() this never calls the backing CCoinsView, and as it
+     * does not modify the cache either, several threads may call it at once
+     * as long as nothing else uses the cache.
+     */
+    bool GetCoinInCache(const COutPoint &outpoint, Coin &coin) const;
+
+    /**
+     * Return the Coin in the cache, or a pruned one if not found.
      *
-     * Generally, do not hold the reference returned for more than a short scope.
-     * While the current implementation allows for modifications to the contents
-     * of the cache while holding the reference, this behavior should not be relied
-     * on! To be safe, best to not hold the returned reference through any other
-     * calls to this cache.
+     * The cache stores coins compressed, so this returns an expanded copy;
+     * modifications of the cache are not reflected in it. Expanding allocates
+     * and may decompress a public key, so callers that need a coin several
+     * times should keep the copy (see GetSpentCoins()).
      */
-    const Coin& AccessCoin(const COutPoint &output) const;
+    Coin AccessCoin(const COutPoint &output) const;
 
     /**
      * Add a coin. Set potential_overwrite to true if a non-pruned version may
@@ -268,6 +366,15 @@ public:
      */
     bool Flush();
 
+    /**
+     * Push the modifications applied to this cache to its base, like Flush(),
+     * but keep the unspent coins cached (no longer marked dirty). Spent coins
+     * are dropped. Use this instead of Flush() when the contents of the cache
+     * are still useful and only its changes need to be persisted.
+     * If false is returned, the state of this cache (and its backing view) will be undefined.
+     */
+    bool Sync();
+
     /**
      * Removes the UTXO with the given outpoint from the cache, if it is
      * not modified.
@@ -293,8 +400,29 @@ public:
     //! Check whether all prevouts of the transaction are present in the UTXO set represented by this view
     bool HaveInputs(const CTransaction& tx) const;
 
+    /**
+     * Load the coins for the given outpoints into this cache ahead of their
+     * use. The outpoints are hashed in one batch, and those not already
+     * cached are fetched from the backing view with a single GetCoins() call.
+     * Outpoints without an unspent coin are skipped.
+     */
+    void Prefetch(const std::vector<COutPoint>& outpoints) const;
+
+    /**
+     * Add coins read from the backing view, unmodified, for those outpoints
+     * that are not cached yet. Spent coins are skipped. The backing view must
+     * not have been written to since the coins were read.
+     */
+    void ImportCoins(const std::vector<COutPoint>& outpoints, const std::vector<Coin>& coins) const;
+
 private:
     CCoinsMap::iterator FetchCoin(const COutPoint &outpoint) const;
+
+    /**
+     * Drop all cache entries and release their memory in one go, by
+     * replacing cacheCoins and its memory resource with fresh ones.
+     */
+    void ReallocateCache();
 };
 
 //! Utility function to add all of a transaction's outputs to a cache.
@@ -309,6 +437,6 @@ void AddCoins(CCoinsViewCache& cache, const CTransaction& tx, int nHeight, bool
 // This function can be quite expensive because in the event of a transaction
 // which is not found in the cache, it can cause up to MAX_OUTPUTS_PER_BLOCK
 // lookups to database, so it should be used with care.
-const Coin& AccessByTxid(const CCoinsViewCache& cache, const uint256& txid);
+Coin AccessByTxid(const CCoinsViewCache& cache, const uint256& txid);
 
 #endif // BITCOIN_COINS_H
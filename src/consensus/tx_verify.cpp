@@ -135,22 +135,38 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& in
     return nSigOps;
 }
 
+std::vector<Coin> GetSpentCoins(const CTransaction& tx, const CCoinsViewCache& inputs)
+{
+    std::vector<Coin> spent_coins;
+    spent_coins.reserve(tx.vin.size());
+    for (const CTxIn& txin : tx.vin) {
+        spent_coins.push_back(inputs.AccessCoin(txin.prevout));
+    }
+    return spent_coins;
+}
+
 int64_t GetTransactionSigOpCost(const CTransaction& tx, const CCoinsViewCache& inputs, int flags)
+{
+    if (tx.IsCoinBase())
+        return GetLegacySigOpCount(tx) * WITNESS_SCALE_FACTOR;
+    return GetTransactionSigOpCost(tx, GetSpentCoins(tx, inputs), flags);
+}
+
+int64_t GetTransactionSigOpCost(const CTransaction& tx, const std::vector<Coin>& spent_coins, int flags)
 {
     int64_t nSigOps = GetLegacySigOpCount(tx) * WITNESS_SCALE_FACTOR;
 
     if (tx.IsCoinBase())
         return nSigOps;
 
-    if (flags & SCRIPT_VERIFY_P2SH) {
-        nSigOps += GetP2SHSigOpCount(tx, inputs) * WITNESS_SCALE_FACTOR;
-    }
-
+    assert(spent_coins.size() == tx.vin.size());
     for (unsigned int i = 0; i < tx.vin.size(); i++)
     {
-        const Coin& coin = inputs.AccessCoin(tx.vin[i].prevout);
+        const Coin& coin = spent_coins[i];
         assert(!coin.IsSpent());
         const CTxOut &prevout = coin.out;
+        if ((flags & SCRIPT_VERIFY_P2SH) && prevout.scriptPubKey.IsPayToScriptHash())
+            nSigOps += prevout.scriptPubKey.GetSigOpCount(tx.vin[i].scriptSig) * WITNESS_SCALE_FACTOR;
         nSigOps += CountWitnessSigOps(tx.vin[i].scriptSig, prevout.scriptPubKey, &tx.vin[i].scriptWitness, flags);
     }
     return nSigOps;
@@ -213,10 +229,15 @@ bool Consensus::CheckTxInputs(const CTransaction& tx, CValidationState& state, c
                          strprintf("%s: inputs missing/spent", __func__));
     }
 
+    return CheckTxInputs(tx, state, GetSpentCoins(tx, inputs), nSpendHeight, txfee);
+}
+
+bool Consensus::CheckTxInputs(const CTransaction& tx, CValidationState& state, const std::vector<Coin>& spent_coins, int nSpendHeight, CAmount& txfee)
+{
+    assert(spent_coins.size() == tx.vin.size());
     CAmount nValueIn = 0;
     for (unsigned int i = 0; i < tx.vin.size(); ++i) {
-        const COutPoint &prevout = tx.vin[i].prevout;
-        const Coin& coin = inputs.AccessCoin(prevout);
+        const Coin& coin = spent_coins[i];
         assert(!coin.IsSpent());
 
         // If prev is coinbase, check that it's matured
@@ -12,6 +12,7 @@
 
 class CBlockIndex;
 class CCoinsViewCache;
+class Coin;
 class CTransaction;
 class CValidationState;
 
@@ -28,10 +29,24 @@ namespace Consensus {
  * Preconditions: tx.IsCoinBase() is false.
  */
 bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, int nSpendHeight, CAmount& txfee);
+
+/**
+ * Like CheckTxInputs(), with the coins spent by the transaction given in input order.
+ * Preconditions: tx.IsCoinBase() is false, and none of spent_coins is spent.
+ */
+bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const std::vector<Coin>& spent_coins, int nSpendHeight, CAmount& txfee);
 } // namespace Consensus
 
 /** Auxiliary functions for transaction validation (ideally should not be exposed) */
 
+/**
+ * The coins spent by a transaction, in input order; spent ones for missing
+ * inputs. The cache stores coins compressed, so callers that need them
+ * several times should expand them once with this and use the overloads
+ * taking spent_coins.
+ */
+std::vector<Coin> GetSpentCoins(const CTransaction& tx, const CCoinsViewCache& inputs);
+
 /**
  * Count ECDSA signature operations the old-fashioned (pre-0.6) way
  * @return number of sigops this transaction's outputs will produce when spent
@@ -57,6 +72,12 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& ma
  */
 int64_t GetTransactionSigOpCost(const CTransaction& tx, const CCoinsViewCache& inputs, int flags);
 
+/**
+ * Like GetTransactionSigOpCost(), with the coins spent by the transaction
+ * given in input order. They are not used for a coinbase.
+ */
+int64_t GetTransactionSigOpCost(const CTransaction& tx, const std::vector<Coin>& spent_coins, int flags);
+
 /**
  * Check if transaction is final and can be included in a block with the
  * specified height and time. Consensus critical.
@@ -8,68 +8,162 @@
 #include <assert.h>
 #include <string.h>
 
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_AES
+#define HWCAP_AES (1 << 3)
+#endif
+#endif
+
 extern "C" {
 #include <crypto/ctaes/ctaes.c>
 }
 
-AES128Encrypt::AES128Encrypt(const unsigned char key[16])
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+#define ENABLE_ARMV8_AES
+namespace aes_armv8
+{
+void ExpandKey(unsigned char* rk, const unsigned char* key, int nk, int rounds);
+void InvertKey(unsigned char* drk, const unsigned char* rk, int rounds);
+void Encrypt(const unsigned char* rk, int rounds, unsigned char* out, const unsigned char* in);
+void Decrypt(const unsigned char* drk, int rounds, unsigned char* out, const unsigned char* in);
+}
+#endif
+
+namespace {
+
+/** Whether newly constructed AES objects use the ARMv8 instructions. */
+bool g_use_armv8 = false;
+
+/** Set up the round keys for the ARMv8 implementation. Returns false if it is not in use. */
+bool InitARMv8(unsigned char* rk, const unsigned char* key, int nk, int rounds, bool decrypt)
+{
+#if defined(ENABLE_ARMV8_AES)
+    if (g_use_armv8) {
+        if (decrypt) {
+            unsigned char tmp[(14 + 1) * AES_BLOCKSIZE];
+            aes_armv8::ExpandKey(tmp, key, nk, rounds);
+            aes_armv8::InvertKey(rk, tmp, rounds);
+            memset(tmp, 0, sizeof(tmp));
+        } else {
+            aes_armv8::ExpandKey(rk, key, nk, rounds);
+        }
+        return true;
+    }
+#endif
+    return false;
+}
+
+void EncryptARMv8(const unsigned char* rk, int rounds, unsigned char* out, const unsigned char* in)
+{
+#if defined(ENABLE_ARMV8_AES)
+    aes_armv8::Encrypt(rk, rounds, out, in);
+#else
+    assert(false);
+#endif
+}
+
+void DecryptARMv8(const unsigned char* drk, int rounds, unsigned char* out, const unsigned char* in)
+{
+#if defined(ENABLE_ARMV8_AES)
+    aes_armv8::Decrypt(drk, rounds, out, in);
+#else
+    assert(false);
+#endif
+}
+
+} // namespace
+
+std::string AESAutoDetect()
+{
+#if defined(ENABLE_ARMV8_AES)
+#if defined(__linux__)
+    g_use_armv8 = (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#else
+    g_use_armv8 = true;
+#endif
+#endif
+    return g_use_armv8 ? "armv8-aes" : "ctaes";
+}
+
+AES128Encrypt::AES128Encrypt(const unsigned char key[16]) : hw(InitARMv8(rk, key, 4, 10, false))
 {
-    AES128_init(&ctx, key);
+    if (!hw) AES128_init(&ctx, key);
 }
 
 AES128Encrypt::~AES128Encrypt()
 {
     memset(&ctx, 0, sizeof(ctx));
+    memset(rk, 0, sizeof(rk));
 }
 
 void AES128Encrypt::Encrypt(unsigned char ciphertext[16], const unsigned char plaintext[16]) const
 {
-    AES128_encrypt(&ctx, 1, ciphertext, plaintext);
+    if (hw) {
+        EncryptARMv8(rk, 10, ciphertext, plaintext);
+    } else {
+        AES128_encrypt(&ctx, 1, ciphertext, plaintext);
+    }
 }
 
-AES128Decrypt::AES128Decrypt(const unsigned char key[16])
+AES128Decrypt::AES128Decrypt(const unsigned char key[16]) : hw(InitARMv8(rk, key, 4, 10, true))
 {
-    AES128_init(&ctx, key);
+    if (!hw) AES128_init(&ctx, key);
 }
 
 AES128Decrypt::~AES128Decrypt()
 {
     memset(&ctx, 0, sizeof(ctx));
+    memset(rk, 0, sizeof(rk));
 }
 
 void AES128Decrypt::Decrypt(unsigned char plaintext[16], const unsigned char ciphertext[16]) const
 {
-    AES128_decrypt(&ctx, 1, plaintext, ciphertext);
+    if (hw) {
+        DecryptARMv8(rk, 10, plaintext, ciphertext);
+    } else {
+        AES128_decrypt(&ctx, 1, plaintext, ciphertext);
+    }
 }
 
-AES256Encrypt::AES256Encrypt(const unsigned char key[32])
+AES256Encrypt::AES256Encrypt(const unsigned char key[32]) : hw(InitARMv8(rk, key, 8, 14, false))
 {
-    AES256_init(&ctx, key);
+    if (!hw) AES256_init(&ctx, key);
 }
 
 AES256Encrypt::~AES256Encrypt()
 {
     memset(&ctx, 0, sizeof(ctx));
+    memset(rk, 0, sizeof(rk));
 }
 
 void AES256Encrypt::Encrypt(unsigned char ciphertext[16], const unsigned char plaintext[16]) const
 {
-    AES256_encrypt(&ctx, 1, ciphertext, plaintext);
+    if (hw) {
+        EncryptARMv8(rk, 14, ciphertext, plaintext);
+    } else {
+        AES256_encrypt(&ctx, 1, ciphertext, plaintext);
+    }
 }
 
-AES256Decrypt::AES256Decrypt(const unsigned char key[32])
+AES256Decrypt::AES256Decrypt(const unsigned char key[32]) : hw(InitARMv8(rk, key, 8, 14, true))
 {
-    AES256_init(&ctx, key);
+    if (!hw) AES256_init(&ctx, key);
 }
 
 AES256Decrypt::~AES256Decrypt()
 {
     memset(&ctx, 0, sizeof(ctx));
+    memset(rk, 0, sizeof(rk));
 }
 
 void AES256Decrypt::Decrypt(unsigned char plaintext[16], const unsigned char ciphertext[16]) const
 {
-    AES256_decrypt(&ctx, 1, plaintext, ciphertext);
+    if (hw) {
+        DecryptARMv8(rk, 14, plaintext, ciphertext);
+    } else {
+        AES256_decrypt(&ctx, 1, plaintext, ciphertext);
+    }
 }
 
 
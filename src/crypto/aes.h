@@ -11,15 +11,24 @@ extern "C" {
 #include <crypto/ctaes/ctaes.h>
 }
 
+#include <string>
+
 static const int AES_BLOCKSIZE = 16;
 static const int AES128_KEYSIZE = 16;
 static const int AES256_KEYSIZE = 32;
 
+/** Autodetect the best available AES implementation for AES128/256Encrypt/Decrypt
+ *  objects constructed afterwards. Returns the name of the implementation. */
+std::string AESAutoDetect();
+
 /** An encryption class for AES-128. */
 class AES128Encrypt
 {
 private:
     AES128_ctx ctx;
+    /** Round keys for the ARMv8 instructions, used instead of ctx if hw is set. */
+    unsigned char rk[(10 + 1) * AES_BLOCKSIZE];
+    bool hw;
 
 public:
     explicit AES128Encrypt(const unsigned char key[16]);
@@ -32,6 +41,9 @@ class AES128Decrypt
 {
 private:
     AES128_ctx ctx;
+    /** Round keys for the ARMv8 instructions, used instead of ctx if hw is set. */
+    unsigned char rk[(10 + 1) * AES_BLOCKSIZE];
+    bool hw;
 
 public:
     explicit AES128Decrypt(const unsigned char key[16]);
@@ -44,6 +56,9 @@ class AES256Encrypt
 {
 private:
     AES256_ctx ctx;
+    /** Round keys for the ARMv8 instructions, used instead of ctx if hw is set. */
+    unsigned char rk[(14 + 1) * AES_BLOCKSIZE];
+    bool hw;
 
 public:
     explicit AES256Encrypt(const unsigned char key[32]);
@@ -56,6 +71,9 @@ class AES256Decrypt
 {
 private:
     AES256_ctx ctx;
+    /** Round keys for the ARMv8 instructions, used instead of ctx if hw is set. */
+    unsigned char rk[(14 + 1) * AES_BLOCKSIZE];
+    bool hw;
 
 public:
     explicit AES256Decrypt(const unsigned char key[32]);
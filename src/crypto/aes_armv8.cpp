@@ -0,0 +1,89 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// AES-128/AES-256 using the ARMv8 Cryptography Extension instructions
+// (AESE/AESD/AESMC/AESIMC). These run in constant time, like ctaes. The key
+// schedule also uses AESE for SubWord, so no lookup tables are involved.
+
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+
+#include <stdint.h>
+#include <arm_neon.h>
+
+#include <crypto/common.h>
+
+namespace aes_armv8 {
+namespace {
+
+/** Apply the AES S-box to each byte of a word. With all four columns equal,
+ *  the ShiftRows step of AESE is a no-op. */
+uint32_t inline SubWord(uint32_t w)
+{
+    uint8x16_t x = vreinterpretq_u8_u32(vdupq_n_u32(w));
+    return vgetq_lane_u32(vreinterpretq_u32_u8(vaeseq_u8(x, vdupq_n_u8(0))), 0);
+}
+
+uint32_t inline RotWord(uint32_t w) { return (w >> 8) | (w << 24); }
+
+}
+
+/** Expand a key of nk 32-bit words (4 or 8) into rounds + 1 round keys. */
+void ExpandKey(unsigned char* rk, const unsigned char* key, int nk, int rounds)
+{
+    static const uint8_t rcon[10] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36};
+    uint32_t w[60];
+    const int words = 4 * (rounds + 1);
+    for (int i = 0; i < nk; ++i) {
+        w[i] = ReadLE32(key + 4 * i);
+    }
+    for (int i = nk; i < words; ++i) {
+        uint32_t temp = w[i - 1];
+        if (i % nk == 0) {
+            temp = SubWord(RotWord(temp)) ^ rcon[i / nk - 1];
+        } else if (nk > 6 && i % nk == 4) {
+            temp = SubWord(temp);
+        }
+        w[i] = w[i - nk] ^ temp;
+    }
+    for (int i = 0; i < words; ++i) {
+        WriteLE32(rk + 4 * i, w[i]);
+    }
+    for (int i = 0; i < words; ++i) {
+        w[i] = 0;
+    }
+}
+
+/** Convert an encryption key schedule into one for the equivalent inverse cipher. */
+void InvertKey(unsigned char* drk, const unsigned char* rk, int rounds)
+{
+    vst1q_u8(drk, vld1q_u8(rk + 16 * rounds));
+    for (int i = 1; i < rounds; ++i) {
+        vst1q_u8(drk + 16 * i, vaesimcq_u8(vld1q_u8(rk + 16 * (rounds - i))));
+    }
+    vst1q_u8(drk + 16 * rounds, vld1q_u8(rk));
+}
+
+void Encrypt(const unsigned char* rk, int rounds, unsigned char* out, const unsigned char* in)
+{
+    uint8x16_t state = vld1q_u8(in);
+    for (int i = 0; i < rounds - 1; ++i) {
+        state = vaesmcq_u8(vaeseq_u8(state, vld1q_u8(rk + 16 * i)));
+    }
+    state = vaeseq_u8(state, vld1q_u8(rk + 16 * (rounds - 1)));
+    vst1q_u8(out, veorq_u8(state, vld1q_u8(rk + 16 * rounds)));
+}
+
+void Decrypt(const unsigned char* drk, int rounds, unsigned char* out, const unsigned char* in)
+{
+    uint8x16_t state = vld1q_u8(in);
+    for (int i = 0; i < rounds - 1; ++i) {
+        state = vaesimcq_u8(vaesdq_u8(state, vld1q_u8(drk + 16 * i)));
+    }
+    state = vaesdq_u8(state, vld1q_u8(drk + 16 * (rounds - 1)));
+    vst1q_u8(out, veorq_u8(state, vld1q_u8(drk + 16 * rounds)));
+}
+
+}
+
+#endif
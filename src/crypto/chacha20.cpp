@@ -10,6 +10,12 @@
 
 #include <string.h>
 
+#if defined(__aarch64__)
+namespace chacha20_neon {
+void Output_4way(const uint32_t* input, unsigned char* out);
+}
+#endif
+
 constexpr static inline uint32_t rotl32(uint32_t v, int c) { return (v << c) | (v >> (32 - c)); }
 
 #define QUARTERROUND(a,b,c,d) \
@@ -81,6 +87,18 @@ void ChaCha20::Output(unsigned char* c, size_t bytes)
 
     if (!bytes) return;
 
+#if defined(__aarch64__)
+    // AdvSIMD is mandatory on AArch64, so no runtime detection is needed.
+    while (bytes >= 256) {
+        chacha20_neon::Output_4way(input, c);
+        input[12] += 4;
+        if (input[12] < 4) ++input[13];
+        bytes -= 256;
+        c += 256;
+    }
+    if (!bytes) return;
+#endif
+
     j0 = input[0];
     j1 = input[1];
     j2 = input[2];
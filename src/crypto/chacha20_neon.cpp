@@ -0,0 +1,88 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// 4-block ChaCha20 keystream generation using AdvSIMD (NEON) instructions.
+// Each vector lane holds the same state word of a different block, so the
+// rounds are the scalar quarterrounds applied to 4 blocks at once.
+
+#if defined(__aarch64__)
+
+#include <stdint.h>
+#include <arm_neon.h>
+
+#include <crypto/common.h>
+
+namespace chacha20_neon {
+namespace {
+
+/** Rotate left by a constant, using a shift plus shift-right-and-insert. */
+template<int n> uint32x4_t inline RotL(uint32x4_t x) { return vsriq_n_u32(vshlq_n_u32(x, n), x, 32 - n); }
+/** Rotating by 16 is a halfword swap within each lane. */
+template<> uint32x4_t inline RotL<16>(uint32x4_t x) { return vreinterpretq_u32_u16(vrev32q_u16(vreinterpretq_u16_u32(x))); }
+
+void inline QuarterRound(uint32x4_t& a, uint32x4_t& b, uint32x4_t& c, uint32x4_t& d)
+{
+    a = vaddq_u32(a, b); d = RotL<16>(veorq_u32(d, a));
+    c = vaddq_u32(c, d); b = RotL<12>(veorq_u32(b, c));
+    a = vaddq_u32(a, b); d = RotL<8>(veorq_u32(d, a));
+    c = vaddq_u32(c, d); b = RotL<7>(veorq_u32(b, c));
+}
+
+void inline Write4(unsigned char* out, int offset, uint32x4_t v) {
+    WriteLE32(out + 0 + offset, vgetq_lane_u32(v, 0));
+    WriteLE32(out + 64 + offset, vgetq_lane_u32(v, 1));
+    WriteLE32(out + 128 + offset, vgetq_lane_u32(v, 2));
+    WriteLE32(out + 192 + offset, vgetq_lane_u32(v, 3));
+}
+
+}
+
+/** Write the 4 keystream blocks at block counters input[12..13] + 0..3 to out (256 bytes).
+ *  The counter in input is not updated. */
+void Output_4way(const uint32_t* input, unsigned char* out)
+{
+    static const uint32_t lane_offsets[4] = {0, 1, 2, 3};
+
+    // Per-lane block counters, carrying from word 12 into word 13.
+    const uint32x4_t j12_base = vdupq_n_u32(input[12]);
+    const uint32x4_t j12 = vaddq_u32(j12_base, vld1q_u32(lane_offsets));
+    const uint32x4_t j13 = vsubq_u32(vdupq_n_u32(input[13]), vcltq_u32(j12, j12_base));
+
+    uint32x4_t x0 = vdupq_n_u32(input[0]), x1 = vdupq_n_u32(input[1]), x2 = vdupq_n_u32(input[2]), x3 = vdupq_n_u32(input[3]);
+    uint32x4_t x4 = vdupq_n_u32(input[4]), x5 = vdupq_n_u32(input[5]), x6 = vdupq_n_u32(input[6]), x7 = vdupq_n_u32(input[7]);
+    uint32x4_t x8 = vdupq_n_u32(input[8]), x9 = vdupq_n_u32(input[9]), x10 = vdupq_n_u32(input[10]), x11 = vdupq_n_u32(input[11]);
+    uint32x4_t x12 = j12, x13 = j13, x14 = vdupq_n_u32(input[14]), x15 = vdupq_n_u32(input[15]);
+
+    for (int i = 20; i > 0; i -= 2) {
+        QuarterRound(x0, x4, x8, x12);
+        QuarterRound(x1, x5, x9, x13);
+        QuarterRound(x2, x6, x10, x14);
+        QuarterRound(x3, x7, x11, x15);
+        QuarterRound(x0, x5, x10, x15);
+        QuarterRound(x1, x6, x11, x12);
+        QuarterRound(x2, x7, x8, x13);
+        QuarterRound(x3, x4, x9, x14);
+    }
+
+    Write4(out, 0, vaddq_u32(x0, vdupq_n_u32(input[0])));
+    Write4(out, 4, vaddq_u32(x1, vdupq_n_u32(input[1])));
+    Write4(out, 8, vaddq_u32(x2, vdupq_n_u32(input[2])));
+    Write4(out, 12, vaddq_u32(x3, vdupq_n_u32(input[3])));
+    Write4(out, 16, vaddq_u32(x4, vdupq_n_u32(input[4])));
+    Write4(out, 20, vaddq_u32(x5, vdupq_n_u32(input[5])));
+    Write4(out, 24, vaddq_u32(x6, vdupq_n_u32(input[6])));
+    Write4(out, 28, vaddq_u32(x7, vdupq_n_u32(input[7])));
+    Write4(out, 32, vaddq_u32(x8, vdupq_n_u32(input[8])));
+    Write4(out, 36, vaddq_u32(x9, vdupq_n_u32(input[9])));
+    Write4(out, 40, vaddq_u32(x10, vdupq_n_u32(input[10])));
+    Write4(out, 44, vaddq_u32(x11, vdupq_n_u32(input[11])));
+    Write4(out, 48, vaddq_u32(x12, j12));
+    Write4(out, 52, vaddq_u32(x13, j13));
+    Write4(out, 56, vaddq_u32(x14, vdupq_n_u32(input[14])));
+    Write4(out, 60, vaddq_u32(x15, vdupq_n_u32(input[15])));
+}
+
+}
+
+#endif
@@ -0,0 +1,177 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/muhash.h>
+
+#include <crypto/chacha20.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+
+namespace {
+
+/** 2^3072 - 1103717 is the largest 3072-bit safe prime. */
+const uint32_t MAX_PRIME_DIFF = 1103717;
+
+/** p - 2 = (2^3051 - 1) * 2^21 + INV_EXP_LOW, the exponent that computes inverses. */
+const int INV_EXP_ONES = 3051;
+const int INV_EXP_LOW_BITS = 21;
+const uint32_t INV_EXP_LOW = (uint32_t{1} << INV_EXP_LOW_BITS) - (MAX_PRIME_DIFF + 2);
+
+} // namespace
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        limbs[i] = ReadLE32(data + 4 * i);
+    }
+}
+
+void Num3072::SetToOne()
+{
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; ++i) {
+        limbs[i] = 0;
+    }
+}
+
+bool Num3072::IsOverflow() const
+{
+    if (limbs[0] <= 0xffffffff - MAX_PRIME_DIFF) return false;
+    for (int i = 1; i < LIMBS; ++i) {
+        if (limbs[i] != 0xffffffff) return false;
+    }
+    return true;
+}
+
+void Num3072::FullReduce()
+{
+    // Subtract p by adding MAX_PRIME_DIFF and dropping the carry out of the top limb.
+    uint64_t c = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS && c != 0; ++i) {
+        c += limbs[i];
+        limbs[i] = (uint32_t)c;
+        c >>= 32;
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    uint32_t tmp[2 * LIMBS] = {0};
+    for (int i = 0; i < LIMBS; ++i) {
+        uint64_t c = 0;
+        const uint64_t x = limbs[i];
+        for (int j = 0; j < LIMBS; ++j) {
+            c += x * a.limbs[j] + tmp[i + j];
+            tmp[i + j] = (uint32_t)c;
+            c >>= 32;
+        }
+        tmp[i + LIMBS] = (uint32_t)c;
+    }
+
+    // Reduce using 2^3072 = MAX_PRIME_DIFF (mod p).
+    uint64_t c = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        c += tmp[i] + (uint64_t)tmp[i + LIMBS] * MAX_PRIME_DIFF;
+        limbs[i] = (uint32_t)c;
+        c >>= 32;
+    }
+    while (c != 0) {
+        c *= MAX_PRIME_DIFF;
+        for (int i = 0; i < LIMBS && c != 0; ++i) {
+            c += limbs[i];
+            limbs[i] = (uint32_t)c;
+            c >>= 32;
+        }
+    }
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // Fermat: a^(p-2) is the inverse of a. Compute a^(2^k - 1) for k = 3051
+    // by walking down the bits of k, then append the low 21 bits.
+    Num3072 r = *this;
+    int k = 1;
+    for (int bit = 10; bit >= 0; --bit) {
+        // a^(2^k - 1) -> a^(2^2k - 1)
+        Num3072 base = r;
+        for (int i = 0; i < k; ++i) {
+            r.Multiply(r);
+        }
+        r.Multiply(base);
+        k *= 2;
+        if ((INV_EXP_ONES >> bit) & 1) {
+            // a^(2^k - 1) -> a^(2^(k+1) - 1)
+            r.Multiply(r);
+            r.Multiply(*this);
+            ++k;
+        }
+    }
+    for (int bit = INV_EXP_LOW_BITS - 1; bit >= 0; --bit) {
+        r.Multiply(r);
+        if ((INV_EXP_LOW >> bit) & 1) {
+            r.Multiply(*this);
+        }
+    }
+    return r;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    Multiply(a.GetInverse());
+    if (IsOverflow()) FullReduce();
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE]) const
+{
+    Num3072 reduced = *this;
+    if (reduced.IsOverflow()) reduced.FullReduce();
+    for (int i = 0; i < LIMBS; ++i) {
+        WriteLE32(out + 4 * i, reduced.limbs[i]);
+    }
+}
+
+Num3072 MuHash3072::ToNum3072(const unsigned char* data, size_t len)
+{
+    unsigned char key[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(key);
+    unsigned char bytes[Num3072::BYTE_SIZE];
+    ChaCha20(key, sizeof(key)).Output(bytes, sizeof(bytes));
+    return Num3072(bytes);
+}
+
+MuHash3072& MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    m_numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    m_denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul)
+{
+    m_numerator.Multiply(mul.m_numerator);
+    m_denominator.Multiply(mul.m_denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& div)
+{
+    m_numerator.Multiply(div.m_denominator);
+    m_denominator.Multiply(div.m_numerator);
+    return *this;
+}
+
+void MuHash3072::Finalize(unsigned char hash[OUTPUT_SIZE])
+{
+    m_numerator.Divide(m_denominator);
+    m_denominator.SetToOne();
+
+    unsigned char data[Num3072::BYTE_SIZE];
+    m_numerator.ToBytes(data);
+    CSHA256().Write(data, sizeof(data)).Finalize(hash);
+}
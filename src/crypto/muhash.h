@@ -0,0 +1,94 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** A number modulo the prime 2^3072 - 1103717, in 32-bit limbs. */
+class Num3072
+{
+public:
+    static const size_t BYTE_SIZE = 384;
+    static const int LIMBS = 96;
+
+    /** Little endian limbs. The value may be up to 2^3072 - 1, i.e. not fully reduced. */
+    uint32_t limbs[LIMBS];
+
+    Num3072() { SetToOne(); }
+    /** Interpret 384 bytes as a little endian number. */
+    explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+
+    void SetToOne();
+    void Multiply(const Num3072& a);
+    void Divide(const Num3072& a);
+    /** Write the fully reduced value as 384 little endian bytes. */
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]) const;
+
+private:
+    bool IsOverflow() const;
+    void FullReduce();
+    Num3072 GetInverse() const;
+};
+
+/**
+ * A hash of a set of byte strings, which can be updated by adding and
+ * removing elements in any order (MuHash, as described in "A New Paradigm
+ * for Collision-free Hashing: Incrementality at Reduced Cost" by Bellare and
+ * Micciancio).
+ *
+ * Each element is hashed to a number modulo a 3072-bit prime (through
+ * SHA256 and ChaCha20), and the set hash is the product of those numbers.
+ * Removals are kept as a separate denominator so that updates only cost a
+ * multiplication; the one modular inversion happens in Finalize().
+ */
+class MuHash3072
+{
+private:
+    Num3072 m_numerator;
+    Num3072 m_denominator;
+
+    static Num3072 ToNum3072(const unsigned char* data, size_t len);
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+
+    /** Construct the hash of the empty set. */
+    MuHash3072() {}
+
+    MuHash3072& Insert(const unsigned char* data, size_t len);
+    MuHash3072& Remove(const unsigned char* data, size_t len);
+
+    /** Add the elements of another set. */
+    MuHash3072& operator*=(const MuHash3072& mul);
+    /** Remove the elements of another set. */
+    MuHash3072& operator/=(const MuHash3072& div);
+
+    /** Compute the 32-byte hash of the set. */
+    void Finalize(unsigned char hash[OUTPUT_SIZE]);
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        unsigned char data[Num3072::BYTE_SIZE];
+        m_numerator.ToBytes(data);
+        s.write((const char*)data, sizeof(data));
+        m_denominator.ToBytes(data);
+        s.write((const char*)data, sizeof(data));
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        unsigned char data[Num3072::BYTE_SIZE];
+        s.read((char*)data, sizeof(data));
+        m_numerator = Num3072(data);
+        s.read((char*)data, sizeof(data));
+        m_denominator = Num3072(data);
+    }
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
@@ -8,6 +8,13 @@
 
 #include <string.h>
 
+#if defined(__aarch64__)
+namespace ripemd160_32_neon
+{
+void Transform_4way(unsigned char* out, const unsigned char* in);
+}
+#endif
+
 // Internal implementation code.
 namespace
 {
@@ -290,3 +297,33 @@ CRIPEMD160& CRIPEMD160::Reset()
     ripemd160::Initialize(s);
     return *this;
 }
+
+void RIPEMD160_32(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+#if defined(__aarch64__)
+    while (blocks >= 4) {
+        ripemd160_32_neon::Transform_4way(out, in);
+        out += 80;
+        in += 128;
+        blocks -= 4;
+    }
+#endif
+    // A 32-byte message plus padding always fits in a single block.
+    unsigned char chunk[64] = {0};
+    chunk[32] = 0x80;
+    WriteLE64(chunk + 56, 32 << 3);
+    while (blocks) {
+        uint32_t s[5];
+        ripemd160::Initialize(s);
+        memcpy(chunk, in, 32);
+        ripemd160::Transform(s, chunk);
+        WriteLE32(out, s[0]);
+        WriteLE32(out + 4, s[1]);
+        WriteLE32(out + 8, s[2]);
+        WriteLE32(out + 12, s[3]);
+        WriteLE32(out + 16, s[4]);
+        out += 20;
+        in += 32;
+        --blocks;
+    }
+}
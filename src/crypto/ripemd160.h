@@ -25,4 +25,11 @@ public:
     CRIPEMD160& Reset();
 };
 
+/** Compute multiple RIPEMD-160's of 32-byte blobs (the second step of HASH160).
+ *  output:  pointer to a blocks*20 byte output buffer
+ *  input:   pointer to a blocks*32 byte input buffer
+ *  blocks:  the number of hashes to compute.
+ */
+void RIPEMD160_32(unsigned char* output, const unsigned char* input, size_t blocks);
+
 #endif // BITCOIN_CRYPTO_RIPEMD160_H
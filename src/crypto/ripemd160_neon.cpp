@@ -0,0 +1,250 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// 4-way RIPEMD-160 of 32-byte messages using AdvSIMD (NEON) instructions.
+// This is the second half of HASH160, so every input fits a single block.
+
+#if defined(__aarch64__)
+
+#include <stdint.h>
+#include <arm_neon.h>
+
+#include <crypto/common.h>
+
+namespace ripemd160_32_neon {
+namespace {
+
+uint32x4_t inline K(uint32_t x) { return vdupq_n_u32(x); }
+
+uint32x4_t inline f1(uint32x4_t x, uint32x4_t y, uint32x4_t z) { return veorq_u32(veorq_u32(x, y), z); }
+uint32x4_t inline f2(uint32x4_t x, uint32x4_t y, uint32x4_t z) { return vbslq_u32(x, y, z); }
+uint32x4_t inline f3(uint32x4_t x, uint32x4_t y, uint32x4_t z) { return veorq_u32(vornq_u32(x, y), z); }
+uint32x4_t inline f4(uint32x4_t x, uint32x4_t y, uint32x4_t z) { return vbslq_u32(z, x, y); }
+uint32x4_t inline f5(uint32x4_t x, uint32x4_t y, uint32x4_t z) { return veorq_u32(x, vornq_u32(y, z)); }
+
+uint32x4_t inline rol(uint32x4_t x, int i) { return vorrq_u32(vshlq_u32(x, vdupq_n_s32(i)), vshlq_u32(x, vdupq_n_s32(i - 32))); }
+
+void inline __attribute__((always_inline)) Round(uint32x4_t& a, uint32x4_t b, uint32x4_t& c, uint32x4_t d, uint32x4_t e, uint32x4_t f, uint32x4_t x, uint32_t k, int r)
+{
+    a = vaddq_u32(rol(vaddq_u32(vaddq_u32(a, f), vaddq_u32(x, K(k))), r), e);
+    c = rol(c, 10);
+}
+
+void inline R11(uint32x4_t& a, uint32x4_t b, uint32x4_t& c, uint32x4_t d, uint32x4_t e, uint32x4_t x, int r) { Round(a, b, c, d, e, f1(b, c, d), x, 0, r); }
+void inline R21(uint32x4_t& a, uint32x4_t b, uint32x4_t& c, uint32x4_t d, uint32x4_t e, uint32x4_t x, int r) { Round(a, b, c, d, e, f2(b, c, d), x, 0x5A827999ul, r); }
+void inline R31(uint32x4_t& a, uint32x4_t b, uint32x4_t& c, uint32x4_t d, uint32x4_t e, uint32x4_t x, int r) { Round(a, b, c, d, e, f3(b, c, d), x, 0x6ED9EBA1ul, r); }
+void inline R41(uint32x4_t& a, uint32x4_t b, uint32x4_t& c, uint32x4_t d, uint32x4_t e, uint32x4_t x, int r) { Round(a, b, c, d, e, f4(b, c, d), x, 0x8F1BBCDCul, r); }
+void inline R51(uint32x4_t& a, uint32x4_t b, uint32x4_t& c, uint32x4_t d, uint32x4_t e, uint32x4_t x, int r) { Round(a, b, c, d, e, f5(b, c, d), x, 0xA953FD4Eul, r); }
+
+void inline R12(uint32x4_t& a, uint32x4_t b, uint32x4_t& c, uint32x4_t d, uint32x4_t e, uint32x4_t x, int r) { Round(a, b, c, d, e, f5(b, c, d), x, 0x50A28BE6ul, r); }
+void inline R22(uint32x4_t& a, uint32x4_t b, uint32x4_t& c, uint32x4_t d, uint32x4_t e, uint32x4_t x, int r) { Round(a, b, c, d, e, f4(b, c, d), x, 0x5C4DD124ul, r); }
+void inline R32(uint32x4_t& a, uint32x4_t b, uint32x4_t& c, uint32x4_t d, uint32x4_t e, uint32x4_t x, int r) { Round(a, b, c, d, e, f3(b, c, d), x, 0x6D703EF3ul, r); }
+void inline R42(uint32x4_t& a, uint32x4_t b, uint32x4_t& c, uint32x4_t d, uint32x4_t e, uint32x4_t x, int r) { Round(a, b, c, d, e, f2(b, c, d), x, 0x7A6D76E9ul, r); }
+void inline R52(uint32x4_t& a, uint32x4_t b, uint32x4_t& c, uint32x4_t d, uint32x4_t e, uint32x4_t x, int r) { Round(a, b, c, d, e, f1(b, c, d), x, 0, r); }
+
+uint32x4_t inline Read4(const unsigned char* chunk, int offset) {
+    alignas(16) uint32_t tmp[4] = {
+        ReadLE32(chunk + 0 + offset),
+        ReadLE32(chunk + 32 + offset),
+        ReadLE32(chunk + 64 + offset),
+        ReadLE32(chunk + 96 + offset)
+    };
+    return vld1q_u32(tmp);
+}
+
+void inline Write4(unsigned char* out, int offset, uint32x4_t v) {
+    WriteLE32(out + 0 + offset, vgetq_lane_u32(v, 0));
+    WriteLE32(out + 20 + offset, vgetq_lane_u32(v, 1));
+    WriteLE32(out + 40 + offset, vgetq_lane_u32(v, 2));
+    WriteLE32(out + 60 + offset, vgetq_lane_u32(v, 3));
+}
+
+}
+
+/** Compute 4 RIPEMD-160's of 32-byte blobs: in is 4*32 bytes, out receives 4*20 bytes. */
+void Transform_4way(unsigned char* out, const unsigned char* in)
+{
+    uint32x4_t a1 = K(0x67452301ul), b1 = K(0xEFCDAB89ul), c1 = K(0x98BADCFEul), d1 = K(0x10325476ul), e1 = K(0xC3D2E1F0ul);
+    uint32x4_t a2 = a1, b2 = b1, c2 = c1, d2 = d1, e2 = e1;
+    uint32x4_t w0 = Read4(in, 0), w1 = Read4(in, 4), w2 = Read4(in, 8), w3 = Read4(in, 12);
+    uint32x4_t w4 = Read4(in, 16), w5 = Read4(in, 20), w6 = Read4(in, 24), w7 = Read4(in, 28);
+    // Padding of a 32-byte message: 0x80 terminator and a 256-bit length.
+    uint32x4_t w8 = K(0x80ul), w9 = K(0), w10 = K(0), w11 = K(0);
+    uint32x4_t w12 = K(0), w13 = K(0), w14 = K(256ul), w15 = K(0);
+
+    R11(a1, b1, c1, d1, e1, w0, 11);
+    R12(a2, b2, c2, d2, e2, w5, 8);
+    R11(e1, a1, b1, c1, d1, w1, 14);
+    R12(e2, a2, b2, c2, d2, w14, 9);
+    R11(d1, e1, a1, b1, c1, w2, 15);
+    R12(d2, e2, a2, b2, c2, w7, 9);
+    R11(c1, d1, e1, a1, b1, w3, 12);
+    R12(c2, d2, e2, a2, b2, w0, 11);
+    R11(b1, c1, d1, e1, a1, w4, 5);
+    R12(b2, c2, d2, e2, a2, w9, 13);
+    R11(a1, b1, c1, d1, e1, w5, 8);
+    R12(a2, b2, c2, d2, e2, w2, 15);
+    R11(e1, a1, b1, c1, d1, w6, 7);
+    R12(e2, a2, b2, c2, d2, w11, 15);
+    R11(d1, e1, a1, b1, c1, w7, 9);
+    R12(d2, e2, a2, b2, c2, w4, 5);
+    R11(c1, d1, e1, a1, b1, w8, 11);
+    R12(c2, d2, e2, a2, b2, w13, 7);
+    R11(b1, c1, d1, e1, a1, w9, 13);
+    R12(b2, c2, d2, e2, a2, w6, 7);
+    R11(a1, b1, c1, d1, e1, w10, 14);
+    R12(a2, b2, c2, d2, e2, w15, 8);
+    R11(e1, a1, b1, c1, d1, w11, 15);
+    R12(e2, a2, b2, c2, d2, w8, 11);
+    R11(d1, e1, a1, b1, c1, w12, 6);
+    R12(d2, e2, a2, b2, c2, w1, 14);
+    R11(c1, d1, e1, a1, b1, w13, 7);
+    R12(c2, d2, e2, a2, b2, w10, 14);
+    R11(b1, c1, d1, e1, a1, w14, 9);
+    R12(b2, c2, d2, e2, a2, w3, 12);
+    R11(a1, b1, c1, d1, e1, w15, 8);
+    R12(a2, b2, c2, d2, e2, w12, 6);
+
+    R21(e1, a1, b1, c1, d1, w7, 7);
+    R22(e2, a2, b2, c2, d2, w6, 9);
+    R21(d1, e1, a1, b1, c1, w4, 6);
+    R22(d2, e2, a2, b2, c2, w11, 13);
+    R21(c1, d1, e1, a1, b1, w13, 8);
+    R22(c2, d2, e2, a2, b2, w3, 15);
+    R21(b1, c1, d1, e1, a1, w1, 13);
+    R22(b2, c2, d2, e2, a2, w7, 7);
+    R21(a1, b1, c1, d1, e1, w10, 11);
+    R22(a2, b2, c2, d2, e2, w0, 12);
+    R21(e1, a1, b1, c1, d1, w6, 9);
+    R22(e2, a2, b2, c2, d2, w13, 8);
+    R21(d1, e1, a1, b1, c1, w15, 7);
+    R22(d2, e2, a2, b2, c2, w5, 9);
+    R21(c1, d1, e1, a1, b1, w3, 15);
+    R22(c2, d2, e2, a2, b2, w10, 11);
+    R21(b1, c1, d1, e1, a1, w12, 7);
+    R22(b2, c2, d2, e2, a2, w14, 7);
+    R21(a1, b1, c1, d1, e1, w0, 12);
+    R22(a2, b2, c2, d2, e2, w15, 7);
+    R21(e1, a1, b1, c1, d1, w9, 15);
+    R22(e2, a2, b2, c2, d2, w8, 12);
+    R21(d1, e1, a1, b1, c1, w5, 9);
+    R22(d2, e2, a2, b2, c2, w12, 7);
+    R21(c1, d1, e1, a1, b1, w2, 11);
+    R22(c2, d2, e2, a2, b2, w4, 6);
+    R21(b1, c1, d1, e1, a1, w14, 7);
+    R22(b2, c2, d2, e2, a2, w9, 15);
+    R21(a1, b1, c1, d1, e1, w11, 13);
+    R22(a2, b2, c2, d2, e2, w1, 13);
+    R21(e1, a1, b1, c1, d1, w8, 12);
+    R22(e2, a2, b2, c2, d2, w2, 11);
+
+    R31(d1, e1, a1, b1, c1, w3, 11);
+    R32(d2, e2, a2, b2, c2, w15, 9);
+    R31(c1, d1, e1, a1, b1, w10, 13);
+    R32(c2, d2, e2, a2, b2, w5, 7);
+    R31(b1, c1, d1, e1, a1, w14, 6);
+    R32(b2, c2, d2, e2, a2, w1, 15);
+    R31(a1, b1, c1, d1, e1, w4, 7);
+    R32(a2, b2, c2, d2, e2, w3, 11);
+    R31(e1, a1, b1, c1, d1, w9, 14);
+    R32(e2, a2, b2, c2, d2, w7, 8);
+    R31(d1, e1, a1, b1, c1, w15, 9);
+    R32(d2, e2, a2, b2, c2, w14, 6);
+    R31(c1, d1, e1, a1, b1, w8, 13);
+    R32(c2, d2, e2, a2, b2, w6, 6);
+    R31(b1, c1, d1, e1, a1, w1, 15);
+    R32(b2, c2, d2, e2, a2, w9, 14);
+    R31(a1, b1, c1, d1, e1, w2, 14);
+    R32(a2, b2, c2, d2, e2, w11, 12);
+    R31(e1, a1, b1, c1, d1, w7, 8);
+    R32(e2, a2, b2, c2, d2, w8, 13);
+    R31(d1, e1, a1, b1, c1, w0, 13);
+    R32(d2, e2, a2, b2, c2, w12, 5);
+    R31(c1, d1, e1, a1, b1, w6, 6);
+    R32(c2, d2, e2, a2, b2, w2, 14);
+    R31(b1, c1, d1, e1, a1, w13, 5);
+    R32(b2, c2, d2, e2, a2, w10, 13);
+    R31(a1, b1, c1, d1, e1, w11, 12);
+    R32(a2, b2, c2, d2, e2, w0, 13);
+    R31(e1, a1, b1, c1, d1, w5, 7);
+    R32(e2, a2, b2, c2, d2, w4, 7);
+    R31(d1, e1, a1, b1, c1, w12, 5);
+    R32(d2, e2, a2, b2, c2, w13, 5);
+
+    R41(c1, d1, e1, a1, b1, w1, 11);
+    R42(c2, d2, e2, a2, b2, w8, 15);
+    R41(b1, c1, d1, e1, a1, w9, 12);
+    R42(b2, c2, d2, e2, a2, w6, 5);
+    R41(a1, b1, c1, d1, e1, w11, 14);
+    R42(a2, b2, c2, d2, e2, w4, 8);
+    R41(e1, a1, b1, c1, d1, w10, 15);
+    R42(e2, a2, b2, c2, d2, w1, 11);
+    R41(d1, e1, a1, b1, c1, w0, 14);
+    R42(d2, e2, a2, b2, c2, w3, 14);
+    R41(c1, d1, e1, a1, b1, w8, 15);
+    R42(c2, d2, e2, a2, b2, w11, 14);
+    R41(b1, c1, d1, e1, a1, w12, 9);
+    R42(b2, c2, d2, e2, a2, w15, 6);
+    R41(a1, b1, c1, d1, e1, w4, 8);
+    R42(a2, b2, c2, d2, e2, w0, 14);
+    R41(e1, a1, b1, c1, d1, w13, 9);
+    R42(e2, a2, b2, c2, d2, w5, 6);
+    R41(d1, e1, a1, b1, c1, w3, 14);
+    R42(d2, e2, a2, b2, c2, w12, 9);
+    R41(c1, d1, e1, a1, b1, w7, 5);
+    R42(c2, d2, e2, a2, b2, w2, 12);
+    R41(b1, c1, d1, e1, a1, w15, 6);
+    R42(b2, c2, d2, e2, a2, w13, 9);
+    R41(a1, b1, c1, d1, e1, w14, 8);
+    R42(a2, b2, c2, d2, e2, w9, 12);
+    R41(e1, a1, b1, c1, d1, w5, 6);
+    R42(e2, a2, b2, c2, d2, w7, 5);
+    R41(d1, e1, a1, b1, c1, w6, 5);
+    R42(d2, e2, a2, b2, c2, w10, 15);
+    R41(c1, d1, e1, a1, b1, w2, 12);
+    R42(c2, d2, e2, a2, b2, w14, 8);
+
+    R51(b1, c1, d1, e1, a1, w4, 9);
+    R52(b2, c2, d2, e2, a2, w12, 8);
+    R51(a1, b1, c1, d1, e1, w0, 15);
+    R52(a2, b2, c2, d2, e2, w15, 5);
+    R51(e1, a1, b1, c1, d1, w5, 5);
+    R52(e2, a2, b2, c2, d2, w10, 12);
+    R51(d1, e1, a1, b1, c1, w9, 11);
+    R52(d2, e2, a2, b2, c2, w4, 9);
+    R51(c1, d1, e1, a1, b1, w7, 6);
+    R52(c2, d2, e2, a2, b2, w1, 12);
+    R51(b1, c1, d1, e1, a1, w12, 8);
+    R52(b2, c2, d2, e2, a2, w5, 5);
+    R51(a1, b1, c1, d1, e1, w2, 13);
+    R52(a2, b2, c2, d2, e2, w8, 14);
+    R51(e1, a1, b1, c1, d1, w10, 12);
+    R52(e2, a2, b2, c2, d2, w7, 6);
+    R51(d1, e1, a1, b1, c1, w14, 5);
+    R52(d2, e2, a2, b2, c2, w6, 8);
+    R51(c1, d1, e1, a1, b1, w1, 12);
+    R52(c2, d2, e2, a2, b2, w2, 13);
+    R51(b1, c1, d1, e1, a1, w3, 13);
+    R52(b2, c2, d2, e2, a2, w13, 6);
+    R51(a1, b1, c1, d1, e1, w8, 14);
+    R52(a2, b2, c2, d2, e2, w14, 5);
+    R51(e1, a1, b1, c1, d1, w11, 11);
+    R52(e2, a2, b2, c2, d2, w0, 15);
+    R51(d1, e1, a1, b1, c1, w6, 8);
+    R52(d2, e2, a2, b2, c2, w3, 13);
+    R51(c1, d1, e1, a1, b1, w15, 5);
+    R52(c2, d2, e2, a2, b2, w9, 11);
+    R51(b1, c1, d1, e1, a1, w13, 6);
+    R52(b2, c2, d2, e2, a2, w11, 11);
+
+    Write4(out, 0, vaddq_u32(vaddq_u32(K(0xEFCDAB89ul), c1), d2));
+    Write4(out, 4, vaddq_u32(vaddq_u32(K(0x98BADCFEul), d1), e2));
+    Write4(out, 8, vaddq_u32(vaddq_u32(K(0x10325476ul), e1), a2));
+    Write4(out, 12, vaddq_u32(vaddq_u32(K(0xC3D2E1F0ul), a1), b2));
+    Write4(out, 16, vaddq_u32(vaddq_u32(K(0x67452301ul), b1), c2));
+}
+
+}
+
+#endif
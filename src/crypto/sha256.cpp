@@ -10,6 +10,16 @@
 #include <arm_neon.h>
 #endif
 
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_ASIMD
+#define HWCAP_ASIMD (1 << 1)
+#endif
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+#endif
+
 #include <assert.h>
 #include <string.h>
 #include <atomic>
@@ -44,6 +54,11 @@ namespace sha256_shani
 void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
 }
 
+namespace sha256d64_neon
+{
+void Transform_4way(unsigned char* out, const unsigned char* in);
+}
+
 #if defined(__aarch32__) || defined(__aarch64__)
 namespace sha256_armv8 {
 
@@ -900,6 +915,139 @@ void inline TransformD64Wrapper_2way(unsigned char* out, const unsigned char* in
     sha256_armv8::WriteBE32Neon32bytes(out + 32, s + 8);
 }
 
+/** Four SHA-256 rounds on each of N independent lanes, using precomputed message+constant words. */
+template<int N>
+void inline __attribute__((always_inline)) QuadRoundNway(uint32x4_t* s0, uint32x4_t* s1, const uint32x4_t* wk)
+{
+    for (int i = 0; i < N; ++i) {
+        uint32x4_t tmp = s0[i];
+        s0[i] = vsha256hq_u32(s0[i], s1[i], wk[i]);
+        s1[i] = vsha256h2q_u32(s1[i], tmp, wk[i]);
+    }
+}
+
+/** Four SHA-256 rounds on each of N lanes, adding round constants k to message words w. */
+template<int N>
+void inline __attribute__((always_inline)) QuadRoundNway(uint32x4_t* s0, uint32x4_t* s1, const uint32x4_t* w, const uint32_t* k)
+{
+    alignas(16) uint32x4_t wk[N];
+    uint32x4_t kv = vld1q_u32(k);
+    for (int i = 0; i < N; ++i) wk[i] = vaddq_u32(w[i], kv);
+    QuadRoundNway<N>(s0, s1, wk);
+}
+
+/** Four SHA-256 rounds on each of N lanes, with a message+constant word shared by every lane. */
+template<int N>
+void inline __attribute__((always_inline)) QuadRoundNway(uint32x4_t* s0, uint32x4_t* s1, const uint32_t* k)
+{
+    alignas(16) uint32x4_t wk[N];
+    uint32x4_t kv = vld1q_u32(k);
+    for (int i = 0; i < N; ++i) wk[i] = kv;
+    QuadRoundNway<N>(s0, s1, wk);
+}
+
+/** Message schedule update of four words on each of N lanes: w0 = sigma(w0, w1, w2, w3). */
+template<int N>
+void inline __attribute__((always_inline)) ScheduleNway(uint32x4_t* w0, const uint32x4_t* w1, const uint32x4_t* w2, const uint32x4_t* w3)
+{
+    for (int i = 0; i < N; ++i) {
+        w0[i] = vsha256su1q_u32(vsha256su0q_u32(w0[i], w1[i]), w2[i], w3[i]);
+    }
+}
+
+/** Compute N independent double-SHA256's of 64-byte blobs via ArmV8 extensions.
+ *
+ *  The lanes are interleaved so that cores with several multi-cycle SHA2 pipes
+ *  (Cortex-A7x, Neoverse) always have independent SHA256H/SHA256H2 work queued.
+ *  The second transform only hashes the constant padding block, so its message
+ *  schedule is taken from the precomputed K[64..127]; the third transform has the
+ *  constant padding words of the 32-byte input folded into K[128..191].
+ */
+template<int N>
+void inline __attribute__((always_inline)) TransformD64Nway(unsigned char* out, const unsigned char* in)
+{
+    alignas(16) uint32x4_t s0[N], s1[N], save0[N], save1[N];
+    alignas(16) uint32x4_t m0[N], m1[N], m2[N], m3[N];
+
+    // Transform 1
+    for (int i = 0; i < N; ++i) {
+        const unsigned char* chunk = in + 64 * i;
+        s0[i] = sha256_armv8::init.val[0];
+        s1[i] = sha256_armv8::init.val[1];
+        m0[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(chunk)));
+        m1[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(chunk + 16)));
+        m2[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(chunk + 32)));
+        m3[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(chunk + 48)));
+    }
+
+    QuadRoundNway<N>(s0, s1, m0, &K[0]);  ScheduleNway<N>(m0, m1, m2, m3);
+    QuadRoundNway<N>(s0, s1, m1, &K[4]);  ScheduleNway<N>(m1, m2, m3, m0);
+    QuadRoundNway<N>(s0, s1, m2, &K[8]);  ScheduleNway<N>(m2, m3, m0, m1);
+    QuadRoundNway<N>(s0, s1, m3, &K[12]); ScheduleNway<N>(m3, m0, m1, m2);
+    QuadRoundNway<N>(s0, s1, m0, &K[16]); ScheduleNway<N>(m0, m1, m2, m3);
+    QuadRoundNway<N>(s0, s1, m1, &K[20]); ScheduleNway<N>(m1, m2, m3, m0);
+    QuadRoundNway<N>(s0, s1, m2, &K[24]); ScheduleNway<N>(m2, m3, m0, m1);
+    QuadRoundNway<N>(s0, s1, m3, &K[28]); ScheduleNway<N>(m3, m0, m1, m2);
+    QuadRoundNway<N>(s0, s1, m0, &K[32]); ScheduleNway<N>(m0, m1, m2, m3);
+    QuadRoundNway<N>(s0, s1, m1, &K[36]); ScheduleNway<N>(m1, m2, m3, m0);
+    QuadRoundNway<N>(s0, s1, m2, &K[40]); ScheduleNway<N>(m2, m3, m0, m1);
+    QuadRoundNway<N>(s0, s1, m3, &K[44]); ScheduleNway<N>(m3, m0, m1, m2);
+    QuadRoundNway<N>(s0, s1, m0, &K[48]);
+    QuadRoundNway<N>(s0, s1, m1, &K[52]);
+    QuadRoundNway<N>(s0, s1, m2, &K[56]);
+    QuadRoundNway<N>(s0, s1, m3, &K[60]);
+
+    for (int i = 0; i < N; ++i) {
+        s0[i] = vaddq_u32(s0[i], sha256_armv8::init.val[0]);
+        s1[i] = vaddq_u32(s1[i], sha256_armv8::init.val[1]);
+        save0[i] = s0[i];
+        save1[i] = s1[i];
+    }
+
+    // Transform 2
+    for (int r = 0; r < 64; r += 4) {
+        QuadRoundNway<N>(s0, s1, &K[64 + r]);
+    }
+
+    // Transform 3
+    for (int i = 0; i < N; ++i) {
+        m0[i] = vaddq_u32(s0[i], save0[i]);
+        m1[i] = vaddq_u32(s1[i], save1[i]);
+        m2[i] = _mm_set_epi64x(0x0ull, 0x80000000ull);
+        m3[i] = _mm_set_epi64x(0x10000000000ull, 0x0ull);
+        s0[i] = sha256_armv8::init.val[0];
+        s1[i] = sha256_armv8::init.val[1];
+    }
+
+    QuadRoundNway<N>(s0, s1, m0, &K[128]); ScheduleNway<N>(m0, m1, m2, m3);
+    QuadRoundNway<N>(s0, s1, m1, &K[132]); ScheduleNway<N>(m1, m2, m3, m0);
+    QuadRoundNway<N>(s0, s1, &K[136]);     ScheduleNway<N>(m2, m3, m0, m1);
+    QuadRoundNway<N>(s0, s1, &K[140]);     ScheduleNway<N>(m3, m0, m1, m2);
+    QuadRoundNway<N>(s0, s1, m0, &K[144]); ScheduleNway<N>(m0, m1, m2, m3);
+    QuadRoundNway<N>(s0, s1, m1, &K[148]); ScheduleNway<N>(m1, m2, m3, m0);
+    QuadRoundNway<N>(s0, s1, m2, &K[152]); ScheduleNway<N>(m2, m3, m0, m1);
+    QuadRoundNway<N>(s0, s1, m3, &K[156]); ScheduleNway<N>(m3, m0, m1, m2);
+    QuadRoundNway<N>(s0, s1, m0, &K[160]); ScheduleNway<N>(m0, m1, m2, m3);
+    QuadRoundNway<N>(s0, s1, m1, &K[164]); ScheduleNway<N>(m1, m2, m3, m0);
+    QuadRoundNway<N>(s0, s1, m2, &K[168]); ScheduleNway<N>(m2, m3, m0, m1);
+    QuadRoundNway<N>(s0, s1, m3, &K[172]); ScheduleNway<N>(m3, m0, m1, m2);
+    QuadRoundNway<N>(s0, s1, m0, &K[176]);
+    QuadRoundNway<N>(s0, s1, m1, &K[180]);
+    QuadRoundNway<N>(s0, s1, m2, &K[184]);
+    QuadRoundNway<N>(s0, s1, m3, &K[188]);
+
+    // Output
+    for (int i = 0; i < N; ++i) {
+        s0[i] = vaddq_u32(s0[i], sha256_armv8::init.val[0]);
+        s1[i] = vaddq_u32(s1[i], sha256_armv8::init.val[1]);
+        vst1q_u8(out + 32 * i, vrev32q_u8(vreinterpretq_u8_u32(s0[i])));
+        vst1q_u8(out + 32 * i + 16, vrev32q_u8(vreinterpretq_u8_u32(s1[i])));
+    }
+}
+
+void TransformD64_4way(unsigned char* out, const unsigned char* in) { TransformD64Nway<4>(out, in); }
+void TransformD64_8way(unsigned char* out, const unsigned char* in) { TransformD64Nway<8>(out, in); }
+
 } // namespace sha256_armv8
 #endif
 
@@ -1435,9 +1583,15 @@ bool AVXEnabled()
 } // namespace
 
 
-std::string SHA256AutoDetect()
+std::string SHA256AutoDetect(sha256_implementation::UseImplementation use_implementation)
 {
     std::string ret = "standard";
+    Transform = sha256::Transform;
+    TransformD64 = sha256::TransformD64;
+    TransformD64_2way = nullptr;
+    TransformD64_4way = nullptr;
+    TransformD64_8way = nullptr;
+
 #if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
     bool have_sse4 = false;
     bool have_xsave = false;
@@ -1467,6 +1621,10 @@ std::string SHA256AutoDetect()
       have_avx2 = (ebx >> 5) & 1;
       have_shani = (ebx >> 29) & 1;
     }
+    // SSE4 detection is also the precondition for the AVX2 and SHA-NI checks above.
+    have_shani &= (use_implementation & sha256_implementation::USE_SHANI) != 0;
+    have_avx2 &= (use_implementation & sha256_implementation::USE_AVX2) != 0;
+    have_sse4 &= (use_implementation & sha256_implementation::USE_SSE4) != 0;
 
 #if defined(ENABLE_SHANI) && !defined(BUILD_BITCOIN_INTERNAL)
     if (have_shani) {
@@ -1499,13 +1657,50 @@ std::string SHA256AutoDetect()
 #endif
 #endif
 
-#if defined(__aarch32__) || defined(__aarch64__)
-    // Assign default sha256 transform to armv8 implementation
-    Transform = sha256_armv8::Transform;
-    // Route default sha256d through TransformD64Wrapper and armv8 sha256 transform
-    TransformD64 = sha256_armv8::TransformD64Wrapper<sha256_armv8::Transform>;
-    TransformD64_2way = sha256_armv8::TransformD64Wrapper_2way<sha256_armv8::Transform_2way>;
-    ret = "ArmV8 sha2 extensions";
+#if defined(__aarch64__)
+    bool have_asimd = false;
+    bool have_sha2 = false;
+
+#if defined(__linux__)
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    have_asimd = (hwcap & HWCAP_ASIMD) != 0;
+    have_sha2 = (hwcap & HWCAP_SHA2) != 0;
+#else
+    // No portable way to query the CPU features; trust the compile-time target.
+    have_asimd = true;
+#if defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2)
+    have_sha2 = true;
+#endif
+#endif
+    have_asimd &= (use_implementation & sha256_implementation::USE_NEON) != 0;
+    have_sha2 &= (use_implementation & sha256_implementation::USE_ARMV8) != 0;
+
+    if (have_sha2) {
+      // Assign default sha256 transform to armv8 implementation
+      Transform = sha256_armv8::Transform;
+      // Route default sha256d through TransformD64Wrapper and armv8 sha256 transform
+      TransformD64 = sha256_armv8::TransformD64Wrapper<sha256_armv8::Transform>;
+      TransformD64_2way = sha256_armv8::TransformD64Wrapper_2way<sha256_armv8::Transform_2way>;
+      TransformD64_4way = sha256_armv8::TransformD64_4way;
+      TransformD64_8way = sha256_armv8::TransformD64_8way;
+      ret = "armv8-sha2(1way,2way,4way,8way)";
+      have_asimd = false; // Disable NEON;
+    }
+
+    if (have_asimd) {
+      // No SHA2 extension: keep the scalar transform, but batch SHA256D64 through NEON.
+      TransformD64_4way = sha256d64_neon::Transform_4way;
+      ret += ",neon(4way)";
+    }
+#elif defined(__aarch32__)
+    if (use_implementation & sha256_implementation::USE_ARMV8) {
+      // Assign default sha256 transform to armv8 implementation
+      Transform = sha256_armv8::Transform;
+      // Route default sha256d through TransformD64Wrapper and armv8 sha256 transform
+      TransformD64 = sha256_armv8::TransformD64Wrapper<sha256_armv8::Transform>;
+      TransformD64_2way = sha256_armv8::TransformD64Wrapper_2way<sha256_armv8::Transform_2way>;
+      ret = "ArmV8 sha2 extensions";
+    }
 #endif
 
     assert(SelfTest());
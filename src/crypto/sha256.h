@@ -26,10 +26,24 @@ public:
     CSHA256& Reset();
 };
 
-/** Autodetect the best available SHA256 implementation.
+namespace sha256_implementation {
+/** Bitmask of SHA256 backends that SHA256AutoDetect() may select. */
+enum UseImplementation : uint8_t {
+    STANDARD = 0,
+    USE_SSE4 = 1 << 0,  //!< SSE4 1-way and SSE4.1 4-way (x86)
+    USE_AVX2 = 1 << 1,  //!< AVX2 8-way (x86)
+    USE_SHANI = 1 << 2, //!< SHA-NI 1-way and 2-way (x86)
+    USE_NEON = 1 << 3,  //!< AdvSIMD 4-way (ARM)
+    USE_ARMV8 = 1 << 4, //!< ARMv8 SHA2 extension (ARM)
+    USE_ALL = USE_SSE4 | USE_AVX2 | USE_SHANI | USE_NEON | USE_ARMV8,
+};
+} // namespace sha256_implementation
+
+/** Autodetect the best available SHA256 implementation, restricted to the
+ *  backends in use_implementation. Can be called again to switch backends.
  *  Returns the name of the implementation.
  */
-std::string SHA256AutoDetect();
+std::string SHA256AutoDetect(sha256_implementation::UseImplementation use_implementation = sha256_implementation::USE_ALL);
 
 /** Compute multiple double-SHA256's of 64-byte blobs.
  *  output:  pointer to a blocks*32 byte output buffer
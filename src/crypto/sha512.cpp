@@ -6,8 +6,23 @@
 
 #include <crypto/common.h>
 
+#include <assert.h>
 #include <string.h>
 
+#include <algorithm>
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_SHA512
+#define HWCAP_SHA512 (1 << 21)
+#endif
+#endif
+
+namespace sha512_armv8
+{
+void Transform(uint64_t* s, const unsigned char* chunk, size_t blocks);
+}
+
 // Internal implementation code.
 namespace
 {
@@ -144,10 +159,69 @@ void Transform(uint64_t* s, const unsigned char* chunk)
     s[7] += h;
 }
 
+/** Perform a number of SHA-512 transformations, processing 128-byte chunks. */
+void TransformBlocks(uint64_t* s, const unsigned char* chunk, size_t blocks)
+{
+    while (blocks--) {
+        Transform(s, chunk);
+        chunk += 128;
+    }
+}
+
 } // namespace sha512
 
+typedef void (*TransformType)(uint64_t*, const unsigned char*, size_t);
+
+TransformType Transform = sha512::TransformBlocks;
+
+bool SelfTest() {
+    // Some random input data to test with
+    static const unsigned char data[641] = "-" // Intentionally not aligned
+      "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+      "eiusmod tempor incididunt ut labore et dolore magna aliqua. Et m"
+      "olestie ac feugiat sed lectus vestibulum mattis ullamcorper. Mor"
+      "bi blandit cursus risus at ultrices mi tempus imperdiet nulla. N"
+      "unc congue nisi vita suscipit tellus mauris. Imperdiet proin fer"
+      "mentum leo vel orci. Massa tempor nec feugiat nisl pretium fusce"
+      " id velit. Telus in metus vulputate eu scelerisque felis. Mi tem"
+      "pus imperdiet nulla malesuada pellentesque. Tristique magna sit.";
+    // Expected output state for hashing the i*128 first input bytes above (excluding SHA512 padding).
+    static const uint64_t result[6][8] = {
+      {0x6a09e667f3bcc908ull, 0xbb67ae8584caa73bull, 0x3c6ef372fe94f82bull, 0xa54ff53a5f1d36f1ull, 0x510e527fade682d1ull, 0x9b05688c2b3e6c1full, 0x1f83d9abfb41bd6bull, 0x5be0cd19137e2179ull},
+      {0x1e3927161d49a355ull, 0xdc3b6f3cafd39169ull, 0xfa97663f6bf286d3ull, 0x2c75a11055b8ecf4ull, 0xaa906433796ab46aull, 0x80bf61bb9dd1fbe6ull, 0x6d28b1ba0b6f48d1ull, 0x7cff6a79d5f4263dull},
+      {0x813bdebe11ecb2c1ull, 0xbe7007f568901d56ull, 0x728f9d4292ee201full, 0x274d883d3a5de8c8ull, 0x845934259c4f0056ull, 0x930cb8928d28957aull, 0x2dc983db1df2fcccull, 0xd84c11e568460cf7ull},
+      {0xa468a9ebc6073902ull, 0x9d1093538d319ae9ull, 0x52b1169e10a64384ull, 0xbe1d219cdc6d8a58ull, 0xcb81af82f7dec7e4ull, 0xd71eb9588e7ef64bull, 0xd0e2552f5a60ec41ull, 0x485c83be73d104ecull},
+      {0xf1f843bdbd3fd9b3ull, 0x2f50a214ec1a1281ull, 0xff6175f56d18a912ull, 0xf077aaa6fb554a22ull, 0xfac350e4cf2e225bull, 0xc8ef2fd76cb13b95ull, 0x7f2ac5c43b7787ffull, 0x8ef501252b802fd8ull},
+      {0x34d6762313e5e9b8ull, 0xb97ecc766ed39773ull, 0x96d1678cce66ffb5ull, 0xfb62108e822cb980ull, 0xe3b6f037b1dfa8f2ull, 0xc328c1f36afa36f3ull, 0x24206a1c14c4a882ull, 0xc0a29c1b6b3196f4ull}
+    };
+
+    // Test Transform() for 0 through 5 transformations.
+    for (size_t i = 0; i <= 5; ++i) {
+        uint64_t state[8];
+        std::copy(result[0], result[0] + 8, state);
+        Transform(state, data + 1, i);
+        if (!std::equal(state, state + 8, result[i])) return false;
+    }
+
+    return true;
+}
+
 } // namespace
 
+std::string SHA512AutoDetect()
+{
+    std::string ret = "standard";
+#if defined(__aarch64__) && defined(__linux__) && defined(ENABLE_ARM_SHA512) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (getauxval(AT_HWCAP) & HWCAP_SHA512) {
+        Transform = sha512_armv8::Transform;
+        ret = "armv8.2-sha512";
+    }
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
+
 
 ////// SHA-512
 
@@ -165,14 +239,15 @@ CSHA512& CSHA512::Write(const unsigned char* data, size_t len)
         memcpy(buf + bufsize, data, 128 - bufsize);
         bytes += 128 - bufsize;
         data += 128 - bufsize;
-        sha512::Transform(s, buf);
+        Transform(s, buf, 1);
         bufsize = 0;
     }
-    while (end >= data + 128) {
+    if (end - data >= 128) {
         // Process full chunks directly from the source.
-        sha512::Transform(s, data);
-        data += 128;
-        bytes += 128;
+        size_t blocks = (end - data) / 128;
+        Transform(s, data, blocks);
+        data += 128 * blocks;
+        bytes += 128 * blocks;
     }
     if (end > data) {
         // Fill the buffer with what remains.
@@ -0,0 +1,142 @@
+// Copyright (c) 2019 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// Based on the ARMv8.2 SHA-512 crypto extension code in the Linux kernel,
+// arch/arm64/crypto/sha512-ce-core.S, written by Ard Biesheuvel.
+
+#ifdef ENABLE_ARM_SHA512
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <arm_neon.h>
+
+namespace {
+
+alignas(16) const uint64_t K[80] = {
+    0x428a2f98d728ae22ull, 0x7137449123ef65cdull, 0xb5c0fbcfec4d3b2full, 0xe9b5dba58189dbbcull,
+    0x3956c25bf348b538ull, 0x59f111f1b605d019ull, 0x923f82a4af194f9bull, 0xab1c5ed5da6d8118ull,
+    0xd807aa98a3030242ull, 0x12835b0145706fbeull, 0x243185be4ee4b28cull, 0x550c7dc3d5ffb4e2ull,
+    0x72be5d74f27b896full, 0x80deb1fe3b1696b1ull, 0x9bdc06a725c71235ull, 0xc19bf174cf692694ull,
+    0xe49b69c19ef14ad2ull, 0xefbe4786384f25e3ull, 0x0fc19dc68b8cd5b5ull, 0x240ca1cc77ac9c65ull,
+    0x2de92c6f592b0275ull, 0x4a7484aa6ea6e483ull, 0x5cb0a9dcbd41fbd4ull, 0x76f988da831153b5ull,
+    0x983e5152ee66dfabull, 0xa831c66d2db43210ull, 0xb00327c898fb213full, 0xbf597fc7beef0ee4ull,
+    0xc6e00bf33da88fc2ull, 0xd5a79147930aa725ull, 0x06ca6351e003826full, 0x142929670a0e6e70ull,
+    0x27b70a8546d22ffcull, 0x2e1b21385c26c926ull, 0x4d2c6dfc5ac42aedull, 0x53380d139d95b3dfull,
+    0x650a73548baf63deull, 0x766a0abb3c77b2a8ull, 0x81c2c92e47edaee6ull, 0x92722c851482353bull,
+    0xa2bfe8a14cf10364ull, 0xa81a664bbc423001ull, 0xc24b8b70d0f89791ull, 0xc76c51a30654be30ull,
+    0xd192e819d6ef5218ull, 0xd69906245565a910ull, 0xf40e35855771202aull, 0x106aa07032bbd1b8ull,
+    0x19a4c116b8d2d0c8ull, 0x1e376c085141ab53ull, 0x2748774cdf8eeb99ull, 0x34b0bcb5e19b48a8ull,
+    0x391c0cb3c5c95a63ull, 0x4ed8aa4ae3418acbull, 0x5b9cca4f7763e373ull, 0x682e6ff3d6b2b8a3ull,
+    0x748f82ee5defb2fcull, 0x78a5636f43172f60ull, 0x84c87814a1f0ab72ull, 0x8cc702081a6439ecull,
+    0x90befffa23631e28ull, 0xa4506cebde82bde9ull, 0xbef9a3f7b2c67915ull, 0xc67178f2e372532bull,
+    0xca273eceea26619cull, 0xd186b8c721c0c207ull, 0xeada7dd6cde0eb1eull, 0xf57d4f7fee6ed178ull,
+    0x06f067aa72176fbaull, 0x0a637dc5a2c898a6ull, 0x113f9804bef90daeull, 0x1b710b35131c471bull,
+    0x28db77f523047d84ull, 0x32caab7b40c72493ull, 0x3c9ebe0a15c9bebcull, 0x431d67c49c100d4cull,
+    0x4cc5d4becb3e42b6ull, 0x597f299cfc657e2aull, 0x5fcb6fab3ad6faecull, 0x6c44198c4a475817ull
+};
+
+/** Two SHA-512 rounds. s0..s3 hold the (ab, cd, ef, gh) pairs; the new pairs are left in s3 (ab) and s4 (ef). */
+void inline __attribute__((always_inline)) DoubleRound(uint64x2_t& s0, uint64x2_t& s1, uint64x2_t& s2, uint64x2_t& s3, uint64x2_t& s4, uint64x2_t k, uint64x2_t w)
+{
+    uint64x2_t wk = vaddq_u64(k, w);
+    uint64x2_t fg = vextq_u64(s2, s3, 1);
+    uint64x2_t de = vextq_u64(s1, s2, 1);
+    s3 = vaddq_u64(s3, vextq_u64(wk, wk, 1));
+    s3 = vsha512hq_u64(s3, fg, de);
+    s4 = vaddq_u64(s1, s3);
+    s3 = vsha512h2q_u64(s3, s1, s0);
+}
+
+/** Message schedule update of two words: w0 = sigma(w0, w1, w7, w4:w5). */
+void inline __attribute__((always_inline)) Schedule(uint64x2_t& w0, uint64x2_t w1, uint64x2_t w7, uint64x2_t w4, uint64x2_t w5)
+{
+    w0 = vsha512su1q_u64(vsha512su0q_u64(w0, w1), w7, vextq_u64(w4, w5, 1));
+}
+
+uint64x2_t inline Load(const unsigned char* chunk)
+{
+    return vreinterpretq_u64_u8(vrev64q_u8(vld1q_u8(chunk)));
+}
+
+} // namespace
+
+namespace sha512_armv8 {
+/** Perform a number of SHA-512 transformations via ArmV8.2 extensions, processing 128-byte chunks. */
+void Transform(uint64_t* s, const unsigned char* chunk, size_t blocks)
+{
+    uint64x2_t ab = vld1q_u64(s);
+    uint64x2_t cd = vld1q_u64(s + 2);
+    uint64x2_t ef = vld1q_u64(s + 4);
+    uint64x2_t gh = vld1q_u64(s + 6);
+
+    while (blocks--) {
+        uint64x2_t w0 = Load(chunk);
+        uint64x2_t w1 = Load(chunk + 16);
+        uint64x2_t w2 = Load(chunk + 32);
+        uint64x2_t w3 = Load(chunk + 48);
+        uint64x2_t w4 = Load(chunk + 64);
+        uint64x2_t w5 = Load(chunk + 80);
+        uint64x2_t w6 = Load(chunk + 96);
+        uint64x2_t w7 = Load(chunk + 112);
+        chunk += 128;
+
+        // The five state registers rotate roles every double round, returning
+        // to s0..s3 = (ab, cd, ef, gh) after each group of five.
+        uint64x2_t s0 = ab, s1 = cd, s2 = ef, s3 = gh, s4;
+
+        DoubleRound(s0, s1, s2, s3, s4, vld1q_u64(&K[0]), w0); Schedule(w0, w1, w7, w4, w5);
+        DoubleRound(s3, s0, s4, s2, s1, vld1q_u64(&K[2]), w1); Schedule(w1, w2, w0, w5, w6);
+        DoubleRound(s2, s3, s1, s4, s0, vld1q_u64(&K[4]), w2); Schedule(w2, w3, w1, w6, w7);
+        DoubleRound(s4, s2, s0, s1, s3, vld1q_u64(&K[6]), w3); Schedule(w3, w4, w2, w7, w0);
+        DoubleRound(s1, s4, s3, s0, s2, vld1q_u64(&K[8]), w4); Schedule(w4, w5, w3, w0, w1);
+        DoubleRound(s0, s1, s2, s3, s4, vld1q_u64(&K[10]), w5); Schedule(w5, w6, w4, w1, w2);
+        DoubleRound(s3, s0, s4, s2, s1, vld1q_u64(&K[12]), w6); Schedule(w6, w7, w5, w2, w3);
+        DoubleRound(s2, s3, s1, s4, s0, vld1q_u64(&K[14]), w7); Schedule(w7, w0, w6, w3, w4);
+        DoubleRound(s4, s2, s0, s1, s3, vld1q_u64(&K[16]), w0); Schedule(w0, w1, w7, w4, w5);
+        DoubleRound(s1, s4, s3, s0, s2, vld1q_u64(&K[18]), w1); Schedule(w1, w2, w0, w5, w6);
+        DoubleRound(s0, s1, s2, s3, s4, vld1q_u64(&K[20]), w2); Schedule(w2, w3, w1, w6, w7);
+        DoubleRound(s3, s0, s4, s2, s1, vld1q_u64(&K[22]), w3); Schedule(w3, w4, w2, w7, w0);
+        DoubleRound(s2, s3, s1, s4, s0, vld1q_u64(&K[24]), w4); Schedule(w4, w5, w3, w0, w1);
+        DoubleRound(s4, s2, s0, s1, s3, vld1q_u64(&K[26]), w5); Schedule(w5, w6, w4, w1, w2);
+        DoubleRound(s1, s4, s3, s0, s2, vld1q_u64(&K[28]), w6); Schedule(w6, w7, w5, w2, w3);
+        DoubleRound(s0, s1, s2, s3, s4, vld1q_u64(&K[30]), w7); Schedule(w7, w0, w6, w3, w4);
+        DoubleRound(s3, s0, s4, s2, s1, vld1q_u64(&K[32]), w0); Schedule(w0, w1, w7, w4, w5);
+        DoubleRound(s2, s3, s1, s4, s0, vld1q_u64(&K[34]), w1); Schedule(w1, w2, w0, w5, w6);
+        DoubleRound(s4, s2, s0, s1, s3, vld1q_u64(&K[36]), w2); Schedule(w2, w3, w1, w6, w7);
+        DoubleRound(s1, s4, s3, s0, s2, vld1q_u64(&K[38]), w3); Schedule(w3, w4, w2, w7, w0);
+        DoubleRound(s0, s1, s2, s3, s4, vld1q_u64(&K[40]), w4); Schedule(w4, w5, w3, w0, w1);
+        DoubleRound(s3, s0, s4, s2, s1, vld1q_u64(&K[42]), w5); Schedule(w5, w6, w4, w1, w2);
+        DoubleRound(s2, s3, s1, s4, s0, vld1q_u64(&K[44]), w6); Schedule(w6, w7, w5, w2, w3);
+        DoubleRound(s4, s2, s0, s1, s3, vld1q_u64(&K[46]), w7); Schedule(w7, w0, w6, w3, w4);
+        DoubleRound(s1, s4, s3, s0, s2, vld1q_u64(&K[48]), w0); Schedule(w0, w1, w7, w4, w5);
+        DoubleRound(s0, s1, s2, s3, s4, vld1q_u64(&K[50]), w1); Schedule(w1, w2, w0, w5, w6);
+        DoubleRound(s3, s0, s4, s2, s1, vld1q_u64(&K[52]), w2); Schedule(w2, w3, w1, w6, w7);
+        DoubleRound(s2, s3, s1, s4, s0, vld1q_u64(&K[54]), w3); Schedule(w3, w4, w2, w7, w0);
+        DoubleRound(s4, s2, s0, s1, s3, vld1q_u64(&K[56]), w4); Schedule(w4, w5, w3, w0, w1);
+        DoubleRound(s1, s4, s3, s0, s2, vld1q_u64(&K[58]), w5); Schedule(w5, w6, w4, w1, w2);
+        DoubleRound(s0, s1, s2, s3, s4, vld1q_u64(&K[60]), w6); Schedule(w6, w7, w5, w2, w3);
+        DoubleRound(s3, s0, s4, s2, s1, vld1q_u64(&K[62]), w7); Schedule(w7, w0, w6, w3, w4);
+        DoubleRound(s2, s3, s1, s4, s0, vld1q_u64(&K[64]), w0);
+        DoubleRound(s4, s2, s0, s1, s3, vld1q_u64(&K[66]), w1);
+        DoubleRound(s1, s4, s3, s0, s2, vld1q_u64(&K[68]), w2);
+        DoubleRound(s0, s1, s2, s3, s4, vld1q_u64(&K[70]), w3);
+        DoubleRound(s3, s0, s4, s2, s1, vld1q_u64(&K[72]), w4);
+        DoubleRound(s2, s3, s1, s4, s0, vld1q_u64(&K[74]), w5);
+        DoubleRound(s4, s2, s0, s1, s3, vld1q_u64(&K[76]), w6);
+        DoubleRound(s1, s4, s3, s0, s2, vld1q_u64(&K[78]), w7);
+
+        ab = vaddq_u64(ab, s0);
+        cd = vaddq_u64(cd, s1);
+        ef = vaddq_u64(ef, s2);
+        gh = vaddq_u64(gh, s3);
+    }
+
+    vst1q_u64(s, ab);
+    vst1q_u64(s + 2, cd);
+    vst1q_u64(s + 4, ef);
+    vst1q_u64(s + 6, gh);
+}
+} // namespace sha512_armv8
+
+#endif
@@ -4,6 +4,12 @@
 
 #include <crypto/siphash.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
 
 #define SIPROUND do { \
@@ -171,3 +177,94 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
     SIPROUND;
     return v0 ^ v1 ^ v2 ^ v3;
 }
+
+namespace {
+
+#if defined(__SSE2__) || defined(__aarch64__)
+/* Two-lane SipHash: each 128-bit vector holds the same state word of two
+ * independent hashes. SSE2 is part of the x86-64 base ISA and AdvSIMD of
+ * AArch64, so no runtime detection is needed. */
+#if defined(__SSE2__)
+typedef __m128i Vec2;
+inline Vec2 Set2(uint64_t a, uint64_t b) { return _mm_set_epi64x(b, a); }
+inline Vec2 Add(Vec2 x, Vec2 y) { return _mm_add_epi64(x, y); }
+inline Vec2 Xor(Vec2 x, Vec2 y) { return _mm_xor_si128(x, y); }
+template<int n> inline Vec2 RotL(Vec2 x) { return _mm_or_si128(_mm_slli_epi64(x, n), _mm_srli_epi64(x, 64 - n)); }
+template<> inline Vec2 RotL<32>(Vec2 x) { return _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)); }
+inline void Store2(uint64_t* out, Vec2 x) { _mm_storeu_si128((__m128i*)out, x); }
+#else
+typedef uint64x2_t Vec2;
+inline Vec2 Set2(uint64_t a, uint64_t b) { return vcombine_u64(vcreate_u64(a), vcreate_u64(b)); }
+inline Vec2 Add(Vec2 x, Vec2 y) { return vaddq_u64(x, y); }
+inline Vec2 Xor(Vec2 x, Vec2 y) { return veorq_u64(x, y); }
+template<int n> inline Vec2 RotL(Vec2 x) { return vsriq_n_u64(vshlq_n_u64(x, n), x, 64 - n); }
+template<> inline Vec2 RotL<32>(Vec2 x) { return vreinterpretq_u64_u32(vrev64q_u32(vreinterpretq_u32_u64(x))); }
+inline void Store2(uint64_t* out, Vec2 x) { vst1q_u64(out, x); }
+#endif
+
+inline void SipRound2(Vec2& v0, Vec2& v1, Vec2& v2, Vec2& v3)
+{
+    v0 = Add(v0, v1); v1 = RotL<13>(v1); v1 = Xor(v1, v0);
+    v0 = RotL<32>(v0);
+    v2 = Add(v2, v3); v3 = RotL<16>(v3); v3 = Xor(v3, v2);
+    v0 = Add(v0, v3); v3 = RotL<21>(v3); v3 = Xor(v3, v0);
+    v2 = Add(v2, v1); v1 = RotL<17>(v1); v1 = Xor(v1, v2);
+    v2 = RotL<32>(v2);
+}
+
+inline void Compress2(Vec2& v0, Vec2& v1, Vec2& v2, Vec2& v3, Vec2 d)
+{
+    v3 = Xor(v3, d);
+    SipRound2(v0, v1, v2, v3);
+    SipRound2(v0, v1, v2, v3);
+    v0 = Xor(v0, d);
+}
+
+/** Hash *vals[0] and *vals[1], with the given final (length-tagged) words. */
+void SipHashUint256_2way(uint64_t k0, uint64_t k1, const uint256* const* vals, uint64_t last0, uint64_t last1, uint64_t* out)
+{
+    Vec2 v0 = Set2(0x736f6d6570736575ULL ^ k0, 0x736f6d6570736575ULL ^ k0);
+    Vec2 v1 = Set2(0x646f72616e646f6dULL ^ k1, 0x646f72616e646f6dULL ^ k1);
+    Vec2 v2 = Set2(0x6c7967656e657261ULL ^ k0, 0x6c7967656e657261ULL ^ k0);
+    Vec2 v3 = Set2(0x7465646279746573ULL ^ k1, 0x7465646279746573ULL ^ k1);
+
+    for (int i = 0; i < 4; ++i) {
+        Compress2(v0, v1, v2, v3, Set2(vals[0]->GetUint64(i), vals[1]->GetUint64(i)));
+    }
+    Compress2(v0, v1, v2, v3, Set2(last0, last1));
+    v2 = Xor(v2, Set2(0xFF, 0xFF));
+    SipRound2(v0, v1, v2, v3);
+    SipRound2(v0, v1, v2, v3);
+    SipRound2(v0, v1, v2, v3);
+    SipRound2(v0, v1, v2, v3);
+    Store2(out, Xor(Xor(v0, v1), Xor(v2, v3)));
+}
+#endif
+
+} // namespace
+
+void SipHashUint256Many(uint64_t k0, uint64_t k1, const uint256* const* vals, uint64_t* out, size_t count)
+{
+    size_t i = 0;
+#if defined(__SSE2__) || defined(__aarch64__)
+    for (; i + 2 <= count; i += 2) {
+        SipHashUint256_2way(k0, k1, vals + i, ((uint64_t)4) << 59, ((uint64_t)4) << 59, out + i);
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = SipHashUint256(k0, k1, *vals[i]);
+    }
+}
+
+void SipHashUint256ExtraMany(uint64_t k0, uint64_t k1, const uint256* const* vals, const uint32_t* extras, uint64_t* out, size_t count)
+{
+    size_t i = 0;
+#if defined(__SSE2__) || defined(__aarch64__)
+    for (; i + 2 <= count; i += 2) {
+        SipHashUint256_2way(k0, k1, vals + i, (((uint64_t)36) << 56) | extras[i], (((uint64_t)36) << 56) | extras[i + 1], out + i);
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = SipHashUint256Extra(k0, k1, *vals[i], extras[i]);
+    }
+}
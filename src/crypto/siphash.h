@@ -5,6 +5,7 @@
 #ifndef BITCOIN_CRYPTO_SIPHASH_H
 #define BITCOIN_CRYPTO_SIPHASH_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <uint256.h>
@@ -44,4 +45,13 @@ public:
 uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
 uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint32_t extra);
 
+/** Batch versions of SipHashUint256 and SipHashUint256Extra with a shared key.
+ *
+ *  out[i] is set to SipHashUint256(k0, k1, *vals[i]), resp.
+ *  SipHashUint256Extra(k0, k1, *vals[i], extras[i]), for i < count.
+ *  Several keys are hashed in parallel SIMD lanes where available.
+ */
+void SipHashUint256Many(uint64_t k0, uint64_t k1, const uint256* const* vals, uint64_t* out, size_t count);
+void SipHashUint256ExtraMany(uint64_t k0, uint64_t k1, const uint256* const* vals, const uint32_t* extras, uint64_t* out, size_t count);
+
 #endif // BITCOIN_CRYPTO_SIPHASH_H
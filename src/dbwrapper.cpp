@@ -72,7 +72,7 @@ public:
     }
 };
 
-static void SetMaxOpenFiles(leveldb::Options *options) {
+static void SetMaxOpenFiles(leveldb::Options *options, int max_open_files) {
     // On most platforms the default setting of max_open_files (which is 1000)
     // is optimal. On Windows using a large file count is OK because the handles
     // do not interfere with select() loops. On 64-bit Unix hosts this value is
@@ -88,21 +88,26 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
     // See PR #12495 for further discussion.
 
     int default_open_files = options->max_open_files;
+    if (max_open_files > 0) {
+        options->max_open_files = std::min(max_open_files, default_open_files);
+    }
 #ifndef WIN32
     if (sizeof(void*) < 8) {
-        options->max_open_files = 64;
+        options->max_open_files = std::min(options->max_open_files, 64);
     }
 #endif
     LogPrint(BCLog::LEVELDB, "LevelDB using max_open_files=%d (default=%d)\n",
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+static leveldb::Options GetOptions(size_t nCacheSize, const DBTuning& tuning)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    options.block_cache = leveldb::NewLRUCache((uint64_t)nCacheSize * tuning.block_cache_percent / 100);
+    options.write_buffer_size = (uint64_t)nCacheSize * tuning.write_buffer_percent / 100; // up to two write buffers may be held in memory simultaneously
+    options.block_size = tuning.block_size;
+    options.max_file_size = tuning.max_file_size;
+    options.filter_policy = tuning.bloom_bits > 0 ? leveldb::NewBloomFilterPolicy(tuning.bloom_bits) : nullptr;
     options.compression = leveldb::kNoCompression;
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
@@ -110,11 +115,50 @@ static leveldb::Options GetOptions(size_t nCacheSize)
         // on corruption in later versions.
         options.paranoid_checks = true;
     }
-    SetMaxOpenFiles(&options);
+    SetMaxOpenFiles(&options, tuning.max_open_files);
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+bool GetDBProfile(const std::string& profile, DBTuning& tuning)
+{
+    tuning = DBTuning();
+    if (profile == "default") {
+        return true;
+    }
+    if (profile == "randomread") {
+        // Point lookups, many of them for missing keys: spend the memory on
+        // cached blocks and make the bloom filter more selective.
+        tuning.bloom_bits = 16;
+        tuning.block_cache_percent = 70;
+        tuning.write_buffer_percent = 15;
+        return true;
+    }
+    if (profile == "bulkwrite") {
+        // Large batches of writes: bigger write buffers and files mean fewer
+        // level-0 files to compact, and bigger blocks fewer index entries.
+        tuning.block_size = 16384;
+        tuning.block_cache_percent = 30;
+        tuning.write_buffer_percent = 35;
+        tuning.max_file_size = 32 << 20;
+        return true;
+    }
+    return false;
+}
+
+DBTuning GetDBTuning(const std::string& db_name)
+{
+    DBTuning tuning;
+    for (const std::string& arg : gArgs.GetArgs("-dbprofile")) {
+        const size_t colon = arg.find(':');
+        if (colon != std::string::npos && arg.substr(0, colon) == db_name) {
+            // The profile names were validated at startup; later arguments win.
+            GetDBProfile(arg.substr(colon + 1), tuning);
+        }
+    }
+    return tuning;
+}
+
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const DBTuning& tuning)
     : m_name(fs::basename(path))
 {
     penv = nullptr;
@@ -122,7 +166,7 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, tuning);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
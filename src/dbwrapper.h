@@ -27,6 +27,34 @@ public:
 
 class CDBWrapper;
 
+/**
+ * LevelDB settings that depend on how a database is accessed. Named profiles
+ * of them can be selected per database with -dbprofile.
+ */
+struct DBTuning
+{
+    //! Approximate amount of user data packed per block, in bytes
+    size_t block_size = 4096;
+    //! Bits per key of the bloom filter, or 0 for no filter
+    int bloom_bits = 10;
+    //! Maximum number of open files, or 0 for the platform default
+    int max_open_files = 0;
+    //! Shares of the cache size used for the block cache and for each of the
+    //! up to two write buffers, in percent. Their sum, with the write buffer
+    //! share counted twice, should not exceed 100.
+    int block_cache_percent = 50;
+    int write_buffer_percent = 25;
+    //! Size at which table files are split. Larger files mean fewer, larger
+    //! compactions.
+    size_t max_file_size = 2 << 20;
+};
+
+/** Get the settings of the named profile. Returns false if there is no such profile. */
+bool GetDBProfile(const std::string& profile, DBTuning& tuning);
+
+/** Get the settings selected by -dbprofile for the named database, or the defaults. */
+DBTuning GetDBTuning(const std::string& db_name);
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -220,8 +248,9 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] tuning      LevelDB settings suited to how the database is accessed.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const DBTuning& tuning = DBTuning());
     ~CDBWrapper();
 
     CDBWrapper(const CDBWrapper&) = delete;
@@ -310,6 +339,30 @@ public:
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
     }
 
+    /**
+     * Return an iterator over the state of the database captured by snapshot
+     * (see GetSnapshot()) rather than its current state.
+     */
+    CDBIterator *NewIterator(const leveldb::Snapshot* snapshot)
+    {
+        leveldb::ReadOptions options = iteroptions;
+        options.snapshot = snapshot;
+        return new CDBIterator(*this, pdb->NewIterator(options));
+    }
+
+    /**
+     * Capture the current state of the database. Iterators created from the
+     * snapshot see that state regardless of later writes, which lets several
+     * of them scan parts of the database consistently with each other. The
+     * snapshot is released when the last reference goes away, which must
+     * happen before this object is destroyed.
+     */
+    std::shared_ptr<const leveldb::Snapshot> GetSnapshot() const
+    {
+        leveldb::DB* db = pdb;
+        return std::shared_ptr<const leveldb::Snapshot>(pdb->GetSnapshot(), [db](const leveldb::Snapshot* snapshot) { db->ReleaseSnapshot(snapshot); });
+    }
+
     /**
      * Return true if the database managed by this class contains no entries.
      */
@@ -0,0 +1,413 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_FLATNODEMAP_H
+#define BITCOIN_FLATNODEMAP_H
+
+#include <support/allocators/pool.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iterator>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace flatnodemap_detail {
+
+/** Number of control bytes probed at once. */
+static const size_t GROUP_WIDTH = 16;
+
+/** Control byte values. Full slots hold the low 7 bits of the key's hash. */
+static const int8_t CTRL_EMPTY = -128;
+static const int8_t CTRL_DELETED = -2;
+
+/**
+ * Bitmask of the matching control bytes in a group, lowest slot first.
+ * Each slot occupies 1 << SHIFT bits, of which only the top one is set.
+ */
+template <int SHIFT>
+class BitMask
+{
+    uint64_t m_bits;
+
+public:
+    explicit BitMask(uint64_t bits) : m_bits(bits) {}
+    explicit operator bool() const { return m_bits != 0; }
+    size_t Lowest() const
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(m_bits) >> SHIFT;
+#else
+        size_t n = 0;
+        while (!((m_bits >> n) & 1)) ++n;
+        return n >> SHIFT;
+#endif
+    }
+    void ClearLowest() { m_bits &= m_bits - 1; }
+};
+
+/** A group of GROUP_WIDTH control bytes, compared in parallel where the platform allows. */
+class Group
+{
+#if defined(__SSE2__)
+    __m128i m_ctrl;
+
+public:
+    typedef BitMask<0> Mask;
+    explicit Group(const int8_t* ctrl) : m_ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))) {}
+    Mask Match(int8_t tag) const { return Mask((uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), m_ctrl))); }
+    Mask MatchEmpty() const { return Match(CTRL_EMPTY); }
+    /** Empty and deleted are the only control bytes with the sign bit set. */
+    Mask MatchEmptyOrDeleted() const { return Mask((uint16_t)_mm_movemask_epi8(m_ctrl)); }
+#elif defined(__aarch64__)
+public:
+    typedef BitMask<2> Mask;
+
+private:
+    int8x16_t m_ctrl;
+
+    /** Narrow a byte-wise comparison result to 4 bits per byte, keeping one bit each. */
+    static Mask ToMask(uint8x16_t cmp)
+    {
+        uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4)), 0);
+        return Mask(bits & 0x8888888888888888ULL);
+    }
+
+public:
+    explicit Group(const int8_t* ctrl) : m_ctrl(vld1q_s8(ctrl)) {}
+    Mask Match(int8_t tag) const { return ToMask(vceqq_s8(m_ctrl, vdupq_n_s8(tag))); }
+    Mask MatchEmpty() const { return Match(CTRL_EMPTY); }
+    Mask MatchEmptyOrDeleted() const { return ToMask(vcltq_s8(m_ctrl, vdupq_n_s8(0))); }
+#else
+    const int8_t* m_ctrl;
+
+public:
+    typedef BitMask<0> Mask;
+    explicit Group(const int8_t* ctrl) : m_ctrl(ctrl) {}
+    Mask Match(int8_t tag) const
+    {
+        uint64_t bits = 0;
+        for (size_t i = 0; i < GROUP_WIDTH; ++i) {
+            bits |= uint64_t{m_ctrl[i] == tag} << i;
+        }
+        return Mask(bits);
+    }
+    Mask MatchEmpty() const { return Match(CTRL_EMPTY); }
+    Mask MatchEmptyOrDeleted() const
+    {
+        uint64_t bits = 0;
+        for (size_t i = 0; i < GROUP_WIDTH; ++i) {
+            bits |= uint64_t{m_ctrl[i] < 0} << i;
+        }
+        return Mask(bits);
+    }
+#endif
+};
+
+} // namespace flatnodemap_detail
+
+/**
+ * Open-addressing hash map with a flat index and pool-allocated entries.
+ *
+ * The index is an array of one control byte per slot (empty, deleted, or 7
+ * bits of the key's hash) plus an array of entry pointers. Lookups probe 16
+ * control bytes at a time (SSE2 or NEON where available) and only follow an
+ * entry pointer when its hash bits match, so a miss usually costs one cache
+ * line and a hit one more, instead of walking a bucket chain.
+ *
+ * The entries themselves live in a PoolResource and never move, so, as with
+ * std::unordered_map, references and pointers to elements stay valid until
+ * the element is erased, while iterators are invalidated by insertions that
+ * grow the index. Erasing does not move other elements; erase(it++) works.
+ *
+ * Only the subset of the std::unordered_map interface used by the UTXO cache
+ * is provided.
+ */
+template <typename Key, typename T, typename Hash>
+class FlatNodeMap
+{
+public:
+    typedef Key key_type;
+    typedef T mapped_type;
+    typedef std::pair<const Key, T> value_type;
+    typedef Hash hasher;
+    typedef PoolResource<sizeof(value_type), alignof(value_type)> ResourceType;
+
+private:
+    typedef flatnodemap_detail::Group Group;
+    static const size_t GROUP_WIDTH = flatnodemap_detail::GROUP_WIDTH;
+
+    std::vector<int8_t> m_ctrl;
+    std::vector<value_type*> m_slots;
+    size_t m_size = 0;
+    //! Number of empty slots that may still be filled before the index must grow.
+    size_t m_growth_left = 0;
+    Hash m_hash;
+    ResourceType* m_resource;
+
+    template <bool IS_CONST>
+    class Iter
+    {
+        friend class FlatNodeMap;
+        template <bool>
+        friend class Iter;
+        typedef typename std::conditional<IS_CONST, const FlatNodeMap*, FlatNodeMap*>::type MapPtr;
+        MapPtr m_map;
+        size_t m_index;
+
+        Iter(MapPtr map, size_t index) : m_map(map), m_index(index) { SkipEmpty(); }
+        void SkipEmpty()
+        {
+            while (m_index < m_map->m_ctrl.size() && m_map->m_ctrl[m_index] < 0) ++m_index;
+        }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename FlatNodeMap::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef typename std::conditional<IS_CONST, const value_type*, value_type*>::type pointer;
+        typedef typename std::conditional<IS_CONST, const value_type&, value_type&>::type reference;
+
+        Iter() : m_map(nullptr), m_index(0) {}
+        template <bool OTHER_CONST, typename = typename std::enable_if<IS_CONST && !OTHER_CONST>::type>
+        Iter(const Iter<OTHER_CONST>& other) : m_map(other.m_map), m_index(other.m_index) {}
+
+        reference operator*() const { return *m_map->m_slots[m_index]; }
+        pointer operator->() const { return m_map->m_slots[m_index]; }
+        Iter& operator++() { ++m_index; SkipEmpty(); return *this; }
+        Iter operator++(int) { Iter ret = *this; ++*this; return ret; }
+        bool operator==(const Iter& other) const { return m_index == other.m_index; }
+        bool operator!=(const Iter& other) const { return m_index != other.m_index; }
+    };
+
+public:
+    typedef Iter<false> iterator;
+    typedef Iter<true> const_iterator;
+
+    explicit FlatNodeMap(ResourceType* resource, const Hash& hash = Hash()) : m_hash(hash), m_resource(resource) {}
+
+    FlatNodeMap(const FlatNodeMap&) = delete;
+    FlatNodeMap& operator=(const FlatNodeMap&) = delete;
+
+    ~FlatNodeMap() { DestroyEntries(); }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, m_ctrl.size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m_ctrl.size()); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    //! Number of slots in the index.
+    size_t capacity() const { return m_ctrl.size(); }
+    const Hash& hash_function() const { return m_hash; }
+    ResourceType* resource() const { return m_resource; }
+
+    iterator find(const Key& key) { return find(key, m_hash(key)); }
+    const_iterator find(const Key& key) const { return find(key, m_hash(key)); }
+
+    /** Look up a key whose hash (as computed by hash_function()) is already known. */
+    iterator find(const Key& key, size_t hash)
+    {
+        return iterator(this, FindIndex(key, hash));
+    }
+    const_iterator find(const Key& key, size_t hash) const
+    {
+        return const_iterator(this, FindIndex(key, hash));
+    }
+
+    /** Prefetch the part of the index a lookup for this hash will probe first. */
+    void PrefetchHash(size_t hash) const
+    {
+#if defined(__GNUC__)
+        if (m_ctrl.empty()) return;
+        const size_t pos = ProbeStart(hash) * GROUP_WIDTH;
+        __builtin_prefetch(&m_ctrl[pos]);
+        __builtin_prefetch(&m_slots[pos]);
+#endif
+    }
+
+    /** Insert key with a value constructed from args, unless the key is present already. */
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args)
+    {
+        const size_t hash = m_hash(key);
+        const size_t found = FindIndex(key, hash);
+        if (found != m_ctrl.size()) return std::make_pair(iterator(this, found), false);
+
+        size_t index = m_ctrl.empty() ? 0 : FindInsertIndex(hash);
+        if (m_ctrl.empty() || (m_growth_left == 0 && m_ctrl[index] == flatnodemap_detail::CTRL_EMPTY)) {
+            Grow();
+            index = FindInsertIndex(hash);
+        }
+
+        void* mem = m_resource->Allocate(sizeof(value_type), alignof(value_type));
+        try {
+            m_slots[index] = ::new (mem) value_type(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+        } catch (...) {
+            m_resource->Deallocate(mem, sizeof(value_type), alignof(value_type));
+            throw;
+        }
+        if (m_ctrl[index] == flatnodemap_detail::CTRL_EMPTY) --m_growth_left;
+        m_ctrl[index] = Tag(hash);
+        ++m_size;
+        return std::make_pair(iterator(this, index), true);
+    }
+
+    T& operator[](const Key& key)
+    {
+        return try_emplace(key).first->second;
+    }
+
+    template <typename M>
+    std::pair<iterator, bool> emplace(const Key& key, M&& obj)
+    {
+        return try_emplace(key, std::forward<M>(obj));
+    }
+
+    /** Erase the element at pos. Returns an iterator to the next element. */
+    iterator erase(const_iterator pos)
+    {
+        const size_t index = pos.m_index;
+        DestroyEntry(m_slots[index]);
+        m_slots[index] = nullptr;
+        // A group without empty slots may have been probed past on insertion,
+        // so it must keep looking occupied to lookups: leave a tombstone.
+        const size_t group_start = index - index % GROUP_WIDTH;
+        if (Group(&m_ctrl[group_start]).MatchEmpty()) {
+            m_ctrl[index] = flatnodemap_detail::CTRL_EMPTY;
+            ++m_growth_left;
+        } else {
+            m_ctrl[index] = flatnodemap_detail::CTRL_DELETED;
+        }
+        --m_size;
+        return iterator(this, index + 1);
+    }
+
+    size_t erase(const Key& key)
+    {
+        const_iterator it = find(key);
+        if (it == cend()) return 0;
+        erase(it);
+        return 1;
+    }
+
+    /** Remove all elements. The index keeps its size. */
+    void clear()
+    {
+        DestroyEntries();
+        std::fill(m_ctrl.begin(), m_ctrl.end(), flatnodemap_detail::CTRL_EMPTY);
+        std::fill(m_slots.begin(), m_slots.end(), nullptr);
+        m_size = 0;
+        m_growth_left = MaxLoad(m_ctrl.size());
+    }
+
+private:
+    static int8_t Tag(size_t hash) { return hash & 0x7f; }
+
+    /** The index is kept at most 7/8 full, counting tombstones. */
+    static size_t MaxLoad(size_t capacity) { return capacity - capacity / 8; }
+
+    /** First group probed for this hash. Tag() uses the low bits, so skip them. */
+    size_t ProbeStart(size_t hash) const { return (hash >> 7) & (m_ctrl.size() / GROUP_WIDTH - 1); }
+
+    /**
+     * Visit groups in triangular order (start, +1, +3, +6, ...), which covers
+     * every group when their number is a power of two. Returns the slot index
+     * for which visit() returns true.
+     */
+    template <typename F>
+    size_t Probe(size_t hash, F visit) const
+    {
+        const size_t group_mask = m_ctrl.size() / GROUP_WIDTH - 1;
+        size_t group = ProbeStart(hash);
+        for (size_t step = 1;; ++step) {
+            size_t found;
+            if (visit(group * GROUP_WIDTH, found)) return found;
+            group = (group + step) & group_mask;
+        }
+    }
+
+    size_t FindIndex(const Key& key, size_t hash) const
+    {
+        if (m_ctrl.empty()) return 0;
+        const int8_t tag = Tag(hash);
+        return Probe(hash, [&](size_t start, size_t& found) {
+            Group group(&m_ctrl[start]);
+            for (auto match = group.Match(tag); match; match.ClearLowest()) {
+                const size_t index = start + match.Lowest();
+                if (m_slots[index]->first == key) {
+                    found = index;
+                    return true;
+                }
+            }
+            // An empty slot ends the probe sequence: the key would have been inserted there.
+            found = m_ctrl.size();
+            return bool(group.MatchEmpty());
+        });
+    }
+
+    /** First empty or deleted slot in the key's probe sequence. */
+    size_t FindInsertIndex(size_t hash) const
+    {
+        return Probe(hash, [&](size_t start, size_t& found) {
+            auto match = Group(&m_ctrl[start]).MatchEmptyOrDeleted();
+            if (!match) return false;
+            found = start + match.Lowest();
+            return true;
+        });
+    }
+
+    /** Make room for one more element: drop tombstones, or double the index if that would not free enough. */
+    void Grow()
+    {
+        const size_t capacity = m_ctrl.size();
+        Rehash(capacity == 0 ? GROUP_WIDTH : (m_size < MaxLoad(capacity) / 2 ? capacity : capacity * 2));
+    }
+
+    void Rehash(size_t new_capacity)
+    {
+        std::vector<int8_t> old_ctrl(new_capacity, flatnodemap_detail::CTRL_EMPTY);
+        std::vector<value_type*> old_slots(new_capacity, nullptr);
+        old_ctrl.swap(m_ctrl);
+        old_slots.swap(m_slots);
+        for (size_t i = 0; i < old_ctrl.size(); ++i) {
+            if (old_ctrl[i] < 0) continue;
+            const size_t hash = m_hash(old_slots[i]->first);
+            const size_t index = FindInsertIndex(hash);
+            m_ctrl[index] = Tag(hash);
+            m_slots[index] = old_slots[i];
+        }
+        m_growth_left = MaxLoad(new_capacity) - m_size;
+    }
+
+    void DestroyEntry(value_type* entry)
+    {
+        entry->~value_type();
+        m_resource->Deallocate(entry, sizeof(value_type), alignof(value_type));
+    }
+
+    void DestroyEntries()
+    {
+        for (size_t i = 0; i < m_ctrl.size(); ++i) {
+            if (m_ctrl[i] >= 0) DestroyEntry(m_slots[i]);
+        }
+    }
+};
+
+#endif // BITCOIN_FLATNODEMAP_H
@@ -0,0 +1,352 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <frozencoins.h>
+
+#include <clientversion.h>
+#include <compat.h>
+#include <crypto/common.h>
+#include <serialize.h>
+#include <streams.h>
+#include <util/system.h>
+#include <version.h>
+
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+const unsigned char FROZEN_MAGIC[4] = {'f', 'r', 'z', 'n'};
+const uint16_t FROZEN_VERSION = 1;
+//! Magic, version, block hash, height, coin count, index offset and index count
+const size_t FROZEN_HEADER_SIZE = 4 + 2 + 32 + 4 + 8 + 8 + 8;
+//! Txid, vout index and record offset
+const size_t FROZEN_INDEX_ENTRY_SIZE = 32 + 4 + 8;
+
+/** Minimal stream reading from the mapped file. */
+class MemoryReader
+{
+    const unsigned char* const m_begin;
+    const unsigned char* m_pos;
+    const unsigned char* const m_end;
+
+public:
+    MemoryReader(const unsigned char* begin, const unsigned char* end, size_t pos) : m_begin(begin), m_pos(begin + pos), m_end(end) {}
+
+    void read(char* dst, size_t size)
+    {
+        if (size > (size_t)(m_end - m_pos)) {
+            throw std::ios_base::failure("MemoryReader::read(): end of data");
+        }
+        memcpy(dst, m_pos, size);
+        m_pos += size;
+    }
+
+    void ignore(size_t size)
+    {
+        if (size > (size_t)(m_end - m_pos)) {
+            throw std::ios_base::failure("MemoryReader::ignore(): end of data");
+        }
+        m_pos += size;
+    }
+
+    template <typename T>
+    MemoryReader& operator>>(T&& obj)
+    {
+        ::Unserialize(*this, obj);
+        return *this;
+    }
+
+    size_t GetPos() const { return m_pos - m_begin; }
+
+    int GetVersion() const { return PROTOCOL_VERSION; }
+    int GetType() const { return SER_DISK; }
+};
+
+} // namespace
+
+bool CoinKeyLess(const COutPoint& a, const COutPoint& b)
+{
+    const int cmp = memcmp(a.hash.begin(), b.hash.begin(), a.hash.size());
+    if (cmp != 0 || a.n == b.n) return cmp < 0;
+    // The keys hold VARINT(n), whose encodings of different lengths do not
+    // sort like the numbers they encode.
+    std::vector<unsigned char> var_a, var_b;
+    CVectorWriter(SER_DISK, 0, var_a, 0, VARINT(a.n));
+    CVectorWriter(SER_DISK, 0, var_b, 0, VARINT(b.n));
+    return var_a < var_b;
+}
+
+/** Cursor over the coins of a frozen coins file, up to a txid prefix. */
+class CCoinsViewFrozenCursor : public CCoinsViewCursor
+{
+public:
+    CCoinsViewFrozenCursor(const CCoinsViewFrozen& view, size_t pos, uint32_t end)
+        : CCoinsViewCursor(view.GetBestBlock()), m_view(view), m_next(pos), m_end(end)
+    {
+        Next();
+    }
+
+    bool GetKey(COutPoint& key) const override
+    {
+        if (!m_valid) return false;
+        key = m_key;
+        return true;
+    }
+
+    bool GetValue(Coin& coin) const override
+    {
+        if (!m_valid) return false;
+        m_view.ReadCoin(m_coin_pos, m_coin_size, coin);
+        return true;
+    }
+
+    unsigned int GetValueSize() const override { return m_coin_size; }
+
+    bool Valid() const override { return m_valid; }
+
+    void Next() override
+    {
+        m_valid = m_next < m_view.m_index_begin;
+        if (!m_valid) return;
+        m_view.ReadRecord(m_next, m_key, m_coin_pos, m_coin_size);
+        m_valid = CoinsRangePrefix(m_key.hash) < m_end;
+    }
+
+private:
+    const CCoinsViewFrozen& m_view;
+    //! Offset of the record after the current one
+    size_t m_next;
+    const uint32_t m_end;
+    bool m_valid = false;
+    COutPoint m_key;
+    size_t m_coin_pos = 0;
+    size_t m_coin_size = 0;
+};
+
+CCoinsViewFrozen::CCoinsViewFrozen(const fs::path& path)
+{
+#ifndef WIN32
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error(strprintf("Cannot open frozen coins file %s", path.string()));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)FROZEN_HEADER_SIZE) {
+        close(fd);
+        throw std::runtime_error(strprintf("Frozen coins file %s is truncated", path.string()));
+    }
+    m_size = st.st_size;
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error(strprintf("Cannot map frozen coins file %s", path.string()));
+    }
+    // Lookups jump around the file; reading ahead would only waste memory.
+    posix_madvise(data, m_size, POSIX_MADV_RANDOM);
+    m_data = static_cast<const unsigned char*>(data);
+#else
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        throw std::runtime_error(strprintf("Cannot open frozen coins file %s", path.string()));
+    }
+    m_buffer.resize(fs::file_size(path));
+    file.read((char*)m_buffer.data(), m_buffer.size());
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+#endif
+
+    try {
+        MemoryReader reader(m_data, m_data + m_size, 0);
+        unsigned char magic[sizeof(FROZEN_MAGIC)];
+        uint16_t version;
+        reader.read((char*)magic, sizeof(magic));
+        reader >> version >> m_block >> m_height >> m_coins_count;
+        uint64_t index_begin;
+        reader >> index_begin >> m_index_count;
+        if (memcmp(magic, FROZEN_MAGIC, sizeof(magic)) != 0 || version != FROZEN_VERSION) {
+            throw std::ios_base::failure("unknown format");
+        }
+        m_records_begin = reader.GetPos();
+        m_index_begin = index_begin;
+        if (m_index_begin < m_records_begin || m_index_begin > m_size ||
+            (m_size - m_index_begin) / FROZEN_INDEX_ENTRY_SIZE != m_index_count ||
+            (m_size - m_index_begin) % FROZEN_INDEX_ENTRY_SIZE != 0 ||
+            m_index_count != (m_coins_count + FROZEN_INDEX_INTERVAL - 1) / FROZEN_INDEX_INTERVAL) {
+            throw std::ios_base::failure("inconsistent sizes");
+        }
+    } catch (const std::ios_base::failure& e) {
+#ifndef WIN32
+        munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+        throw std::runtime_error(strprintf("Frozen coins file %s is invalid: %s", path.string(), e.what()));
+    }
+}
+
+CCoinsViewFrozen::~CCoinsViewFrozen()
+{
+#ifndef WIN32
+    munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+}
+
+COutPoint CCoinsViewFrozen::GetIndexKey(uint64_t i) const
+{
+    const unsigned char* entry = m_data + m_index_begin + i * FROZEN_INDEX_ENTRY_SIZE;
+    COutPoint key;
+    memcpy(key.hash.begin(), entry, 32);
+    key.n = ReadLE32(entry + 32);
+    return key;
+}
+
+size_t CCoinsViewFrozen::FindRecords(const COutPoint& key) const
+{
+    // Find the first index entry after key; the record of the one before it
+    // starts the run of records that key would be in.
+    uint64_t low = 0, high = m_index_count;
+    while (low < high) {
+        const uint64_t mid = low + (high - low) / 2;
+        if (CoinKeyLess(key, GetIndexKey(mid))) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    if (low == 0) return m_records_begin;
+    return ReadLE64(m_data + m_index_begin + (low - 1) * FROZEN_INDEX_ENTRY_SIZE + 36);
+}
+
+void CCoinsViewFrozen::ReadRecord(size_t& pos, COutPoint& key, size_t& coin_pos, size_t& coin_size) const
+{
+    MemoryReader reader(m_data, m_data + m_index_begin, pos);
+    reader >> key.hash >> VARINT(key.n);
+    coin_size = ReadCompactSize(reader);
+    coin_pos = reader.GetPos();
+    reader.ignore(coin_size);
+    pos = reader.GetPos();
+}
+
+void CCoinsViewFrozen::ReadCoin(size_t coin_pos, size_t coin_size, Coin& coin) const
+{
+    MemoryReader reader(m_data, m_data + coin_pos + coin_size, coin_pos);
+    reader >> coin;
+}
+
+size_t CCoinsViewFrozen::Seek(const COutPoint& key) const
+{
+    size_t pos = FindRecords(key);
+    while (pos < m_index_begin) {
+        size_t next = pos, coin_pos, coin_size;
+        COutPoint record_key;
+        ReadRecord(next, record_key, coin_pos, coin_size);
+        if (!CoinKeyLess(record_key, key)) break;
+        pos = next;
+    }
+    return pos;
+}
+
+bool CCoinsViewFrozen::Find(const COutPoint& outpoint, size_t& coin_pos, size_t& coin_size) const
+{
+    size_t pos = Seek(outpoint);
+    if (pos >= m_index_begin) return false;
+    COutPoint key;
+    ReadRecord(pos, key, coin_pos, coin_size);
+    return key == outpoint;
+}
+
+bool CCoinsViewFrozen::GetCoin(const COutPoint& outpoint, Coin& coin) const
+{
+    size_t coin_pos, coin_size;
+    if (!Find(outpoint, coin_pos, coin_size)) return false;
+    ReadCoin(coin_pos, coin_size, coin);
+    return true;
+}
+
+bool CCoinsViewFrozen::HaveCoin(const COutPoint& outpoint) const
+{
+    size_t coin_pos, coin_size;
+    return Find(outpoint, coin_pos, coin_size);
+}
+
+CCoinsViewCursor* CCoinsViewFrozen::Cursor() const
+{
+    return new CCoinsViewFrozenCursor(*this, m_records_begin, COINS_RANGE_PREFIXES);
+}
+
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsViewFrozen::RangeCursors(size_t num_ranges) const
+{
+    num_ranges = std::max<size_t>(1, std::min<size_t>(num_ranges, COINS_RANGE_PREFIXES));
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    for (size_t i = 0; i < num_ranges; ++i) {
+        const uint32_t begin = CoinsRangeBegin(i, num_ranges);
+        COutPoint start(uint256(), 0);
+        *start.hash.begin() = begin >> 8;
+        *(start.hash.begin() + 1) = begin & 0xff;
+        cursors.emplace_back(new CCoinsViewFrozenCursor(*this, Seek(start), CoinsRangeBegin(i + 1, num_ranges)));
+    }
+    return cursors;
+}
+
+bool CCoinsViewFrozen::Write(const fs::path& path, CCoinsViewCursor& source, int max_height, uint64_t& coins_count)
+{
+    CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        return error("%s: cannot open %s for writing", __func__, path.string());
+    }
+
+    const uint256 block = source.GetBestBlock();
+    std::vector<std::pair<COutPoint, uint64_t>> index;
+    uint64_t pos = FROZEN_HEADER_SIZE;
+    coins_count = 0;
+    try {
+        // Write the header again once the sizes are known.
+        auto write_header = [&] {
+            file.write((const char*)FROZEN_MAGIC, sizeof(FROZEN_MAGIC));
+            file << FROZEN_VERSION << block << max_height << coins_count << pos << (uint64_t)index.size();
+        };
+        write_header();
+
+        CDataStream record(SER_DISK, PROTOCOL_VERSION);
+        CDataStream value(SER_DISK, PROTOCOL_VERSION);
+        while (source.Valid()) {
+            COutPoint key;
+            Coin coin;
+            if (!source.GetKey(key) || !source.GetValue(coin)) {
+                return error("%s: unable to read coin", __func__);
+            }
+            if ((int)coin.nHeight <= max_height) {
+                if (coins_count % FROZEN_INDEX_INTERVAL == 0) {
+                    index.emplace_back(key, pos);
+                }
+                value.clear();
+                value << coin;
+                record.clear();
+                record << key.hash << VARINT(key.n);
+                WriteCompactSize(record, value.size());
+                record.write(value.data(), value.size());
+                file.write(record.data(), record.size());
+                pos += record.size();
+                ++coins_count;
+            }
+            source.Next();
+        }
+
+        for (const auto& entry : index) {
+            file << entry.first.hash << entry.first.n << entry.second;
+        }
+        if (fseek(file.Get(), 0, SEEK_SET) != 0) {
+            return error("%s: cannot seek in %s", __func__, path.string());
+        }
+        write_header();
+    } catch (const std::exception& e) {
+        return error("%s: %s", __func__, e.what());
+    }
+    if (!FileCommit(file.Get())) {
+        return error("%s: cannot commit %s", __func__, path.string());
+    }
+    return true;
+}
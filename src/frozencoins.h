@@ -0,0 +1,93 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_FROZENCOINS_H
+#define BITCOIN_FROZENCOINS_H
+
+#include <coins.h>
+#include <fs.h>
+#include <primitives/transaction.h>
+#include <uint256.h>
+
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+class CCoinsViewFrozenCursor;
+
+/** Number of coins per entry of the index of a frozen coins file */
+static const uint64_t FROZEN_INDEX_INTERVAL = 64;
+
+/** Whether a sorts before b in the order of the coin keys of the chainstate database. */
+bool CoinKeyLess(const COutPoint& a, const COutPoint& b);
+
+/**
+ * A read-only set of coins, memory-mapped from a file in which they are sorted
+ * like the coin keys of the chainstate database.
+ *
+ * The file holds a header, the coins as (txid, VARINT(n), CompactSize length,
+ * Coin) records in key order, and an index with the outpoint and file offset
+ * of every FROZEN_INDEX_INTERVAL-th record. A lookup binary searches the index
+ * and reads at most that many records from there.
+ */
+class CCoinsViewFrozen final : public CCoinsView
+{
+public:
+    //! Map the file at path. Throws std::runtime_error if it cannot be used.
+    explicit CCoinsViewFrozen(const fs::path& path);
+    ~CCoinsViewFrozen();
+
+    CCoinsViewFrozen(const CCoinsViewFrozen&) = delete;
+    CCoinsViewFrozen& operator=(const CCoinsViewFrozen&) = delete;
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const override;
+    bool HaveCoin(const COutPoint& outpoint) const override;
+    //! The block the coins were unspent at when the file was written
+    uint256 GetBestBlock() const override { return m_block; }
+    CCoinsViewCursor* Cursor() const override;
+    std::vector<std::unique_ptr<CCoinsViewCursor>> RangeCursors(size_t num_ranges) const override;
+    size_t EstimateSize() const override { return m_size; }
+
+    //! The coins created up to this height were written to the file.
+    int GetHeight() const { return m_height; }
+    uint64_t GetCoinsCount() const { return m_coins_count; }
+
+    /**
+     * Write the coins of source created up to max_height to a new file at
+     * path. The cursor must iterate in the order of the database keys, like
+     * that of CCoinsViewDB.
+     */
+    static bool Write(const fs::path& path, CCoinsViewCursor& source, int max_height, uint64_t& coins_count);
+
+private:
+    const unsigned char* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef WIN32
+    //! Without mmap support the file is read into memory.
+    std::vector<unsigned char> m_buffer;
+#endif
+
+    uint256 m_block;
+    int m_height = 0;
+    uint64_t m_coins_count = 0;
+    //! The records take the file from m_records_begin up to the index.
+    size_t m_records_begin = 0;
+    size_t m_index_begin = 0;
+    uint64_t m_index_count = 0;
+
+    COutPoint GetIndexKey(uint64_t i) const;
+    //! Offset of the last indexed record whose key is not after key.
+    size_t FindRecords(const COutPoint& key) const;
+    //! Parse the record at pos, and advance pos to the next record.
+    void ReadRecord(size_t& pos, COutPoint& key, size_t& coin_pos, size_t& coin_size) const;
+    void ReadCoin(size_t coin_pos, size_t coin_size, Coin& coin) const;
+    //! Offset of the first record whose key is at least key.
+    size_t Seek(const COutPoint& key) const;
+    //! Locate the coin of outpoint. Returns false if it is not in the file.
+    bool Find(const COutPoint& outpoint, size_t& coin_pos, size_t& coin_size) const;
+
+    friend class CCoinsViewFrozenCursor;
+};
+
+#endif // BITCOIN_FROZENCOINS_H
@@ -13,6 +13,8 @@
 #include <uint256.h>
 #include <version.h>
 
+#include <algorithm>
+#include <string.h>
 #include <vector>
 
 typedef uint256 ChainCode;
@@ -112,6 +114,32 @@ inline uint160 Hash160(const prevector<N, unsigned char>& vch)
     return Hash160(vch.begin(), vch.end());
 }
 
+/** Compute the 160-bit hashes of many byte vectors (e.g. serialized public keys).
+ *  out[i] receives Hash160(in[i]) for i < count. The RIPEMD-160 step of each
+ *  group is handed to RIPEMD160_32, which hashes several inputs in parallel
+ *  where the CPU allows it.
+ */
+template<typename T>
+void Hash160Many(uint160* out, const T* in, size_t count)
+{
+    static const size_t BATCH_SIZE = 16;
+    alignas(16) unsigned char sha[BATCH_SIZE * CSHA256::OUTPUT_SIZE];
+    alignas(16) unsigned char ripemd[BATCH_SIZE * CRIPEMD160::OUTPUT_SIZE];
+    while (count) {
+        size_t n = std::min(count, BATCH_SIZE);
+        for (size_t i = 0; i < n; ++i) {
+            CSHA256().Write(in[i].data(), in[i].size()).Finalize(sha + i * CSHA256::OUTPUT_SIZE);
+        }
+        RIPEMD160_32(ripemd, sha, n);
+        for (size_t i = 0; i < n; ++i) {
+            memcpy(out[i].begin(), ripemd + i * CRIPEMD160::OUTPUT_SIZE, CRIPEMD160::OUTPUT_SIZE);
+        }
+        out += n;
+        in += n;
+        count -= n;
+    }
+}
+
 /** A writer stream (for serialization) that computes a 256-bit hash. */
 class CHashWriter
 {
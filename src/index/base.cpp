@@ -29,7 +29,7 @@ static void FatalError(const char* fmt, const Args&... args)
 }
 
 BaseIndex::DB::DB(const fs::path& path, size_t n_cache_size, bool f_memory, bool f_wipe, bool f_obfuscate) :
-    CDBWrapper(path, n_cache_size, f_memory, f_wipe, f_obfuscate)
+    CDBWrapper(path, n_cache_size, f_memory, f_wipe, f_obfuscate, GetDBTuning(path.filename().string()))
 {}
 
 bool BaseIndex::DB::ReadBestBlock(CBlockLocator& locator) const
@@ -0,0 +1,146 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coins.h>
+#include <crypto/muhash.h>
+#include <index/coinstatsindex.h>
+#include <node/coinstats.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+constexpr char DB_BLOCK_HASH = 's';
+
+std::unique_ptr<CoinStatsIndex> g_coin_stats_index;
+
+namespace {
+
+struct DBVal {
+    MuHash3072 muhash;
+    uint64_t transaction_output_count = 0;
+    uint64_t bogo_size = 0;
+    CAmount total_amount = 0;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(muhash);
+        READWRITE(transaction_output_count);
+        READWRITE(bogo_size);
+        READWRITE(total_amount);
+    }
+};
+
+} // namespace
+
+/**
+ * Access to the coinstatsindex database (indexes/coinstats/)
+ *
+ * Besides the block locator of BaseIndex, the database stores the UTXO set
+ * statistics after each block by block hash. Entries of blocks that were
+ * reorganized away are kept; they are small and keying by hash keeps the
+ * entries of the active chain correct without any rewinding.
+ */
+class CoinStatsIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    bool ReadStats(const uint256& block_hash, DBVal& value) const;
+    bool WriteStats(const uint256& block_hash, const DBVal& value);
+};
+
+CoinStatsIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "coinstats", n_cache_size, f_memory, f_wipe)
+{}
+
+bool CoinStatsIndex::DB::ReadStats(const uint256& block_hash, DBVal& value) const
+{
+    return Read(std::make_pair(DB_BLOCK_HASH, block_hash), value);
+}
+
+bool CoinStatsIndex::DB::WriteStats(const uint256& block_hash, const DBVal& value)
+{
+    return Write(std::make_pair(DB_BLOCK_HASH, block_hash), value);
+}
+
+CoinStatsIndex::CoinStatsIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<CoinStatsIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+CoinStatsIndex::~CoinStatsIndex() {}
+
+//! The two coinbases whose outputs were overwritten by later duplicates before BIP30.
+static bool IsBIP30Unspendable(const CBlockIndex* pindex)
+{
+    return (pindex->nHeight == 91722 && pindex->GetBlockHash() == uint256S("0x00000000000271a2dc26e7667f8419f2f5d07ed15ba3fe2d4f4f0a0c63b5dce4")) ||
+           (pindex->nHeight == 91812 && pindex->GetBlockHash() == uint256S("0x00000000000af0aed4792b1acee3d966af36cf5def14935db8de83d6f9306f2f"));
+}
+
+bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // The outputs of the genesis block are not in the UTXO set.
+    DBVal value;
+    if (pindex->nHeight > 0) {
+        if (!m_db->ReadStats(pindex->pprev->GetBlockHash(), value)) {
+            return error("%s: Cannot read statistics of block %s", __func__, pindex->pprev->GetBlockHash().ToString());
+        }
+
+        CBlockUndo block_undo;
+        if (!UndoReadFromDisk(block_undo, pindex)) {
+            return error("%s: Cannot read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+        }
+
+        for (size_t i = 0; i < block.vtx.size(); ++i) {
+            const CTransaction& tx = *block.vtx[i];
+
+            if (!tx.IsCoinBase() || !IsBIP30Unspendable(pindex)) {
+                for (uint32_t j = 0; j < tx.vout.size(); ++j) {
+                    const CTxOut& out = tx.vout[j];
+                    // Like AddCoins(), leave out outputs that can never be spent.
+                    if (out.scriptPubKey.IsUnspendable()) continue;
+                    const Coin coin(out, pindex->nHeight, tx.IsCoinBase());
+                    ApplyCoinHash(value.muhash, COutPoint(tx.GetHash(), j), coin);
+                    value.transaction_output_count++;
+                    value.bogo_size += GetBogoSize(coin);
+                    value.total_amount += out.nValue;
+                }
+            }
+
+            if (tx.IsCoinBase()) continue;
+            const CTxUndo& tx_undo = block_undo.vtxundo.at(i - 1);
+            for (size_t j = 0; j < tx.vin.size(); ++j) {
+                const Coin& coin = tx_undo.vprevout.at(j);
+                RemoveCoinHash(value.muhash, tx.vin[j].prevout, coin);
+                value.transaction_output_count--;
+                value.bogo_size -= GetBogoSize(coin);
+                value.total_amount -= coin.out.nValue;
+            }
+        }
+    }
+
+    return m_db->WriteStats(pindex->GetBlockHash(), value);
+}
+
+BaseIndex::DB& CoinStatsIndex::GetDB() const { return *m_db; }
+
+bool CoinStatsIndex::LookUpStats(const CBlockIndex* block_index, CCoinsStats& stats) const
+{
+    DBVal value;
+    if (!m_db->ReadStats(block_index->GetBlockHash(), value)) {
+        return false;
+    }
+
+    stats.hashBlock = block_index->GetBlockHash();
+    stats.nHeight = block_index->nHeight;
+    stats.nTransactions = 0;
+    stats.nTransactionOutputs = value.transaction_output_count;
+    stats.nBogoSize = value.bogo_size;
+    stats.nDiskSize = 0;
+    stats.nTotalAmount = value.total_amount;
+    value.muhash.Finalize(stats.hashSerialized.begin());
+    return true;
+}
@@ -0,0 +1,53 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_COINSTATSINDEX_H
+#define BITCOIN_INDEX_COINSTATSINDEX_H
+
+#include <chain.h>
+#include <index/base.h>
+
+struct CCoinsStats;
+
+static const bool DEFAULT_COINSTATSINDEX = false;
+
+/**
+ * CoinStatsIndex keeps statistics about the UTXO set as of every block: a
+ * MuHash of the unspent outputs and running totals of their number, amount
+ * and size. The statistics of a block are computed from those of its parent
+ * and the block's undo data, so gettxoutsetinfo can answer for any indexed
+ * block without scanning the chainstate, and reorganizations need no rewind.
+ */
+class CoinStatsIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "coinstatsindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit CoinStatsIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~CoinStatsIndex() override;
+
+    /// Look up the statistics of the UTXO set after the given block. The
+    /// hash is the MuHash of the coins; the number of transactions and the
+    /// disk size are not tracked. Returns false if the block is not indexed.
+    bool LookUpStats(const CBlockIndex* block_index, CCoinsStats& stats) const;
+};
+
+/// The global UTXO set statistics index. May be null.
+extern std::unique_ptr<CoinStatsIndex> g_coin_stats_index;
+
+#endif // BITCOIN_INDEX_COINSTATSINDEX_H
@@ -16,10 +16,13 @@
 #include <checkpoints.h>
 #include <compat/sanity.h>
 #include <consensus/validation.h>
+#include <crypto/aes.h>
+#include <crypto/sha512.h>
 #include <fs.h>
 #include <httpserver.h>
 #include <httprpc.h>
 #include <interfaces/chain.h>
+#include <index/coinstatsindex.h>
 #include <index/txindex.h>
 #include <key.h>
 #include <validation.h>
@@ -27,6 +30,7 @@
 #include <netbase.h>
 #include <net.h>
 #include <net_processing.h>
+#include <node/utxo_snapshot.h>
 #include <policy/feerate.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
@@ -135,6 +139,16 @@ public:
             abort();
         }
     }
+    void GetCoins(const std::vector<COutPoint>& outpoints, std::vector<Coin>& coins) const override {
+        try {
+            base->GetCoins(outpoints, coins);
+        } catch(const std::runtime_error& e) {
+            uiInterface.ThreadSafeMessageBox(_("Error reading from database, shutting down."), "", CClientUIInterface::MSG_ERROR);
+            LogPrintf("Error reading from database: %s\n", e.what());
+            // See GetCoin().
+            abort();
+        }
+    }
     // Writes do not need similar protection, as failure to write is handled by the caller.
 };
 
@@ -157,6 +171,9 @@ void Interrupt()
     if (g_txindex) {
         g_txindex->Interrupt();
     }
+    if (g_coin_stats_index) {
+        g_coin_stats_index->Interrupt();
+    }
 }
 
 void Shutdown(InitInterfaces& interfaces)
@@ -186,8 +203,10 @@ void Shutdown(InitInterfaces& interfaces)
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
+    if (g_block_template_cache) UnregisterValidationInterface(g_block_template_cache.get());
     if (g_connman) g_connman->Stop();
     if (g_txindex) g_txindex->Stop();
+    if (g_coin_stats_index) g_coin_stats_index->Stop();
 
     StopTorControl();
 
@@ -199,8 +218,10 @@ void Shutdown(InitInterfaces& interfaces)
     // After the threads that potentially access these pointers have been stopped,
     // destruct and reset all to nullptr.
     peerLogic.reset();
+    g_block_template_cache.reset();
     g_connman.reset();
     g_txindex.reset();
+    g_coin_stats_index.reset();
 
     if (g_is_mempool_loaded && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         DumpMempool();
@@ -235,6 +256,7 @@ void Shutdown(InitInterfaces& interfaces)
 
     {
         LOCK(cs_main);
+        StopBlockReadAhead();
         if (pcoinsTip != nullptr) {
             FlushStateToDisk();
         }
@@ -344,20 +366,28 @@ void SetupServerArgs()
     gArgs.AddArg("-blocknotify=<cmd>", "Execute command when the best block changes (%s in cmd is replaced by block hash)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blockreconstructionextratxn=<n>", strprintf("Extra transactions to keep in memory for compact block reconstructions (default: %u)", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksonly", strprintf("Whether to operate in a blocks only mode (default: %u)", DEFAULT_BLOCKSONLY), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-coinstatsindex", strprintf("Maintain statistics about the UTXO set as of every block, used by the gettxoutsetinfo RPC call (default: %u)", DEFAULT_COINSTATSINDEX), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-conf=<file>", strprintf("Specify configuration file. Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-datadir=<dir>", "Specify data directory", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dbbackgroundwrite", strprintf("Write coin database changes from a background thread (default: %u)", DEFAULT_DB_BACKGROUND_WRITE), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dbreadthreads=<n>", strprintf("Number of threads looking up coins in the database in parallel ahead of block validation (0 to %d, default: %d)", MAX_DB_READ_THREADS, DEFAULT_DB_READ_THREADS), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbcache=<n>", strprintf("Set database cache size in megabytes (%d to %d, default: %d)", nMinDbCache, nMaxDbCache, nDefaultDbCache), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dbprofile=<db>:<profile>", "Tune the LevelDB settings of database <db> (chainstate, blockindex, txindex or coinstats) for an access pattern. <profile> can be: default, randomread or bulkwrite (default: default)", true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (-nodebuglogfile to disable; default: %s)", DEFAULT_DEBUGLOGFILE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-freezecoins=<n>", strprintf("Keep the coins created more than <n> blocks below the tip in a read-only file instead of the chainstate database. The file is rewritten at startup once %d more blocks (or <n> if fewer) can be added, and stays in use if this option is removed (0 to disable, default: %u)", MIN_FREEZE_ADVANCE, DEFAULT_FREEZE_COINS_DEPTH), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-loadblock=<file>", "Imports blocks from external blk000??.dat file on startup", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-loadutxosnapshot=<file>:<hash>", "Populate an empty chainstate from a dumptxoutset snapshot file on startup. The coins must have the given hash_serialized_2, as reported by gettxoutsetinfo on a trusted node. The block index must contain the snapshot's base block (e.g. combine with -reindex-chainstate). Relative paths will be prefixed by a net-specific datadir location.", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxorphantx=<n>", strprintf("Keep at most <n> unconnectable transactions in memory (default: %u)", DEFAULT_MAX_ORPHAN_TRANSACTIONS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-mempoolexpiry=<n>", strprintf("Do not keep transactions in the mempool longer than <n> hours (default: %u)", DEFAULT_MEMPOOL_EXPIRY), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex()), true, OptionsCategory::OPTIONS);
-    gArgs.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
-        -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-maxscriptthreads=<n>", strprintf("Maximum number of script verification threads -par may use (1 to %d, default: %d)",
+        MAX_SCRIPTCHECK_THREADS, DEFAULT_MAX_SCRIPTCHECK_THREADS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to -maxscriptthreads, 0 = auto, <0 = leave that many cores free, default: %d)",
+        -GetNumCores(), DEFAULT_SCRIPTCHECK_THREADS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-persistmempool", strprintf("Whether to save the mempool on shutdown and load on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), false, OptionsCategory::OPTIONS);
 #ifndef WIN32
     gArgs.AddArg("-pid=<file>", strprintf("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", BITCOIN_PID_FILENAME), false, OptionsCategory::OPTIONS);
@@ -460,6 +490,7 @@ void SetupServerArgs()
     gArgs.AddArg("-limitancestorsize=<n>", strprintf("Do not accept transactions whose size with all in-mempool ancestors exceeds <n> kilobytes (default: %u)", DEFAULT_ANCESTOR_SIZE_LIMIT), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-limitdescendantcount=<n>", strprintf("Do not accept transactions if any ancestor would have <n> or more in-mempool descendants (default: %u)", DEFAULT_DESCENDANT_LIMIT), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-limitdescendantsize=<n>", strprintf("Do not accept transactions if any ancestor would have more than <n> kilobytes of in-mempool descendants (default: %u).", DEFAULT_DESCENDANT_SIZE_LIMIT), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-limitclustercount=<n>", strprintf("Do not accept transactions if they would connect more than <n> in-mempool transactions, themselves included (default: %u)", DEFAULT_CLUSTER_LIMIT), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-addrmantest", "Allows to test address relay on localhost", true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-debug=<category>", "Output debugging information (default: -nodebug, supplying <category> is optional). "
         "If <category> is not supplied or if <category> = 1, output all debugging information. <category> can be: " + ListLogCategories() + ".", false, OptionsCategory::DEBUG_TEST);
@@ -929,6 +960,8 @@ bool AppInitParameterInteraction()
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX))
+            return InitError(_("Prune mode is incompatible with -coinstatsindex."));
     }
 
     // -bind and -whitebind can't be set when not listening
@@ -975,6 +1008,16 @@ bool AppInitParameterInteraction()
         }
     }
 
+    for (const std::string& arg : gArgs.GetArgs("-dbprofile")) {
+        const size_t colon = arg.find(':');
+        const std::vector<std::string> db_names = {"chainstate", "blockindex", "txindex", "coinstats"};
+        DBTuning tuning;
+        if (colon == std::string::npos || std::find(db_names.begin(), db_names.end(), arg.substr(0, colon)) == db_names.end() ||
+            !GetDBProfile(arg.substr(colon + 1), tuning)) {
+            return InitError(strprintf(_("Invalid -dbprofile=%s"), arg));
+        }
+    }
+
     // Checkmempool and checkblockindex default to true in regtest mode
     int ratio = std::min<int>(std::max<int>(gArgs.GetArg("-checkmempool", chainparams.DefaultConsistencyChecks() ? 1 : 0), 0), 1000000);
     if (ratio != 0) {
@@ -1019,13 +1062,14 @@ bool AppInitParameterInteraction()
     }
 
     // -par=0 means autodetect, but nScriptCheckThreads==0 means no concurrency
+    const int nMaxScriptCheckThreads = std::max(1, std::min<int>(gArgs.GetArg("-maxscriptthreads", DEFAULT_MAX_SCRIPTCHECK_THREADS), MAX_SCRIPTCHECK_THREADS));
     nScriptCheckThreads = gArgs.GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
     if (nScriptCheckThreads <= 0)
         nScriptCheckThreads += GetNumCores();
     if (nScriptCheckThreads <= 1)
         nScriptCheckThreads = 0;
-    else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
-        nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
+    else if (nScriptCheckThreads > nMaxScriptCheckThreads)
+        nScriptCheckThreads = nMaxScriptCheckThreads;
 
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = gArgs.GetArg("-prune", 0);
@@ -1138,6 +1182,10 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string sha512_algo = SHA512AutoDetect();
+    LogPrintf("Using the '%s' SHA512 implementation\n", sha512_algo);
+    std::string aes_algo = AESAutoDetect();
+    LogPrintf("Using the '%s' AES implementation\n", aes_algo);
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1277,6 +1325,9 @@ bool AppInitMain(InitInterfaces& interfaces)
     peerLogic.reset(new PeerLogicValidation(&connman, scheduler, gArgs.GetBoolArg("-enablebip61", DEFAULT_ENABLE_BIP61)));
     RegisterValidationInterface(peerLogic.get());
 
+    g_block_template_cache = MakeUnique<BlockTemplateCache>();
+    RegisterValidationInterface(g_block_template_cache.get());
+
     // sanitize comments per BIP-0014, format user agent and check total size
     std::vector<std::string> uacomments;
     for (const std::string& cmt : gArgs.GetArgs("-uacomment")) {
@@ -1468,6 +1519,10 @@ bool AppInitMain(InitInterfaces& interfaces)
                 // block tree into mapBlockIndex!
 
                 pcoinsdbview.reset(new CCoinsViewDB(nCoinDBCache, false, fReset || fReindexChainState));
+                if (gArgs.GetBoolArg("-dbbackgroundwrite", DEFAULT_DB_BACKGROUND_WRITE)) {
+                    pcoinsdbview->StartBackgroundWriter();
+                }
+                pcoinsdbview->StartReaderThreads(std::max(0, std::min<int>(gArgs.GetArg("-dbreadthreads", DEFAULT_DB_READ_THREADS), MAX_DB_READ_THREADS)));
                 pcoinscatcher.reset(new CCoinsViewErrorCatcher(pcoinsdbview.get()));
 
                 // If necessary, upgrade from older database format.
@@ -1477,6 +1532,33 @@ bool AppInitMain(InitInterfaces& interfaces)
                     break;
                 }
 
+                // The coins of an unfinished snapshot load have no best block,
+                // so ReplayBlocks would build on them as if they were empty.
+                if (pcoinsdbview->IsLoadingSnapshot()) {
+                    LogPrintf("Removing the coins of an interrupted UTXO snapshot load\n");
+                    if (!pcoinsdbview->ClearSnapshot()) {
+                        strLoadError = _("Error clearing the chainstate database");
+                        break;
+                    }
+                }
+
+                // Fill an empty chainstate from a snapshot
+                bool snapshot_loaded = false;
+                if (gArgs.IsArgSet("-loadutxosnapshot") && pcoinsdbview->GetBestBlock().IsNull() && pcoinsdbview->GetHeadBlocks().empty()) {
+                    uiInterface.InitMessage(_("Loading UTXO snapshot..."));
+                    const std::string snapshot_arg = gArgs.GetArg("-loadutxosnapshot", "");
+                    const size_t colon = snapshot_arg.rfind(':');
+                    const std::string snapshot_hash = colon == std::string::npos ? "" : snapshot_arg.substr(colon + 1);
+                    if (snapshot_hash.size() != 64 || !IsHex(snapshot_hash)) {
+                        return InitError(strprintf(_("-loadutxosnapshot must be of the form <file>:<hash>, with the hash_serialized_2 of the snapshot: '%s'"), snapshot_arg));
+                    }
+                    std::string snapshot_error;
+                    if (!LoadUTXOSnapshot(*pcoinsdbview, fs::absolute(snapshot_arg.substr(0, colon), GetDataDir()), uint256S(snapshot_hash), snapshot_error)) {
+                        return InitError(snapshot_error);
+                    }
+                    snapshot_loaded = true;
+                }
+
                 // ReplayBlocks is a no-op if we cleared the coinsviewdb with -reindex or -reindex-chainstate
                 if (!ReplayBlocks(chainparams, pcoinsdbview.get())) {
                     strLoadError = _("Unable to replay blocks. You will need to rebuild the database using -reindex-chainstate.");
@@ -1486,7 +1568,7 @@ bool AppInitMain(InitInterfaces& interfaces)
                 // The on-disk coinsdb is now in a good state, create the cache
                 pcoinsTip.reset(new CCoinsViewCache(pcoinscatcher.get()));
 
-                bool is_coinsview_empty = fReset || fReindexChainState || pcoinsTip->GetBestBlock().IsNull();
+                bool is_coinsview_empty = fReset || (fReindexChainState && !snapshot_loaded) || pcoinsTip->GetBestBlock().IsNull();
                 if (!is_coinsview_empty) {
                     // LoadChainTip sets chainActive based on pcoinsTip's best block
                     if (!LoadChainTip(chainparams)) {
@@ -1507,7 +1589,9 @@ bool AppInitMain(InitInterfaces& interfaces)
                     }
                 }
 
-                if (!is_coinsview_empty) {
+                // A freshly loaded snapshot has just been checked against its
+                // hash, and the undo data to verify it by need not exist.
+                if (!is_coinsview_empty && !snapshot_loaded) {
                     uiInterface.InitMessage(_("Verifying blocks..."));
                     if (fHavePruned && gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS) > MIN_BLOCKS_TO_KEEP) {
                         LogPrintf("Prune: pruned datadir may not have more than %d blocks; only checking available blocks\n",
@@ -1529,6 +1613,19 @@ bool AppInitMain(InitInterfaces& interfaces)
                         break;
                     }
                 }
+
+                // Move old coins out of LevelDB, before anything else uses the database.
+                const int freeze_depth = gArgs.GetArg("-freezecoins", DEFAULT_FREEZE_COINS_DEPTH);
+                if (freeze_depth > 0 && !is_coinsview_empty) {
+                    const int freeze_height = chainActive.Height() - freeze_depth;
+                    if (freeze_height >= pcoinsdbview->GetFrozenHeight() + std::min(freeze_depth, MIN_FREEZE_ADVANCE)) {
+                        uiInterface.InitMessage(_("Freezing old coins..."));
+                        if (!pcoinsTip->Flush() || !pcoinsdbview->FreezeCoins(freeze_height)) {
+                            strLoadError = _("Error moving old coins to the frozen coins file");
+                            break;
+                        }
+                    }
+                }
             } catch (const std::exception& e) {
                 LogPrintf("%s\n", e.what());
                 strLoadError = _("Error opening block database");
@@ -1580,6 +1677,11 @@ bool AppInitMain(InitInterfaces& interfaces)
         g_txindex->Start();
     }
 
+    if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        g_coin_stats_index = MakeUnique<CoinStatsIndex>(/* cache size */ 0, false, fReindex);
+        g_coin_stats_index->Start();
+    }
+
     // ********************************************************* Step 9: load wallet
     for (const auto& client : interfaces.chain_clients) {
         if (!client->load()) {
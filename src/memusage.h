@@ -5,7 +5,9 @@
 #ifndef BITCOIN_MEMUSAGE_H
 #define BITCOIN_MEMUSAGE_H
 
+#include <flatnodemap.h>
 #include <indirectmap.h>
+#include <prevector.h>
 
 #include <stdlib.h>
 
@@ -165,6 +167,15 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+/** The index arrays plus the pool's chunks (whether in use or free). The pool must not be shared. */
+template<typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const FlatNodeMap<X, Y, Z>& m)
+{
+    const auto* pool_resource = m.resource();
+    size_t usage_chunks = (MallocUsage(pool_resource->ChunkSizeBytes()) + MallocUsage(sizeof(void*))) * pool_resource->NumAllocatedChunks();
+    return usage_chunks + MallocUsage(m.capacity()) + MallocUsage(sizeof(void*) * m.capacity());
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
@@ -37,6 +37,8 @@
 uint64_t nLastBlockTx = 0;
 uint64_t nLastBlockWeight = 0;
 
+std::unique_ptr<BlockTemplateCache> g_block_template_cache;
+
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev)
 {
     int64_t nOldTime = pblock->nTime;
@@ -94,9 +96,13 @@ void BlockAssembler::resetBlock()
     // These counters do not include coinbase tx
     nBlockTx = 0;
     nFees = 0;
+
+    fBlockFull = false;
+    minPackageFeeRate = CFeeRate(MAX_MONEY);
+    nTimeSelected = GetTime();
 }
 
-std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx)
+std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx, BlockTemplateCache* cache)
 {
     int64_t nTimeStart = GetTimeMicros();
 
@@ -144,7 +150,31 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    const bool fCached = cache && addCachedTxs(*cache, pindexPrev);
+    if (!fCached) {
+        if (cache) {
+            // Start over from an empty block
+            const bool fIncludeWitnessSaved = fIncludeWitness;
+            resetBlock();
+            fIncludeWitness = fIncludeWitnessSaved;
+            pblock->vtx.resize(1);
+            pblocktemplate->vTxFees.resize(1);
+            pblocktemplate->vTxSigOpsCost.resize(1);
+        }
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    }
+    if (cache) {
+        BlockTemplateCache::Selection selection;
+        selection.pindexPrev = pindexPrev;
+        selection.nBlockMaxWeight = nBlockMaxWeight;
+        selection.blockMinFeeRate = blockMinFeeRate;
+        selection.fIncludeWitness = fIncludeWitness;
+        selection.vtx.assign(pblock->vtx.begin() + 1, pblock->vtx.end());
+        selection.fBlockFull = fBlockFull;
+        selection.minPackageFeeRate = minPackageFeeRate;
+        selection.nTimeSelected = nTimeSelected;
+        cache->Store(std::move(selection));
+    }
 
     int64_t nTime1 = GetTimeMicros();
 
@@ -178,7 +208,7 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     }
     int64_t nTime2 = GetTimeMicros();
 
-    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants%s), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, fCached ? ", cached" : "", 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
 
     return std::move(pblocktemplate);
 }
@@ -378,6 +408,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
         }
 
         if (!TestPackage(packageSize, packageSigOpsCost)) {
+            fBlockFull = true;
             if (fUsingModified) {
                 // Since we always look at the best entry in mapModifiedTx,
                 // we must erase failed entries so that we can consider the
@@ -427,12 +458,133 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
         }
 
         ++nPackagesSelected;
+        minPackageFeeRate = std::min(minPackageFeeRate, CFeeRate(packageFees, packageSize));
 
         // Update transactions that depend on each of these
         nDescendantsUpdated += UpdatePackagesForAdded(ancestors, mapModifiedTx);
     }
 }
 
+bool BlockAssembler::addCachedTxs(BlockTemplateCache& cache, const CBlockIndex* pindexPrev)
+{
+    BlockTemplateCache::Selection key;
+    key.pindexPrev = pindexPrev;
+    key.nBlockMaxWeight = nBlockMaxWeight;
+    key.blockMinFeeRate = blockMinFeeRate;
+    key.fIncludeWitness = fIncludeWitness;
+    BlockTemplateCache::Selection selection;
+    std::vector<CTransactionRef> vAdded;
+    if (!cache.Take(key, selection, vAdded)) {
+        return false;
+    }
+    fBlockFull = selection.fBlockFull;
+    minPackageFeeRate = selection.minPackageFeeRate;
+    nTimeSelected = selection.nTimeSelected;
+
+    for (const CTransactionRef& tx : selection.vtx) {
+        CTxMemPool::txiter it = mempool.mapTx.find(tx->GetHash());
+        // The packages it was part of changed: the rest may no longer pay
+        // enough (e.g. a parent without its child), and packages that were
+        // left out might fit now.
+        if (it == mempool.mapTx.end()) return false;
+        // The entry may have a different witness than the one selected.
+        if (!TestPackage(it->GetTxSize(), it->GetSigOpCost())) return false;
+        AddToBlock(it);
+    }
+
+    for (const CTransactionRef& tx : vAdded) {
+        CTxMemPool::txiter it = mempool.mapTx.find(tx->GetHash());
+        if (it == mempool.mapTx.end() || inBlock.count(it)) continue;
+
+        // Its package consists of the transaction and its ancestors that
+        // were left out so far, as addPackageTxs() would have found it.
+        CTxMemPool::setEntries package;
+        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+        std::string dummy;
+        mempool.CalculateMemPoolAncestors(*it, package, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+        onlyUnconfirmed(package);
+        package.insert(it);
+
+        uint64_t packageSize = 0;
+        CAmount packageFees = 0;
+        int64_t packageSigOpsCost = 0;
+        for (CTxMemPool::txiter entry : package) {
+            packageSize += entry->GetTxSize();
+            packageFees += entry->GetModifiedFee();
+            packageSigOpsCost += entry->GetSigOpCost();
+        }
+        if (packageFees < blockMinFeeRate.GetFee(packageSize)) continue;
+        const CFeeRate packageFeeRate(packageFees, packageSize);
+
+        if (!TestPackage(packageSize, packageSigOpsCost)) {
+            // A full selection might prefer it to a package in the block.
+            if (minPackageFeeRate < packageFeeRate) return false;
+            fBlockFull = true;
+            continue;
+        }
+        if (!TestPackageTransactions(package)) continue;
+
+        std::vector<CTxMemPool::txiter> sortedEntries;
+        SortForBlock(package, sortedEntries);
+        for (CTxMemPool::txiter entry : sortedEntries) {
+            AddToBlock(entry);
+        }
+        minPackageFeeRate = std::min(minPackageFeeRate, packageFeeRate);
+    }
+    return true;
+}
+
+void BlockTemplateCache::Clear()
+{
+    m_valid = false;
+    m_selection = Selection();
+    m_added.clear();
+}
+
+void BlockTemplateCache::Store(Selection selection)
+{
+    LOCK(cs);
+    m_selection = std::move(selection);
+    m_valid = true;
+}
+
+bool BlockTemplateCache::Take(const Selection& key, Selection& selection, std::vector<CTransactionRef>& vAdded)
+{
+    LOCK(cs);
+    if (!m_valid ||
+        m_selection.pindexPrev != key.pindexPrev ||
+        m_selection.nBlockMaxWeight != key.nBlockMaxWeight ||
+        m_selection.blockMinFeeRate != key.blockMinFeeRate ||
+        m_selection.fIncludeWitness != key.fIncludeWitness ||
+        GetTime() - m_selection.nTimeSelected > MAX_TEMPLATE_SELECTION_AGE) {
+        Clear();
+        return false;
+    }
+    selection = m_selection;
+    vAdded.swap(m_added);
+    m_added.clear();
+    return true;
+}
+
+void BlockTemplateCache::TransactionAddedToMempool(const CTransactionRef& tx)
+{
+    LOCK(cs);
+    // Transactions that enter the mempool before a template is stored are
+    // considered by its full selection.
+    if (!m_valid) return;
+    if (m_added.size() >= MAX_TEMPLATE_CACHE_ADDED) {
+        Clear();
+        return;
+    }
+    m_added.push_back(tx);
+}
+
+void BlockTemplateCache::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    LOCK(cs);
+    Clear();
+}
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
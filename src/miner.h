@@ -7,14 +7,17 @@
 #define BITCOIN_MINER_H
 
 #include <primitives/block.h>
+#include <sync.h>
 #include <txmempool.h>
 #include <validation.h>
+#include <validationinterface.h>
 
 #include <stdint.h>
 #include <memory>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 
+class BlockTemplateCache;
 class CBlockIndex;
 class CChainParams;
 class CScript;
@@ -22,6 +25,10 @@ class CScript;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Select the transactions of a cached block template from the whole mempool again after this many seconds */
+static const int64_t MAX_TEMPLATE_SELECTION_AGE = 30;
+/** Forget the cached block template when this many transactions entered the mempool without a new template being made */
+static const size_t MAX_TEMPLATE_CACHE_ADDED = 10000;
 
 struct CBlockTemplate
 {
@@ -141,6 +148,11 @@ private:
     CAmount nFees;
     CTxMemPool::setEntries inBlock;
 
+    // Information on the selection of the block's packages
+    bool fBlockFull;
+    CFeeRate minPackageFeeRate;
+    int64_t nTimeSelected;
+
     // Chain context for the block
     int nHeight;
     int64_t nLockTimeCutoff;
@@ -156,8 +168,9 @@ public:
     explicit BlockAssembler(const CChainParams& params);
     BlockAssembler(const CChainParams& params, const Options& options);
 
-    /** Construct a new block template with coinbase to scriptPubKeyIn */
-    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx=true);
+    /** Construct a new block template with coinbase to scriptPubKeyIn. If
+      * cache is given, start from the transactions of its last template. */
+    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx=true, BlockTemplateCache* cache=nullptr);
 
 private:
     // utility functions
@@ -171,6 +184,12 @@ private:
       * Increments nPackagesSelected / nDescendantsUpdated with corresponding
       * statistics from the package selection (for logging statistics). */
     void addPackageTxs(int &nPackagesSelected, int &nDescendantsUpdated) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
+    /** Add the transactions of the cached template that are still in the
+      * mempool, then the packages of the transactions that entered the
+      * mempool since. Returns false if the cached template doesn't apply or
+      * a full selection could pick different packages; the block may then
+      * hold some transactions already. */
+    bool addCachedTxs(BlockTemplateCache& cache, const CBlockIndex* pindexPrev) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
 
     // helper functions for addPackageTxs()
     /** Remove confirmed (inBlock) entries from given set */
@@ -193,6 +212,60 @@ private:
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
 };
 
+/**
+ * Remembers the transactions of the last block template and collects the
+ * transactions that entered the mempool since, so that BlockAssembler can
+ * make the next template for the same tip by adding their packages instead
+ * of selecting all packages from the mempool again.
+ *
+ * Transactions that leave the mempool are found while assembling, under
+ * mempool.cs, as the notifications arrive asynchronously. Changes to the
+ * modified fees of transactions are only picked up when the packages are
+ * selected again, at most MAX_TEMPLATE_SELECTION_AGE seconds later.
+ */
+class BlockTemplateCache final : public CValidationInterface
+{
+public:
+    /** The transactions of a block template and how they were selected */
+    struct Selection {
+        //! Block the template builds on
+        const CBlockIndex* pindexPrev = nullptr;
+        //! Settings of the BlockAssembler that made the template
+        size_t nBlockMaxWeight = 0;
+        CFeeRate blockMinFeeRate;
+        bool fIncludeWitness = false;
+        //! The transactions in block order, without the coinbase
+        std::vector<CTransactionRef> vtx;
+        //! Whether packages were left out for lack of space
+        bool fBlockFull = false;
+        //! Lowest feerate of the packages in the block
+        CFeeRate minPackageFeeRate;
+        //! When the packages were last selected from the whole mempool
+        int64_t nTimeSelected = 0;
+    };
+
+    /** Remember the selection of a new template. */
+    void Store(Selection selection);
+    /** Get the selection of the last template if it builds on the same block
+      * with the same settings and is recent enough, along with the
+      * transactions that entered the mempool since the previous call. */
+    bool Take(const Selection& key, Selection& selection, std::vector<CTransactionRef>& vAdded);
+
+    void TransactionAddedToMempool(const CTransactionRef& tx) override;
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override;
+
+private:
+    CCriticalSection cs;
+    bool m_valid GUARDED_BY(cs) = false;
+    Selection m_selection GUARDED_BY(cs);
+    std::vector<CTransactionRef> m_added GUARDED_BY(cs);
+
+    void Clear() EXCLUSIVE_LOCKS_REQUIRED(cs);
+};
+
+/** Block template cache used by getblocktemplate */
+extern std::unique_ptr<BlockTemplateCache> g_block_template_cache;
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
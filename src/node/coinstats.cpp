@@ -0,0 +1,200 @@
+// Copyright (c) 2010 Satoshi Nakamoto
+// Copyright (c) 2009-2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/coinstats.h>
+
+#include <coins.h>
+#include <crypto/muhash.h>
+#include <hash.h>
+#include <serialize.h>
+#include <streams.h>
+#include <sync.h>
+#include <util/system.h>
+#include <validation.h>
+#include <version.h>
+
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <thread>
+
+static void TxOutSer(CDataStream& ss, const COutPoint& outpoint, const Coin& coin)
+{
+    ss << outpoint;
+    ss << static_cast<uint32_t>(coin.nHeight * 2 + coin.fCoinBase);
+    ss << coin.out;
+}
+
+void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    TxOutSer(ss, outpoint, coin);
+    muhash.Insert((const unsigned char*)ss.data(), ss.size());
+}
+
+void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    TxOutSer(ss, outpoint, coin);
+    muhash.Remove((const unsigned char*)ss.data(), ss.size());
+}
+
+uint64_t GetBogoSize(const Coin& coin)
+{
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+           2 /* scriptPubKey len */ + coin.out.scriptPubKey.size() /* scriptPubKey */;
+}
+
+void ApplyCoinStats(CCoinsStats& stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+{
+    assert(!outputs.empty());
+    ss << hash;
+    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase ? 1u : 0u);
+    stats.nTransactions++;
+    for (const auto& output : outputs) {
+        ss << VARINT(output.first + 1);
+        ss << output.second.out.scriptPubKey;
+        ss << VARINT(output.second.out.nValue, VarIntMode::NONNEGATIVE_SIGNED);
+        stats.nTransactionOutputs++;
+        stats.nTotalAmount += output.second.out.nValue;
+        stats.nBogoSize += GetBogoSize(output.second);
+    }
+    ss << VARINT(0u);
+}
+
+int GetCoinsScanThreads()
+{
+    return std::max(1, std::min(GetNumCores(), MAX_COINS_SCAN_THREADS));
+}
+
+void ForEachCoinsRange(std::vector<std::unique_ptr<CCoinsViewCursor>>& cursors, const std::function<void(size_t, CCoinsViewCursor&)>& fn)
+{
+    std::vector<std::exception_ptr> errors(cursors.size());
+    auto scan = [&](size_t i) {
+        try {
+            fn(i, *cursors[i]);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < cursors.size(); ++i) {
+        threads.emplace_back([&scan, i] {
+            RenameThread("bitcoin-coinscan");
+            scan(i);
+        });
+    }
+    scan(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+//! Compute hash_serialized_2 and the other statistics in a single ordered pass.
+static bool GetSerializedStats(CCoinsViewCursor& cursor, CCoinsStats& stats)
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << stats.hashBlock;
+    uint256 prevkey;
+    std::map<uint32_t, Coin> outputs;
+    while (cursor.Valid()) {
+        boost::this_thread::interruption_point();
+        COutPoint key;
+        Coin coin;
+        if (cursor.GetKey(key) && cursor.GetValue(coin)) {
+            if (!outputs.empty() && key.hash != prevkey) {
+                ApplyCoinStats(stats, ss, prevkey, outputs);
+                outputs.clear();
+            }
+            prevkey = key.hash;
+            outputs[key.n] = std::move(coin);
+        } else {
+            return error("%s: unable to read value", __func__);
+        }
+        cursor.Next();
+    }
+    if (!outputs.empty()) {
+        ApplyCoinStats(stats, ss, prevkey, outputs);
+    }
+    stats.hashSerialized = ss.GetHash();
+    return true;
+}
+
+//! Add the coins of one range to statistics that do not depend on the order of the coins.
+static bool GetRangeStats(CCoinsViewCursor& cursor, CCoinsStats& stats, MuHash3072* muhash)
+{
+    uint256 prevkey;
+    while (cursor.Valid()) {
+        boost::this_thread::interruption_point();
+        COutPoint key;
+        Coin coin;
+        if (!cursor.GetKey(key) || !cursor.GetValue(coin)) {
+            return error("%s: unable to read value", __func__);
+        }
+        if (muhash) ApplyCoinHash(*muhash, key, coin);
+        // The outputs of a transaction are adjacent and never split across ranges.
+        if (stats.nTransactionOutputs == 0 || key.hash != prevkey) {
+            stats.nTransactions++;
+        }
+        prevkey = key.hash;
+        stats.nTransactionOutputs++;
+        stats.nTotalAmount += coin.out.nValue;
+        stats.nBogoSize += GetBogoSize(coin);
+        cursor.Next();
+    }
+    return true;
+}
+
+bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, CoinStatsHashType hash_type)
+{
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    {
+        LOCK(cs_main);
+        if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+            // hash_serialized_2 commits to the order of the coins, so it
+            // cannot be computed from separate ranges.
+            cursors.emplace_back(view->Cursor());
+        } else {
+            cursors = view->RangeCursors(GetCoinsScanThreads());
+        }
+        assert(!cursors.empty() && cursors[0]);
+        stats.hashBlock = cursors[0]->GetBestBlock();
+        stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
+    }
+
+    if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+        if (!GetSerializedStats(*cursors[0], stats)) return false;
+    } else {
+        std::vector<CCoinsStats> range_stats(cursors.size());
+        std::vector<MuHash3072> range_muhash(cursors.size());
+        std::vector<char> range_ok(cursors.size(), false);
+        ForEachCoinsRange(cursors, [&](size_t i, CCoinsViewCursor& cursor) {
+            range_ok[i] = GetRangeStats(cursor, range_stats[i], hash_type == CoinStatsHashType::MUHASH ? &range_muhash[i] : nullptr);
+        });
+
+        MuHash3072 muhash;
+        for (size_t i = 0; i < cursors.size(); ++i) {
+            if (!range_ok[i]) return false;
+            stats.nTransactions += range_stats[i].nTransactions;
+            stats.nTransactionOutputs += range_stats[i].nTransactionOutputs;
+            stats.nTotalAmount += range_stats[i].nTotalAmount;
+            stats.nBogoSize += range_stats[i].nBogoSize;
+            muhash *= range_muhash[i];
+        }
+        if (hash_type == CoinStatsHashType::MUHASH) {
+            muhash.Finalize(stats.hashSerialized.begin());
+        } else {
+            stats.hashSerialized.SetNull();
+        }
+    }
+    stats.nDiskSize = view->EstimateSize();
+    return true;
+}
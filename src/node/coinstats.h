@@ -0,0 +1,72 @@
+// Copyright (c) 2010 Satoshi Nakamoto
+// Copyright (c) 2009-2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_COINSTATS_H
+#define BITCOIN_NODE_COINSTATS_H
+
+#include <amount.h>
+#include <uint256.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+class CCoinsView;
+class CCoinsViewCursor;
+class CHashWriter;
+class COutPoint;
+class Coin;
+class MuHash3072;
+
+enum class CoinStatsHashType {
+    HASH_SERIALIZED,
+    MUHASH,
+    NONE,
+};
+
+struct CCoinsStats
+{
+    int nHeight;
+    uint256 hashBlock;
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    uint64_t nBogoSize;
+    //! hash_serialized_2 or MuHash of the coins, depending on the requested CoinStatsHashType
+    uint256 hashSerialized;
+    uint64_t nDiskSize;
+    CAmount nTotalAmount;
+
+    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0) {}
+};
+
+//! Add the unspent outputs of one transaction to the statistics and to the serialized hash
+void ApplyCoinStats(CCoinsStats& stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs);
+
+//! Add a coin to, or remove it from, the MuHash of a set of coins
+void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
+void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
+
+//! Size of a coin for the bogosize statistic
+uint64_t GetBogoSize(const Coin& coin);
+
+//! Maximum number of threads scanning ranges of the UTXO set concurrently
+static const int MAX_COINS_SCAN_THREADS = 16;
+
+//! Number of ranges to scan the UTXO set in: one per core, up to MAX_COINS_SCAN_THREADS
+int GetCoinsScanThreads();
+
+/**
+ * Call fn(i, cursor) for every cursor i of CCoinsView::RangeCursors(), each
+ * in a thread of its own, and return once all calls have. An exception thrown
+ * by fn is rethrown afterwards.
+ */
+void ForEachCoinsRange(std::vector<std::unique_ptr<CCoinsViewCursor>>& cursors, const std::function<void(size_t, CCoinsViewCursor&)>& fn);
+
+//! Calculate statistics about the unspent transaction output set
+bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, CoinStatsHashType hash_type = CoinStatsHashType::HASH_SERIALIZED);
+
+#endif // BITCOIN_NODE_COINSTATS_H
@@ -0,0 +1,213 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/utxo_snapshot.h>
+
+#include <chain.h>
+#include <clientversion.h>
+#include <coins.h>
+#include <hash.h>
+#include <node/coinstats.h>
+#include <shutdown.h>
+#include <streams.h>
+#include <sync.h>
+#include <txdb.h>
+#include <util/system.h>
+#include <validation.h>
+#include <version.h>
+
+#include <boost/thread.hpp>
+
+#include <map>
+#include <memory>
+#include <stdio.h>
+#include <utility>
+#include <vector>
+
+constexpr char SnapshotMetadata::MAGIC[];
+const uint16_t SnapshotMetadata::VERSION;
+
+//! Number of coins loaded into memory before they are written to the database.
+static const size_t SNAPSHOT_LOAD_CHUNK_COINS = 250000;
+
+static void WriteSnapshotOutputs(CAutoFile& file, const uint256& txid, const std::map<uint32_t, Coin>& outputs)
+{
+    file << txid;
+    WriteCompactSize(file, outputs.size());
+    for (const auto& output : outputs) {
+        file << VARINT(output.first) << output.second;
+    }
+}
+
+bool DumpUTXOSnapshot(CCoinsViewCursor& cursor, CAutoFile& file, SnapshotMetadata& metadata)
+{
+    try {
+        metadata.m_base_blockhash = cursor.GetBestBlock();
+        metadata.m_coins_count = 0;
+        metadata.m_hash_serialized.SetNull();
+        // Placeholder, rewritten below once the count and hash are known.
+        file << metadata;
+
+        // Hash the coins exactly as GetUTXOStats() does.
+        CCoinsStats stats;
+        CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+        ss << metadata.m_base_blockhash;
+        uint256 prevkey;
+        std::map<uint32_t, Coin> outputs;
+        while (cursor.Valid()) {
+            boost::this_thread::interruption_point();
+            COutPoint key;
+            Coin coin;
+            if (!cursor.GetKey(key) || !cursor.GetValue(coin)) {
+                return error("%s: unable to read value", __func__);
+            }
+            if (!outputs.empty() && key.hash != prevkey) {
+                ApplyCoinStats(stats, ss, prevkey, outputs);
+                WriteSnapshotOutputs(file, prevkey, outputs);
+                outputs.clear();
+            }
+            prevkey = key.hash;
+            outputs[key.n] = std::move(coin);
+            cursor.Next();
+        }
+        if (!outputs.empty()) {
+            ApplyCoinStats(stats, ss, prevkey, outputs);
+            WriteSnapshotOutputs(file, prevkey, outputs);
+        }
+
+        metadata.m_coins_count = stats.nTransactionOutputs;
+        metadata.m_hash_serialized = ss.GetHash();
+        if (fseek(file.Get(), 0, SEEK_SET) != 0) {
+            return error("%s: unable to seek to start of file", __func__);
+        }
+        file << metadata;
+        if (!FileCommit(file.Get())) {
+            return error("%s: FileCommit failed", __func__);
+        }
+    } catch (const std::exception& e) {
+        return error("%s: %s", __func__, e.what());
+    }
+    return true;
+}
+
+//! Read the coins following the metadata into the database, and check their hash.
+static bool LoadSnapshotCoins(CCoinsViewDB& db, CAutoFile& file, const SnapshotMetadata& metadata, std::string& error)
+{
+    CCoinsStats stats;
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << metadata.m_base_blockhash;
+    std::map<uint32_t, Coin> outputs;
+    std::vector<std::pair<COutPoint, Coin>> chunk;
+    uint64_t coins_read = 0;
+    while (coins_read < metadata.m_coins_count) {
+        if (ShutdownRequested()) {
+            error = "Shutdown requested while loading the UTXO snapshot";
+            return false;
+        }
+        uint256 txid;
+        file >> txid;
+        const uint64_t count = ReadCompactSize(file);
+        if (count == 0 || count > metadata.m_coins_count - coins_read) {
+            error = "Invalid coin count in UTXO snapshot";
+            return false;
+        }
+        outputs.clear();
+        for (uint64_t i = 0; i < count; ++i) {
+            uint32_t n;
+            Coin coin;
+            file >> VARINT(n) >> coin;
+            if (coin.IsSpent() || !outputs.emplace(n, std::move(coin)).second) {
+                error = "Invalid coin in UTXO snapshot";
+                return false;
+            }
+        }
+        ApplyCoinStats(stats, ss, txid, outputs);
+        for (auto& output : outputs) {
+            chunk.emplace_back(COutPoint(txid, output.first), std::move(output.second));
+        }
+        coins_read += count;
+
+        if (chunk.size() >= SNAPSHOT_LOAD_CHUNK_COINS || coins_read == metadata.m_coins_count) {
+            if (!db.WriteSnapshotCoins(chunk)) {
+                error = "Failed to write coins to the chainstate database";
+                return false;
+            }
+            chunk.clear();
+            LogPrintf("[snapshot] loaded %u of %u coins\n", coins_read, metadata.m_coins_count);
+        }
+    }
+
+    stats.hashSerialized = ss.GetHash();
+    if (stats.hashSerialized != metadata.m_hash_serialized) {
+        error = strprintf("UTXO snapshot coins hash to %s instead of %s", stats.hashSerialized.ToString(), metadata.m_hash_serialized.ToString());
+        return false;
+    }
+    return true;
+}
+
+bool LoadUTXOSnapshot(CCoinsViewDB& db, const fs::path& path, const uint256& expected_hash, std::string& error)
+{
+    AssertLockHeld(cs_main);
+
+    FILE* filestr = fsbridge::fopen(path, "rb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        error = strprintf("Unable to open UTXO snapshot %s", path.string());
+        return false;
+    }
+
+    std::unique_ptr<CCoinsViewCursor> cursor(db.Cursor());
+    if (!db.GetBestBlock().IsNull() || !db.GetHeadBlocks().empty() || db.IsLoadingSnapshot() || cursor->Valid()) {
+        error = "The chainstate database is not empty";
+        return false;
+    }
+    cursor.reset();
+
+    SnapshotMetadata metadata;
+    try {
+        file >> metadata;
+    } catch (const std::exception& e) {
+        error = strprintf("Unable to read UTXO snapshot: %s", e.what());
+        return false;
+    }
+    // The hash in the file only protects against corruption; the coins are
+    // trusted because the user vouched for this hash.
+    if (metadata.m_hash_serialized != expected_hash) {
+        error = strprintf("UTXO snapshot hash %s does not match the expected %s", metadata.m_hash_serialized.ToString(), expected_hash.ToString());
+        return false;
+    }
+    const CBlockIndex* base = LookupBlockIndex(metadata.m_base_blockhash);
+    if (!base || base->nChainTx == 0) {
+        error = strprintf("The base block %s of the UTXO snapshot is not in the block index", metadata.m_base_blockhash.ToString());
+        return false;
+    }
+    LogPrintf("Loading UTXO snapshot of %u coins at height %d (%s)\n", metadata.m_coins_count, base->nHeight, base->GetBlockHash().ToString());
+
+    // From here on the database is marked as loading a snapshot, so that the
+    // coins are removed again should the load not finish, here or on the next
+    // start after a crash.
+    if (!db.StartSnapshot(metadata.m_base_blockhash)) {
+        error = "Failed to write to the chainstate database";
+        return false;
+    }
+    bool loaded;
+    try {
+        loaded = LoadSnapshotCoins(db, file, metadata, error);
+    } catch (const std::exception& e) {
+        error = strprintf("Unable to read UTXO snapshot: %s", e.what());
+        loaded = false;
+    }
+    if (loaded && !db.FinishSnapshot(metadata.m_base_blockhash)) {
+        error = "Failed to write the best block to the chainstate database";
+        loaded = false;
+    }
+    if (!loaded) {
+        if (!db.ClearSnapshot()) {
+            error += "; removing the loaded coins from the chainstate database failed too";
+        }
+        return false;
+    }
+    LogPrintf("Loaded UTXO snapshot with hash_serialized_2 %s\n", metadata.m_hash_serialized.ToString());
+    return true;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_UTXO_SNAPSHOT_H
+#define BITCOIN_NODE_UTXO_SNAPSHOT_H
+
+#include <fs.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <ios>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+class CAutoFile;
+class CCoinsViewCursor;
+class CCoinsViewDB;
+
+/**
+ * Header of a UTXO snapshot file, as written by the dumptxoutset RPC.
+ *
+ * The header is followed by the coins, in database order and grouped by
+ * transaction: the txid, the number of unspent outputs, and for each output
+ * its index and the Coin. The serialized hash is the hash_serialized_2 of
+ * gettxoutsetinfo at the base block, computed over the same coins.
+ */
+class SnapshotMetadata
+{
+public:
+    static const uint16_t VERSION = 1;
+
+    //! Hash of the block the coins are the unspent outputs of.
+    uint256 m_base_blockhash;
+    //! Number of coins in the snapshot.
+    uint64_t m_coins_count = 0;
+    //! Hash of the coins, as computed by GetUTXOStats().
+    uint256 m_hash_serialized;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s.write(MAGIC, sizeof(MAGIC));
+        s << VERSION << m_base_blockhash << m_coins_count << m_hash_serialized;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char magic[sizeof(MAGIC)];
+        s.read(magic, sizeof(magic));
+        if (memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+            throw std::ios_base::failure("Not a UTXO snapshot file");
+        }
+        uint16_t version;
+        s >> version;
+        if (version != VERSION) {
+            throw std::ios_base::failure("Unsupported UTXO snapshot version");
+        }
+        s >> m_base_blockhash >> m_coins_count >> m_hash_serialized;
+    }
+
+private:
+    static constexpr char MAGIC[4] = {'u', 't', 'x', 'o'};
+};
+
+/**
+ * Write the coins visible through cursor, preceded by their metadata, to file.
+ * The file must be seekable, as the metadata is only known at the end.
+ */
+bool DumpUTXOSnapshot(CCoinsViewCursor& cursor, CAutoFile& file, SnapshotMetadata& metadata);
+
+/**
+ * Populate an empty coins database from a snapshot file. The hash in the
+ * metadata must be expected_hash, and the coins are only made visible (by
+ * setting the best block) when they hash to it; on failure they are removed
+ * again. Requires cs_main; the base block must be in the block index with all
+ * its ancestors' transactions, as blocks on top of it are connected normally
+ * afterwards.
+ */
+bool LoadUTXOSnapshot(CCoinsViewDB& db, const fs::path& path, const uint256& expected_hash, std::string& error);
+
+#endif // BITCOIN_NODE_UTXO_SNAPSHOT_H
@@ -7,6 +7,7 @@
 
 #include <policy/policy.h>
 
+#include <consensus/tx_verify.h>
 #include <consensus/validation.h>
 #include <validation.h>
 #include <coins.h>
@@ -158,13 +159,21 @@ bool IsStandardTx(const CTransaction& tx, std::string& reason)
  *   DUP CHECKSIG DROP ... repeated 100 times... OP_1
  */
 bool AreInputsStandard(const CTransaction& tx, const CCoinsViewCache& mapInputs)
+{
+    if (tx.IsCoinBase())
+        return true; // Coinbases don't use vin normally
+    return AreInputsStandard(tx, GetSpentCoins(tx, mapInputs));
+}
+
+bool AreInputsStandard(const CTransaction& tx, const std::vector<Coin>& spent_coins)
 {
     if (tx.IsCoinBase())
         return true; // Coinbases don't use vin normally
 
+    assert(spent_coins.size() == tx.vin.size());
     for (unsigned int i = 0; i < tx.vin.size(); i++)
     {
-        const CTxOut& prev = mapInputs.AccessCoin(tx.vin[i].prevout).out;
+        const CTxOut& prev = spent_coins[i].out;
 
         std::vector<std::vector<unsigned char> > vSolutions;
         txnouttype whichType = Solver(prev.scriptPubKey, vSolutions);
@@ -188,10 +197,18 @@ bool AreInputsStandard(const CTransaction& tx, const CCoinsViewCache& mapInputs)
 }
 
 bool IsWitnessStandard(const CTransaction& tx, const CCoinsViewCache& mapInputs)
+{
+    if (tx.IsCoinBase())
+        return true; // Coinbases are skipped
+    return IsWitnessStandard(tx, GetSpentCoins(tx, mapInputs));
+}
+
+bool IsWitnessStandard(const CTransaction& tx, const std::vector<Coin>& spent_coins)
 {
     if (tx.IsCoinBase())
         return true; // Coinbases are skipped
 
+    assert(spent_coins.size() == tx.vin.size());
     for (unsigned int i = 0; i < tx.vin.size(); i++)
     {
         // We don't care if witness for this input is empty, since it must not be bloated.
@@ -199,7 +216,7 @@ bool IsWitnessStandard(const CTransaction& tx, const CCoinsViewCache& mapInputs)
         if (tx.vin[i].scriptWitness.IsNull())
             continue;
 
-        const CTxOut &prev = mapInputs.AccessCoin(tx.vin[i].prevout).out;
+        const CTxOut &prev = spent_coins[i].out;
 
         // get the scriptPubKey corresponding to this input:
         CScript prevScript = prev.scriptPubKey;
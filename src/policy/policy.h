@@ -12,8 +12,10 @@
 #include <script/standard.h>
 
 #include <string>
+#include <vector>
 
 class CCoinsViewCache;
+class Coin;
 class CTxOut;
 
 /** Default for -blockmaxweight, which controls the range of block weights the mining code will create **/
@@ -91,12 +93,14 @@ bool IsStandardTx(const CTransaction& tx, std::string& reason);
      * @return True if all inputs (scriptSigs) use only standard transaction forms
      */
 bool AreInputsStandard(const CTransaction& tx, const CCoinsViewCache& mapInputs);
+bool AreInputsStandard(const CTransaction& tx, const std::vector<Coin>& spent_coins);
     /**
      * Check if the transaction is over standard P2WSH resources limit:
      * 3600bytes witnessScript size, 80bytes per witness stack element, 100 witness stack elements
      * These limits are adequate for multi-signature up to n-of-100 using OP_CHECKSIG, OP_ADD, and OP_EQUAL,
      */
 bool IsWitnessStandard(const CTransaction& tx, const CCoinsViewCache& mapInputs);
+bool IsWitnessStandard(const CTransaction& tx, const std::vector<Coin>& spent_coins);
 
 extern CFeeRate incrementalRelayFee;
 extern CFeeRate dustRelayFee;
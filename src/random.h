@@ -47,7 +47,9 @@ private:
     bool requires_seed;
     ChaCha20 rng;
 
-    unsigned char bytebuf[64];
+    /** Buffered keystream. Four ChaCha20 blocks, so that refills can use the
+     *  multi-block keystream generator where one is available. */
+    unsigned char bytebuf[256];
     int bytebuf_size;
 
     uint64_t bitbuf;
@@ -80,7 +82,7 @@ public:
     uint64_t rand64()
     {
         if (bytebuf_size < 8) FillByteBuffer();
-        uint64_t ret = ReadLE64(bytebuf + 64 - bytebuf_size);
+        uint64_t ret = ReadLE64(bytebuf + sizeof(bytebuf) - bytebuf_size);
         bytebuf_size -= 8;
         return ret;
     }
@@ -10,12 +10,17 @@
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
+#include <clientversion.h>
 #include <coins.h>
 #include <consensus/validation.h>
 #include <validation.h>
 #include <core_io.h>
+#include <fs.h>
+#include <index/coinstatsindex.h>
 #include <index/txindex.h>
 #include <key_io.h>
+#include <node/coinstats.h>
+#include <node/utxo_snapshot.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
@@ -850,75 +855,48 @@ static UniValue getblock(const JSONRPCRequest& request)
     return blockToJSON(block, pblockindex, verbosity >= 2);
 }
 
-struct CCoinsStats
+//! Find the active chain block given by a hash or height parameter
+static CBlockIndex* ParseHashOrHeight(const UniValue& param) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
-    int nHeight;
-    uint256 hashBlock;
-    uint64_t nTransactions;
-    uint64_t nTransactionOutputs;
-    uint64_t nBogoSize;
-    uint256 hashSerialized;
-    uint64_t nDiskSize;
-    CAmount nTotalAmount;
-
-    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0) {}
-};
-
-static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
-{
-    assert(!outputs.empty());
-    ss << hash;
-    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase ? 1u : 0u);
-    stats.nTransactions++;
-    for (const auto& output : outputs) {
-        ss << VARINT(output.first + 1);
-        ss << output.second.out.scriptPubKey;
-        ss << VARINT(output.second.out.nValue, VarIntMode::NONNEGATIVE_SIGNED);
-        stats.nTransactionOutputs++;
-        stats.nTotalAmount += output.second.out.nValue;
-        stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
-                           2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */;
-    }
-    ss << VARINT(0u);
-}
+    AssertLockHeld(cs_main);
 
-//! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
-{
-    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
-    assert(pcursor);
+    CBlockIndex* pindex;
+    if (param.isNum()) {
+        const int height = param.get_int();
+        const int current_tip = chainActive.Height();
+        if (height < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d is negative", height));
+        }
+        if (height > current_tip) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d after current tip %d", height, current_tip));
+        }
 
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = pcursor->GetBestBlock();
-    {
-        LOCK(cs_main);
-        stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
-    }
-    ss << stats.hashBlock;
-    uint256 prevkey;
-    std::map<uint32_t, Coin> outputs;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        COutPoint key;
-        Coin coin;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            if (!outputs.empty() && key.hash != prevkey) {
-                ApplyStats(stats, ss, prevkey, outputs);
-                outputs.clear();
-            }
-            prevkey = key.hash;
-            outputs[key.n] = std::move(coin);
-        } else {
-            return error("%s: unable to read value", __func__);
+        pindex = chainActive[height];
+    } else {
+        const uint256 hash(ParseHashV(param, "hash_or_height"));
+        pindex = LookupBlockIndex(hash);
+        if (!pindex) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        if (!chainActive.Contains(pindex)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Block is not in chain %s", Params().NetworkIDString()));
         }
-        pcursor->Next();
-    }
-    if (!outputs.empty()) {
-        ApplyStats(stats, ss, prevkey, outputs);
     }
-    stats.hashSerialized = ss.GetHash();
-    stats.nDiskSize = view->EstimateSize();
-    return true;
+
+    assert(pindex != nullptr);
+    return pindex;
+}
+
+static CoinStatsHashType ParseHashType(const std::string& hash_type_input)
+{
+    if (hash_type_input == "hash_serialized_2") {
+        return CoinStatsHashType::HASH_SERIALIZED;
+    } else if (hash_type_input == "muhash") {
+        return CoinStatsHashType::MUHASH;
+    } else if (hash_type_input == "none") {
+        return CoinStatsHashType::NONE;
+    }
+    throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("%s is not a valid hash_type", hash_type_input));
 }
 
 static UniValue pruneblockchain(const JSONRPCRequest& request)
@@ -972,43 +950,140 @@ static UniValue pruneblockchain(const JSONRPCRequest& request)
 
 static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 2)
         throw std::runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" hash_or_height )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Note this call may take some time, unless -coinstatsindex is enabled and hash_type is not hash_serialized_2.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"        (string, optional, default=\"hash_serialized_2\") Which UTXO set hash should be calculated. Options: 'hash_serialized_2' (the legacy algorithm), 'muhash', 'none'.\n"
+            "2. hash_or_height     (string or numeric, optional) The block hash or height of the target block. Requires -coinstatsindex and a hash_type other than hash_serialized_2.\n"
             "\nResult:\n"
             "{\n"
-            "  \"height\":n,     (numeric) The current block height (index)\n"
-            "  \"bestblock\": \"hex\",   (string) The hash of the block at the tip of the chain\n"
-            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs\n"
+            "  \"height\":n,     (numeric) The block height (index) of the statistics\n"
+            "  \"bestblock\": \"hex\",   (string) The hash of the block the statistics are for\n"
+            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs (not available from -coinstatsindex)\n"
             "  \"txouts\": n,            (numeric) The number of unspent transaction outputs\n"
             "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
-            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash\n"
-            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash (only present if 'hash_serialized_2' hash_type is chosen)\n"
+            "  \"muhash\": \"hash\",      (string) The MuHash of the coins (only present if 'muhash' hash_type is chosen)\n"
+            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk (not available from -coinstatsindex)\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"none\"")
+            + HelpExampleCli("gettxoutsetinfo", "\"muhash\" 1000")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
     UniValue ret(UniValue::VOBJ);
 
+    const CoinStatsHashType hash_type = request.params[0].isNull() ? CoinStatsHashType::HASH_SERIALIZED : ParseHashType(request.params[0].get_str());
+    const bool use_index = g_coin_stats_index && hash_type != CoinStatsHashType::HASH_SERIALIZED;
+    if (!request.params[1].isNull() && !use_index) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Querying a specific block requires -coinstatsindex and a hash_type other than hash_serialized_2");
+    }
+
     CCoinsStats stats;
-    FlushStateToDisk();
-    if (GetUTXOStats(pcoinsdbview.get(), stats)) {
-        ret.pushKV("height", (int64_t)stats.nHeight);
-        ret.pushKV("bestblock", stats.hashBlock.GetHex());
+    if (use_index) {
+        const CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            pindex = request.params[1].isNull() ? chainActive.Tip() : ParseHashOrHeight(request.params[1]);
+        }
+        g_coin_stats_index->BlockUntilSyncedToCurrentChain();
+        if (!g_coin_stats_index->LookUpStats(pindex, stats)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set statistics from -coinstatsindex. The index may still be syncing");
+        }
+    } else {
+        FlushStateToDisk();
+        if (!GetUTXOStats(pcoinsdbview.get(), stats, hash_type)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        }
+    }
+
+    ret.pushKV("height", (int64_t)stats.nHeight);
+    ret.pushKV("bestblock", stats.hashBlock.GetHex());
+    if (!use_index) {
         ret.pushKV("transactions", (int64_t)stats.nTransactions);
-        ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
-        ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+    }
+    ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
+    ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+    if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
         ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
+    } else if (hash_type == CoinStatsHashType::MUHASH) {
+        ret.pushKV("muhash", stats.hashSerialized.GetHex());
+    }
+    if (!use_index) {
         ret.pushKV("disk_size", stats.nDiskSize);
-        ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
-    } else {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
     }
+    ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+    return ret;
+}
+
+static UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrite the unspent transaction output set to a snapshot file, which -loadutxosnapshot can load into an empty chainstate.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"       (string, required) The file to write. Relative paths are prefixed by the data directory\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,       (numeric) The number of coins written to the snapshot\n"
+            "  \"base_hash\": \"hex\",      (string) The hash of the block the snapshot was taken at\n"
+            "  \"base_height\": n,         (numeric) The height of that block\n"
+            "  \"path\": \"path\",           (string) The absolute path the snapshot was written to\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash of the coins, as returned by gettxoutsetinfo\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    // Write to a temporary file first, so that an existing snapshot file is
+    // always complete.
+    const fs::path temppath = path.string() + ".incomplete";
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists. Refusing to overwrite it.");
+    }
+
+    FILE* filestr = fsbridge::fopen(temppath, "wb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Couldn't open file " + temppath.string() + " for writing.");
+    }
+
+    // The cursor iterates over a consistent view of the database as of its
+    // creation, so cs_main is not needed while writing.
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    int base_height;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        pcursor = std::unique_ptr<CCoinsViewCursor>(pcoinsdbview->Cursor());
+        assert(pcursor);
+        base_height = LookupBlockIndex(pcursor->GetBestBlock())->nHeight;
+    }
+
+    SnapshotMetadata metadata;
+    bool written = DumpUTXOSnapshot(*pcursor, file, metadata);
+    file.fclose();
+    if (!written || !RenameOver(temppath, path)) {
+        fs::remove(temppath);
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to write the UTXO snapshot");
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("coins_written", metadata.m_coins_count);
+    ret.pushKV("base_hash", metadata.m_base_blockhash.GetHex());
+    ret.pushKV("base_height", base_height);
+    ret.pushKV("path", path.string());
+    ret.pushKV("hash_serialized_2", metadata.m_hash_serialized.GetHex());
     return ret;
 }
 
@@ -1750,30 +1825,7 @@ static UniValue getblockstats(const JSONRPCRequest& request)
 
     LOCK(cs_main);
 
-    CBlockIndex* pindex;
-    if (request.params[0].isNum()) {
-        const int height = request.params[0].get_int();
-        const int current_tip = chainActive.Height();
-        if (height < 0) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d is negative", height));
-        }
-        if (height > current_tip) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d after current tip %d", height, current_tip));
-        }
-
-        pindex = chainActive[height];
-    } else {
-        const uint256 hash(ParseHashV(request.params[0], "hash_or_height"));
-        pindex = LookupBlockIndex(hash);
-        if (!pindex) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-        }
-        if (!chainActive.Contains(pindex)) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Block is not in chain %s", Params().NetworkIDString()));
-        }
-    }
-
-    assert(pindex != nullptr);
+    CBlockIndex* pindex = ParseHashOrHeight(request.params[0]);
 
     std::set<std::string> stats;
     if (!request.params[1].isNull()) {
@@ -1975,10 +2027,17 @@ static UniValue savemempool(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
-//! Search for a given set of pubkey scripts
-bool FindScriptPubKey(std::atomic<int>& scan_progress, const std::atomic<bool>& should_abort, int64_t& count, CCoinsViewCursor* cursor, const std::set<CScript>& needles, std::map<COutPoint, Coin>& out_results) {
-    scan_progress = 0;
+//! Search for a given set of pubkey scripts in the coins of the txid prefix
+//! range [range_begin, range_end). scanned accumulates the number of prefixes
+//! passed by all concurrent searches, from which scan_progress is derived.
+static bool FindScriptPubKey(std::atomic<int>& scan_progress, std::atomic<uint32_t>& scanned, uint32_t range_begin, uint32_t range_end, const std::atomic<bool>& should_abort, int64_t& count, CCoinsViewCursor* cursor, const std::set<CScript>& needles, std::map<COutPoint, Coin>& out_results) {
     count = 0;
+    uint32_t position = range_begin;
+    auto advance = [&](uint32_t to) {
+        scanned += to - position;
+        position = to;
+        scan_progress = (int)(scanned * 100.0 / COINS_RANGE_PREFIXES + 0.5);
+    };
     while (cursor->Valid()) {
         COutPoint key;
         Coin coin;
@@ -1992,15 +2051,14 @@ bool FindScriptPubKey(std::atomic<int>& scan_progress, const std::atomic<bool>&
         }
         if (count % 256 == 0) {
             // update progress reference every 256 item
-            uint32_t high = 0x100 * *key.hash.begin() + *(key.hash.begin() + 1);
-            scan_progress = (int)(high * 100.0 / 65536.0 + 0.5);
+            advance(CoinsRangePrefix(key.hash));
         }
         if (needles.count(coin.out.scriptPubKey)) {
             out_results.emplace(key, coin);
         }
         cursor->Next();
     }
-    scan_progress = 100;
+    advance(range_end);
     return true;
 }
 
@@ -2150,15 +2208,28 @@ UniValue scantxoutset(const JSONRPCRequest& request)
         std::map<COutPoint, Coin> coins;
         g_should_abort_scan = false;
         g_scan_progress = 0;
-        int64_t count = 0;
-        std::unique_ptr<CCoinsViewCursor> pcursor;
+        std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
         {
             LOCK(cs_main);
             FlushStateToDisk();
-            pcursor = std::unique_ptr<CCoinsViewCursor>(pcoinsdbview->Cursor());
-            assert(pcursor);
+            cursors = pcoinsdbview->RangeCursors(GetCoinsScanThreads());
+            assert(!cursors.empty());
+        }
+        // Search the ranges of the UTXO set concurrently and merge the results.
+        std::vector<int64_t> range_count(cursors.size(), 0);
+        std::vector<std::map<COutPoint, Coin>> range_coins(cursors.size());
+        std::vector<char> range_res(cursors.size(), false);
+        std::atomic<uint32_t> scanned{0};
+        ForEachCoinsRange(cursors, [&](size_t i, CCoinsViewCursor& cursor) {
+            range_res[i] = FindScriptPubKey(g_scan_progress, scanned, CoinsRangeBegin(i, cursors.size()), CoinsRangeBegin(i + 1, cursors.size()), g_should_abort_scan, range_count[i], &cursor, needles, range_coins[i]);
+        });
+        bool res = true;
+        int64_t count = 0;
+        for (size_t i = 0; i < cursors.size(); ++i) {
+            res = res && range_res[i];
+            count += range_count[i];
+            coins.insert(range_coins[i].begin(), range_coins[i].end());
         }
-        bool res = FindScriptPubKey(g_scan_progress, g_should_abort_scan, count, pcursor.get(), needles, coins);
         result.pushKV("success", res);
         result.pushKV("searched_items", count);
 
@@ -2206,7 +2277,8 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {"hash_type", "hash_or_height"} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           {"path"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
@@ -0,0 +1,430 @@
+/**********************************************************************
+ * Copyright (c) 2018 The Bitcoin Core developers                     *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+/*
+AArch64 implementation of field_5x52 inner loops.
+
+This is a direct translation of field_5x52_int128_impl.h: every 128-bit
+accumulator is a register pair, built with MUL/UMULH and ADDS/ADC, and
+">> 52" on a pair is an EXTR plus LSR. The outputs are bit-identical to
+the C implementation, so the same magnitude bounds apply.
+
+Note:
+
+- r may alias a (but not b): all inputs are loaded before the first store.
+- x19-x22 are callee-saved under AAPCS64 and are spilled to the stack.
+*/
+
+	.text
+
+	.align	4
+	.global secp256k1_fe_mul_inner
+	.type	secp256k1_fe_mul_inner, %function
+	/* Arguments:
+	 *  x0  r      Restrict: can overlap with a, not with b
+	 *  x1  a
+	 *  x2  b
+	 *
+	 * Allocation:
+	 *  x3-x7     a0..a4
+	 *  x8-x12    b0..b4
+	 *  x13:x14   c
+	 *  x15:x16   d
+	 *  x17       t3
+	 *  x1        t4 (after loading a)
+	 *  x2        tx, scratch (after loading b)
+	 *  x19:x20   product scratch
+	 *  x21       u0, scratch
+	 *  x22       R = 0x1000003D10
+	 */
+secp256k1_fe_mul_inner:
+	stp	x19, x20, [sp, #-32]!
+	stp	x21, x22, [sp, #16]
+	ldp	x3, x4, [x1]
+	ldp	x5, x6, [x1, #16]
+	ldr	x7, [x1, #32]
+	ldp	x8, x9, [x2]
+	ldp	x10, x11, [x2, #16]
+	ldr	x12, [x2, #32]
+	mov	x22, #0x3d10
+	movk	x22, #0x10, lsl #32
+
+	/* d = a0*b3 + a1*b2 + a2*b1 + a3*b0 */
+	mul	x15, x3, x11
+	umulh	x16, x3, x11
+	mul	x19, x4, x10
+	umulh	x20, x4, x10
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	mul	x19, x5, x9
+	umulh	x20, x5, x9
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	mul	x19, x6, x8
+	umulh	x20, x6, x8
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	/* c = a4*b4 */
+	mul	x13, x7, x12
+	umulh	x14, x7, x12
+	/* d += (c & M) * R; c >>= 52 */
+	and	x21, x13, #0xfffffffffffff
+	mul	x19, x21, x22
+	umulh	x20, x21, x22
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	extr	x13, x14, x13, #0x34
+	lsr	x14, x14, #0x34
+	/* t3 = d & M; d >>= 52 */
+	and	x17, x15, #0xfffffffffffff
+	extr	x15, x16, x15, #0x34
+	lsr	x16, x16, #0x34
+
+	/* d += a0*b4 + a1*b3 + a2*b2 + a3*b1 + a4*b0 */
+	mul	x19, x3, x12
+	umulh	x20, x3, x12
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	mul	x19, x4, x11
+	umulh	x20, x4, x11
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	mul	x19, x5, x10
+	umulh	x20, x5, x10
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	mul	x19, x6, x9
+	umulh	x20, x6, x9
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	mul	x19, x7, x8
+	umulh	x20, x7, x8
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	/* d += c * R */
+	mul	x19, x13, x22
+	umulh	x20, x13, x22
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	/* t4 = d & M; d >>= 52; tx = t4 >> 48; t4 &= M >> 4 */
+	and	x1, x15, #0xfffffffffffff
+	extr	x15, x16, x15, #0x34
+	lsr	x16, x16, #0x34
+	lsr	x2, x1, #0x30
+	and	x1, x1, #0xffffffffffff
+
+	/* c = a0*b0 */
+	mul	x13, x3, x8
+	umulh	x14, x3, x8
+	/* d += a1*b4 + a2*b3 + a3*b2 + a4*b1 */
+	mul	x19, x4, x12
+	umulh	x20, x4, x12
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	mul	x19, x5, x11
+	umulh	x20, x5, x11
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	mul	x19, x6, x10
+	umulh	x20, x6, x10
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	mul	x19, x7, x9
+	umulh	x20, x7, x9
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	/* u0 = ((d & M) << 4) | tx; d >>= 52 */
+	and	x21, x15, #0xfffffffffffff
+	orr	x21, x2, x21, lsl #4
+	extr	x15, x16, x15, #0x34
+	lsr	x16, x16, #0x34
+	/* c += u0 * (R >> 4) */
+	lsr	x2, x22, #4
+	mul	x19, x21, x2
+	umulh	x20, x21, x2
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	/* r[0] = c & M; c >>= 52 */
+	and	x2, x13, #0xfffffffffffff
+	str	x2, [x0]
+	extr	x13, x14, x13, #0x34
+	lsr	x14, x14, #0x34
+
+	/* c += a0*b1 + a1*b0 */
+	mul	x19, x3, x9
+	umulh	x20, x3, x9
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	mul	x19, x4, x8
+	umulh	x20, x4, x8
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	/* d += a2*b4 + a3*b3 + a4*b2 */
+	mul	x19, x5, x12
+	umulh	x20, x5, x12
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	mul	x19, x6, x11
+	umulh	x20, x6, x11
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	mul	x19, x7, x10
+	umulh	x20, x7, x10
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	/* c += (d & M) * R; d >>= 52 */
+	and	x21, x15, #0xfffffffffffff
+	mul	x19, x21, x22
+	umulh	x20, x21, x22
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	extr	x15, x16, x15, #0x34
+	lsr	x16, x16, #0x34
+	/* r[1] = c & M; c >>= 52 */
+	and	x2, x13, #0xfffffffffffff
+	str	x2, [x0, #8]
+	extr	x13, x14, x13, #0x34
+	lsr	x14, x14, #0x34
+
+	/* c += a0*b2 + a1*b1 + a2*b0 */
+	mul	x19, x3, x10
+	umulh	x20, x3, x10
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	mul	x19, x4, x9
+	umulh	x20, x4, x9
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	mul	x19, x5, x8
+	umulh	x20, x5, x8
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	/* d += a3*b4 + a4*b3 */
+	mul	x19, x6, x12
+	umulh	x20, x6, x12
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	mul	x19, x7, x11
+	umulh	x20, x7, x11
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	/* c += (d & M) * R; d >>= 52 */
+	and	x21, x15, #0xfffffffffffff
+	mul	x19, x21, x22
+	umulh	x20, x21, x22
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	extr	x15, x16, x15, #0x34
+	lsr	x16, x16, #0x34
+	/* r[2] = c & M; c >>= 52 */
+	and	x2, x13, #0xfffffffffffff
+	str	x2, [x0, #16]
+	extr	x13, x14, x13, #0x34
+	lsr	x14, x14, #0x34
+
+	/* c += d * R + t3 */
+	mul	x19, x15, x22
+	umulh	x20, x15, x22
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	adds	x13, x13, x17
+	adc	x14, x14, xzr
+	/* r[3] = c & M; c >>= 52 */
+	and	x2, x13, #0xfffffffffffff
+	str	x2, [x0, #24]
+	extr	x13, x14, x13, #0x34
+	/* r[4] = c + t4 */
+	add	x13, x13, x1
+	str	x13, [x0, #32]
+
+	ldp	x21, x22, [sp, #16]
+	ldp	x19, x20, [sp], #32
+	ret	
+	.size	secp256k1_fe_mul_inner, .-secp256k1_fe_mul_inner
+
+	.align	4
+	.global secp256k1_fe_sqr_inner
+	.type	secp256k1_fe_sqr_inner, %function
+	/* Arguments:
+	 *  x0  r      Can overlap with a
+	 *  x1  a
+	 *
+	 * Allocation:
+	 *  x2-x6     a0..a4
+	 *  x13:x14   c
+	 *  x15:x16   d
+	 *  x17       t3
+	 *  x1        t4 (after loading a)
+	 *  x7        tx, scratch
+	 *  x8        u0
+	 *  x9        R = 0x1000003D10
+	 *  x10       scratch
+	 *  x11       doubled limbs
+	 *  x19:x20   product scratch
+	 */
+secp256k1_fe_sqr_inner:
+	stp	x19, x20, [sp, #-16]!
+	ldp	x2, x3, [x1]
+	ldp	x4, x5, [x1, #16]
+	ldr	x6, [x1, #32]
+	mov	x9, #0x3d10
+	movk	x9, #0x10, lsl #32
+
+	/* d = (a0*2)*a3 + (a1*2)*a2 */
+	lsl	x11, x2, #1
+	mul	x15, x11, x5
+	umulh	x16, x11, x5
+	lsl	x11, x3, #1
+	mul	x19, x11, x4
+	umulh	x20, x11, x4
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	/* c = a4*a4 */
+	mul	x13, x6, x6
+	umulh	x14, x6, x6
+	/* d += (c & M) * R; c >>= 52 */
+	and	x10, x13, #0xfffffffffffff
+	mul	x19, x10, x9
+	umulh	x20, x10, x9
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	extr	x13, x14, x13, #0x34
+	lsr	x14, x14, #0x34
+	/* t3 = d & M; d >>= 52 */
+	and	x17, x15, #0xfffffffffffff
+	extr	x15, x16, x15, #0x34
+	lsr	x16, x16, #0x34
+
+	/* a4 *= 2; d += a0*a4 + (a1*2)*a3 + a2*a2 */
+	lsl	x6, x6, #1
+	mul	x19, x2, x6
+	umulh	x20, x2, x6
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	mul	x19, x11, x5
+	umulh	x20, x11, x5
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	mul	x19, x4, x4
+	umulh	x20, x4, x4
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	/* d += c * R */
+	mul	x19, x13, x9
+	umulh	x20, x13, x9
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	/* t4 = d & M; d >>= 52; tx = t4 >> 48; t4 &= M >> 4 */
+	and	x1, x15, #0xfffffffffffff
+	extr	x15, x16, x15, #0x34
+	lsr	x16, x16, #0x34
+	lsr	x7, x1, #0x30
+	and	x1, x1, #0xffffffffffff
+
+	/* c = a0*a0 */
+	mul	x13, x2, x2
+	umulh	x14, x2, x2
+	/* d += a1*a4 + (a2*2)*a3 */
+	mul	x19, x3, x6
+	umulh	x20, x3, x6
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	lsl	x11, x4, #1
+	mul	x19, x11, x5
+	umulh	x20, x11, x5
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	/* u0 = ((d & M) << 4) | tx; d >>= 52 */
+	and	x8, x15, #0xfffffffffffff
+	orr	x8, x7, x8, lsl #4
+	extr	x15, x16, x15, #0x34
+	lsr	x16, x16, #0x34
+	/* c += u0 * (R >> 4) */
+	lsr	x7, x9, #4
+	mul	x19, x8, x7
+	umulh	x20, x8, x7
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	/* r[0] = c & M; c >>= 52 */
+	and	x7, x13, #0xfffffffffffff
+	str	x7, [x0]
+	extr	x13, x14, x13, #0x34
+	lsr	x14, x14, #0x34
+
+	/* a0 *= 2; c += a0*a1 */
+	lsl	x2, x2, #1
+	mul	x19, x2, x3
+	umulh	x20, x2, x3
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	/* d += a2*a4 + a3*a3 */
+	mul	x19, x4, x6
+	umulh	x20, x4, x6
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	mul	x19, x5, x5
+	umulh	x20, x5, x5
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	/* c += (d & M) * R; d >>= 52 */
+	and	x10, x15, #0xfffffffffffff
+	mul	x19, x10, x9
+	umulh	x20, x10, x9
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	extr	x15, x16, x15, #0x34
+	lsr	x16, x16, #0x34
+	/* r[1] = c & M; c >>= 52 */
+	and	x7, x13, #0xfffffffffffff
+	str	x7, [x0, #8]
+	extr	x13, x14, x13, #0x34
+	lsr	x14, x14, #0x34
+
+	/* c += a0*a2 + a1*a1 */
+	mul	x19, x2, x4
+	umulh	x20, x2, x4
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	mul	x19, x3, x3
+	umulh	x20, x3, x3
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	/* d += a3*a4 */
+	mul	x19, x5, x6
+	umulh	x20, x5, x6
+	adds	x15, x15, x19
+	adc	x16, x16, x20
+	/* c += (d & M) * R; d >>= 52 */
+	and	x10, x15, #0xfffffffffffff
+	mul	x19, x10, x9
+	umulh	x20, x10, x9
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	extr	x15, x16, x15, #0x34
+	lsr	x16, x16, #0x34
+	/* r[2] = c & M; c >>= 52 */
+	and	x7, x13, #0xfffffffffffff
+	str	x7, [x0, #16]
+	extr	x13, x14, x13, #0x34
+	lsr	x14, x14, #0x34
+
+	/* c += d * R + t3 */
+	mul	x19, x15, x9
+	umulh	x20, x15, x9
+	adds	x13, x13, x19
+	adc	x14, x14, x20
+	adds	x13, x13, x17
+	adc	x14, x14, xzr
+	/* r[3] = c & M; c >>= 52 */
+	and	x7, x13, #0xfffffffffffff
+	str	x7, [x0, #24]
+	extr	x13, x14, x13, #0x34
+	/* r[4] = c + t4 */
+	add	x13, x13, x1
+	str	x13, [x0, #32]
+
+	ldp	x19, x20, [sp], #16
+	ret	
+	.size	secp256k1_fe_sqr_inner, .-secp256k1_fe_sqr_inner
@@ -17,6 +17,10 @@
 
 #if defined(USE_ASM_X86_64)
 #include "field_5x52_asm_impl.h"
+#elif defined(USE_EXTERNAL_ASM)
+/* External assembler implementation */
+void secp256k1_fe_mul_inner(uint64_t *r, const uint64_t *a, const uint64_t * SECP256K1_RESTRICT b);
+void secp256k1_fe_sqr_inner(uint64_t *r, const uint64_t *a);
 #else
 #include "field_5x52_int128_impl.h"
 #endif
@@ -0,0 +1,160 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/**
+ * A memory resource for node based containers, such as FlatNodeMap, that
+ * allocate many small objects of few distinct sizes.
+ *
+ * Memory is taken from the system in large chunks and handed out in
+ * multiples of ELEM_ALIGN_BYTES. Freed blocks go onto a free list per size
+ * and are reused by later allocations of the same size; they are not
+ * returned to the system until the resource is destroyed. This avoids a
+ * malloc call and its bookkeeping overhead per node, makes the memory usage
+ * exactly known (the number of chunks times the chunk size), and releases
+ * all nodes at once when the resource is destroyed.
+ *
+ * Requests larger than MAX_BLOCK_SIZE_BYTES, or with a stricter alignment
+ * than ALIGN_BYTES (e.g. a hash table's bucket array), go to operator new.
+ *
+ * Not thread safe, like the containers using it.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource
+{
+    /** In-place linked list of the free blocks of one size. */
+    struct ListNode {
+        ListNode* m_next;
+    };
+
+public:
+    /** Size granularity (and alignment) of blocks handed out by the pool. */
+    static constexpr std::size_t ELEM_ALIGN_BYTES = alignof(ListNode) > ALIGN_BYTES ? alignof(ListNode) : ALIGN_BYTES;
+
+    static_assert((ELEM_ALIGN_BYTES & (ELEM_ALIGN_BYTES - 1)) == 0, "ELEM_ALIGN_BYTES must be a power of two");
+    static_assert(sizeof(ListNode) <= ELEM_ALIGN_BYTES, "a free block must be able to hold a ListNode");
+    static_assert(ELEM_ALIGN_BYTES <= alignof(std::max_align_t), "chunks from operator new must be sufficiently aligned");
+
+    /** Default chunk size: 256 KiB. */
+    static constexpr std::size_t DEFAULT_CHUNK_SIZE_BYTES = 262144;
+
+private:
+    /** Size of each chunk, a multiple of ELEM_ALIGN_BYTES. */
+    const std::size_t m_chunk_size_bytes;
+
+    /** All chunks taken from the system, released in the destructor. */
+    std::vector<void*> m_allocated_chunks;
+
+    /** Free lists, indexed by block size in units of ELEM_ALIGN_BYTES. */
+    std::array<ListNode*, (MAX_BLOCK_SIZE_BYTES + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + 1> m_free_lists;
+
+    /** Unused tail of the most recently allocated chunk. */
+    char* m_available_memory_it = nullptr;
+    char* m_available_memory_end = nullptr;
+
+    /** Number of ELEM_ALIGN_BYTES units needed to hold bytes (at least one). */
+    static constexpr std::size_t NumElemAlignBytes(std::size_t bytes)
+    {
+        return bytes == 0 ? 1 : (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES;
+    }
+
+    static constexpr bool IsFreeListUsable(std::size_t bytes, std::size_t alignment)
+    {
+        return alignment <= ELEM_ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    static void PlacementAddToList(void* p, ListNode*& node)
+    {
+        node = new (p) ListNode{node};
+    }
+
+    /** Start a new chunk. What is left of the current one goes onto the free list of its size. */
+    void AllocateChunk()
+    {
+        const std::size_t remaining_bytes = m_available_memory_end - m_available_memory_it;
+        if (remaining_bytes > 0) {
+            PlacementAddToList(m_available_memory_it, m_free_lists[remaining_bytes / ELEM_ALIGN_BYTES]);
+        }
+
+        void* storage = ::operator new(m_chunk_size_bytes);
+        m_allocated_chunks.push_back(storage);
+        m_available_memory_it = static_cast<char*>(storage);
+        m_available_memory_end = m_available_memory_it + m_chunk_size_bytes;
+    }
+
+public:
+    explicit PoolResource(std::size_t chunk_size_bytes)
+        : m_chunk_size_bytes(NumElemAlignBytes(chunk_size_bytes) * ELEM_ALIGN_BYTES)
+    {
+        assert(m_chunk_size_bytes >= MAX_BLOCK_SIZE_BYTES);
+        m_free_lists.fill(nullptr);
+        AllocateChunk();
+    }
+
+    PoolResource() : PoolResource(DEFAULT_CHUNK_SIZE_BYTES) {}
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource()
+    {
+        for (void* chunk : m_allocated_chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (IsFreeListUsable(bytes, alignment)) {
+            const std::size_t num_alignments = NumElemAlignBytes(bytes);
+            ListNode*& free_list = m_free_lists[num_alignments];
+            if (free_list != nullptr) {
+                ListNode* node = free_list;
+                free_list = node->m_next;
+                node->~ListNode();
+                return node;
+            }
+
+            const std::size_t round_bytes = num_alignments * ELEM_ALIGN_BYTES;
+            if (round_bytes > static_cast<std::size_t>(m_available_memory_end - m_available_memory_it)) {
+                AllocateChunk();
+            }
+            void* p = m_available_memory_it;
+            m_available_memory_it += round_bytes;
+            return p;
+        }
+
+        assert(alignment <= alignof(std::max_align_t));
+        return ::operator new(bytes);
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (IsFreeListUsable(bytes, alignment)) {
+            PlacementAddToList(p, m_free_lists[NumElemAlignBytes(bytes)]);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    std::size_t NumAllocatedChunks() const { return m_allocated_chunks.size(); }
+
+    std::size_t ChunkSizeBytes() const { return m_chunk_size_bytes; }
+};
+
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+constexpr std::size_t PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>::ELEM_ALIGN_BYTES;
+
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+constexpr std::size_t PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>::DEFAULT_CHUNK_SIZE_BYTES;
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
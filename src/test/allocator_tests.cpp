@@ -4,6 +4,7 @@
 
 #include <util/system.h>
 
+#include <support/allocators/pool.h>
 #include <support/allocators/secure.h>
 #include <test/test_bitcoin.h>
 
@@ -233,4 +234,33 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     BOOST_CHECK(pool.stats().used == initial.used);
 }
 
+BOOST_AUTO_TEST_CASE(pool_resource_tests)
+{
+    PoolResource<64, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+
+    // Blocks are rounded up to multiples of 8 bytes and carved from the chunk.
+    void* a = resource.Allocate(20, 8);
+    void* b = resource.Allocate(24, 8);
+    BOOST_CHECK_EQUAL(static_cast<char*>(b) - static_cast<char*>(a), 24);
+
+    // A freed block is reused for the next allocation of the same rounded size only.
+    resource.Deallocate(a, 20, 8);
+    void* c = resource.Allocate(32, 8);
+    BOOST_CHECK(c != a);
+    BOOST_CHECK(resource.Allocate(17, 8) == a);
+
+    // Too large or too strictly aligned requests bypass the pool.
+    void* big = resource.Allocate(65, 8);
+    void* aligned = resource.Allocate(16, 16);
+    resource.Deallocate(big, 65, 8);
+    resource.Deallocate(aligned, 16, 16);
+
+    // Exhausting a chunk allocates another one.
+    for (int i = 0; i < 1024 / 64 + 1; ++i) {
+        resource.Allocate(64, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -303,6 +303,41 @@ BOOST_AUTO_TEST_CASE(test_CheckQueue_UniqueCheck)
 }
 
 
+// Test that all checks run exactly once when there are more threads than
+// queues, so that workers share a queue, and when work is stolen a lot.
+BOOST_AUTO_TEST_CASE(test_CheckQueue_Shared_Queues)
+{
+    for (const unsigned int max_workers : {1U, 2U, 5U, DEFAULT_CHECKQUEUE_WORKERS}) {
+        UniqueCheck::results.clear();
+        auto queue = MakeUnique<Unique_Queue>(QUEUE_BATCH_SIZE, max_workers);
+        boost::thread_group tg;
+        for (auto x = 0; x < 12; ++x) {
+            tg.create_thread([&]{queue->Thread();});
+        }
+
+        size_t COUNT = 20000;
+        size_t total = COUNT;
+        {
+            CCheckQueueControl<UniqueCheck> control(queue.get());
+            while (total) {
+                // Large batches leave work for the other threads to steal.
+                size_t r = InsecureRandRange(300);
+                std::vector<UniqueCheck> vChecks;
+                for (size_t k = 0; k < r && total; k++)
+                    vChecks.emplace_back(--total);
+                control.Add(vChecks);
+            }
+        }
+        BOOST_REQUIRE_EQUAL(UniqueCheck::results.size(), COUNT);
+        bool r = true;
+        for (size_t i = 0; i < COUNT; ++i)
+            r = r && UniqueCheck::results.count(i) == 1;
+        BOOST_REQUIRE(r);
+        tg.interrupt_all();
+        tg.join_all();
+    }
+}
+
 // Test that blocks which might allocate lots of memory free their memory aggressively.
 //
 // This test attempts to catch a pathological case where by lazily freeing
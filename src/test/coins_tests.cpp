@@ -3,11 +3,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <coins.h>
+#include <key.h>
 #include <script/standard.h>
 #include <uint256.h>
 #include <undo.h>
 #include <util/strencodings.h>
 #include <test/test_bitcoin.h>
+#include <txdb.h>
 #include <validation.h>
 #include <consensus/validation.h>
 
@@ -57,7 +59,7 @@ public:
         for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); ) {
             if (it->second.flags & CCoinsCacheEntry::DIRTY) {
                 // Same optimization used in CCoinsViewDB is to only write dirty entries.
-                map_[it->first] = it->second.coin;
+                map_[it->first] = it->second.coin.Expand();
                 if (it->second.coin.IsSpent() && InsecureRandRange(3) == 0) {
                     // Randomly delete empty entries on write.
                     map_.erase(it->first);
@@ -525,6 +527,51 @@ BOOST_AUTO_TEST_CASE(ccoins_serialization)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_compressed)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const CPubKey pubkey = key.GetPubKey();
+    // Scripts that are stored inline, and some that are not.
+    const std::vector<std::pair<CScript, bool>> scripts{
+        {GetScriptForDestination(pubkey.GetID()), true},
+        {GetScriptForDestination(CScriptID(CScript() << OP_TRUE)), true},
+        {GetScriptForDestination(WitnessV0KeyHash(pubkey.GetID())), true},
+        {GetScriptForDestination(WitnessV0ScriptHash(CScript() << OP_TRUE)), false},
+        {GetScriptForRawPubKey(pubkey), false},
+        {CScript() << OP_RETURN << std::vector<unsigned char>(80, 0x42), false},
+        {CScript(), true},
+    };
+    for (const auto& script : scripts) {
+        for (const CAmount amount : {CAmount{0}, CAmount{546}, CAmount{123456789}, MAX_MONEY}) {
+            const Coin coin(CTxOut(amount, script.first), 550000, amount == 0);
+            const CompressedCoin compressed(coin);
+            BOOST_CHECK(!compressed.IsSpent());
+            BOOST_CHECK(compressed.Expand() == coin);
+            BOOST_CHECK_EQUAL(compressed.Expand().fCoinBase, coin.fCoinBase);
+            BOOST_CHECK_EQUAL(compressed.Expand().nHeight, coin.nHeight);
+            if (script.second) BOOST_CHECK_EQUAL(compressed.DynamicMemoryUsage(), 0U);
+
+            // Both serialize to the same bytes.
+            CDataStream ss_coin(SER_DISK, CLIENT_VERSION);
+            CDataStream ss_compressed(SER_DISK, CLIENT_VERSION);
+            ss_coin << coin;
+            ss_compressed << compressed;
+            BOOST_CHECK_EQUAL(HexStr(ss_coin.begin(), ss_coin.end()), HexStr(ss_compressed.begin(), ss_compressed.end()));
+        }
+    }
+
+    // Scripts that do not fit inline are accounted for.
+    BOOST_CHECK(CompressedCoin(Coin(CTxOut(1, scripts[5].first), 1, false)).DynamicMemoryUsage() > 0);
+
+    CompressedCoin compressed(Coin(CTxOut(1, scripts[0].first), 1, false));
+    compressed.Clear();
+    BOOST_CHECK(compressed.IsSpent());
+    BOOST_CHECK(compressed.Expand().IsSpent());
+    compressed.Compress(Coin());
+    BOOST_CHECK(compressed.IsSpent());
+}
+
 const static COutPoint OUTPOINT;
 const static CAmount PRUNED = -1;
 const static CAmount ABSENT = -2;
@@ -559,9 +606,10 @@ static size_t InsertCoinsMapEntry(CCoinsMap& map, CAmount value, char flags)
         return 0;
     }
     assert(flags != NO_ENTRY);
-    CCoinsCacheEntry entry;
+    Coin coin;
+    SetCoinsValue(value, coin);
+    CCoinsCacheEntry entry(coin);
     entry.flags = flags;
-    SetCoinsValue(value, entry.coin);
     auto inserted = map.emplace(OUTPOINT, std::move(entry));
     assert(inserted.second);
     return inserted.first->second.coin.DynamicMemoryUsage();
@@ -577,7 +625,7 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
         if (it->second.coin.IsSpent()) {
             value = PRUNED;
         } else {
-            value = it->second.coin.out.nValue;
+            value = it->second.coin.Expand().out.nValue;
         }
         flags = it->second.flags;
         assert(flags != NO_ENTRY);
@@ -586,7 +634,8 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
 
 void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
-    CCoinsMap map;
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map(&resource);
     InsertCoinsMapEntry(map, value, flags);
     view.BatchWrite(map, {});
 }
@@ -855,4 +904,276 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_prefetch)
+{
+    CCoinsViewTest base;
+    std::vector<COutPoint> present, absent;
+    {
+        CCoinsViewCacheTest init(&base);
+        for (int i = 0; i < 100; ++i) {
+            COutPoint outpoint(InsecureRand256(), InsecureRandRange(10));
+            Coin coin;
+            SetCoinsValue(i + 1, coin);
+            init.AddCoin(outpoint, std::move(coin), false);
+            present.push_back(outpoint);
+            absent.emplace_back(InsecureRand256(), 0);
+        }
+        BOOST_CHECK(init.Flush());
+    }
+
+    CCoinsViewCacheTest cache(&base);
+    // Some coins are already cached before the prefetch.
+    for (int i = 0; i < 10; ++i) {
+        BOOST_CHECK(!cache.AccessCoin(present[i]).IsSpent());
+    }
+    std::vector<COutPoint> request(present);
+    request.insert(request.end(), absent.begin(), absent.end());
+    cache.Prefetch(request);
+
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), present.size());
+    for (const COutPoint& outpoint : present) {
+        BOOST_CHECK(cache.HaveCoinInCache(outpoint));
+        // The batch hashes must match the map's own, as Prefetch probes with them.
+        const COutPoint* id = &outpoint;
+        size_t hash;
+        cache.map().hash_function().HashMany(&id, &hash, 1);
+        BOOST_CHECK_EQUAL(hash, cache.map().hash_function()(outpoint));
+        BOOST_CHECK(cache.map().find(outpoint, hash) != cache.map().end());
+    }
+    for (const COutPoint& outpoint : absent) {
+        BOOST_CHECK(!cache.HaveCoinInCache(outpoint));
+    }
+    cache.SelfTest();
+
+    // Prefetching cached coins again is a no-op.
+    cache.Prefetch(present);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), present.size());
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_sync)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    cache.SetBestBlock(InsecureRand256());
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 20; ++i) {
+        outpoints.emplace_back(InsecureRand256(), 0);
+        Coin coin;
+        SetCoinsValue(i + 1, coin);
+        cache.AddCoin(outpoints.back(), std::move(coin), false);
+    }
+    BOOST_CHECK(cache.Sync());
+    // Spend half of the coins, then sync again.
+    for (int i = 0; i < 10; ++i) {
+        BOOST_CHECK(cache.SpendCoin(outpoints[i]));
+    }
+    BOOST_CHECK(cache.Sync());
+    cache.SelfTest();
+
+    // Spent coins are dropped, unspent ones stay cached but clean.
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 10U);
+    for (int i = 0; i < 20; ++i) {
+        BOOST_CHECK_EQUAL(cache.HaveCoinInCache(outpoints[i]), i >= 10);
+        // CCoinsViewTest may keep spent entries, and randomly reports them as present.
+        Coin coin;
+        BOOST_CHECK_EQUAL(base.GetCoin(outpoints[i], coin) && !coin.IsSpent(), i >= 10);
+    }
+    for (const auto& entry : cache.map()) {
+        BOOST_CHECK_EQUAL(entry.second.flags, 0);
+    }
+    BOOST_CHECK(base.GetBestBlock() == cache.GetBestBlock());
+
+    // Clean coins can be uncached now, and are found in the base again.
+    cache.Uncache(outpoints[15]);
+    BOOST_CHECK(!cache.HaveCoinInCache(outpoints[15]));
+    BOOST_CHECK_EQUAL(cache.AccessCoin(outpoints[15]).out.nValue, 16);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_db_background_write)
+{
+    CCoinsViewDB db(1 << 20, true, true);
+    db.StartBackgroundWriter();
+    std::vector<COutPoint> outpoints;
+    uint256 best_block;
+    for (int round = 0; round < 10; ++round) {
+        CCoinsViewCacheTest cache(&db);
+        // Every round spends the coins of the previous one and creates new ones.
+        for (const COutPoint& outpoint : outpoints) {
+            BOOST_CHECK(cache.SpendCoin(outpoint));
+        }
+        outpoints.clear();
+        for (int i = 0; i < 100; ++i) {
+            outpoints.emplace_back(InsecureRand256(), 0);
+            Coin coin;
+            SetCoinsValue(round * 100 + i + 1, coin);
+            cache.AddCoin(outpoints.back(), std::move(coin), false);
+        }
+        best_block = InsecureRand256();
+        cache.SetBestBlock(best_block);
+        BOOST_CHECK(cache.Flush());
+
+        // Whether or not the write has completed, the view reflects it.
+        BOOST_CHECK(db.GetBestBlock() == best_block);
+        for (int i = 0; i < 100; ++i) {
+            Coin coin;
+            BOOST_CHECK(db.GetCoin(outpoints[i], coin));
+            BOOST_CHECK_EQUAL(coin.out.nValue, round * 100 + i + 1);
+        }
+    }
+    BOOST_CHECK(db.WaitForPendingWrite());
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    BOOST_CHECK_EQUAL(db.PendingWriteUsage(), 0U);
+
+    size_t count = 0;
+    std::unique_ptr<CCoinsViewCursor> cursor(db.Cursor());
+    for (; cursor->Valid(); cursor->Next()) {
+        COutPoint key;
+        BOOST_CHECK(cursor->GetKey(key));
+        BOOST_CHECK(std::find(outpoints.begin(), outpoints.end(), key) != outpoints.end());
+        ++count;
+    }
+    BOOST_CHECK_EQUAL(count, outpoints.size());
+    BOOST_CHECK(cursor->GetBestBlock() == best_block);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_db_parallel_read)
+{
+    CCoinsViewDB db(1 << 20, true, true);
+    db.StartReaderThreads(3);
+    std::vector<COutPoint> outpoints;
+    {
+        CCoinsViewCacheTest cache(&db);
+        for (int i = 0; i < 1000; ++i) {
+            outpoints.emplace_back(InsecureRand256(), i);
+            if (i % 3 == 0) continue;
+            Coin coin;
+            SetCoinsValue(i, coin);
+            cache.AddCoin(outpoints.back(), std::move(coin), false);
+        }
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+    }
+
+    // Repeat so that the reader threads serve several batches.
+    for (int round = 0; round < 10; ++round) {
+        std::vector<Coin> coins;
+        db.GetCoins(outpoints, coins);
+        BOOST_CHECK_EQUAL(coins.size(), outpoints.size());
+        for (size_t i = 0; i < outpoints.size(); ++i) {
+            BOOST_CHECK_EQUAL(coins[i].IsSpent(), i % 3 == 0);
+            if (i % 3 != 0) BOOST_CHECK_EQUAL(coins[i].out.nValue, (CAmount)i);
+        }
+    }
+
+    // A cache on top fetches all its misses through one GetCoins() call.
+    CCoinsViewCacheTest cache(&db);
+    cache.Prefetch(outpoints);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), outpoints.size() - (outpoints.size() + 2) / 3);
+    cache.SelfTest();
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_db_range_cursors)
+{
+    CCoinsViewDB db(1 << 20, true, true);
+    std::vector<COutPoint> outpoints;
+    {
+        CCoinsViewCacheTest cache(&db);
+        for (int i = 0; i < 1000; ++i) {
+            outpoints.emplace_back(InsecureRand256(), i % 3);
+            Coin coin;
+            SetCoinsValue(i + 1, coin);
+            cache.AddCoin(outpoints.back(), std::move(coin), false);
+        }
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+    }
+
+    std::vector<COutPoint> expected;
+    std::unique_ptr<CCoinsViewCursor> full(db.Cursor());
+    for (; full->Valid(); full->Next()) {
+        COutPoint key;
+        BOOST_CHECK(full->GetKey(key));
+        expected.push_back(key);
+    }
+    BOOST_CHECK_EQUAL(expected.size(), outpoints.size());
+
+    for (size_t num_ranges : {1, 2, 7, 16}) {
+        std::vector<std::unique_ptr<CCoinsViewCursor>> cursors = db.RangeCursors(num_ranges);
+        BOOST_CHECK_EQUAL(cursors.size(), num_ranges);
+
+        // Writes after the cursors were created are not seen by them.
+        {
+            CCoinsViewCacheTest cache(&db);
+            Coin coin;
+            SetCoinsValue(1, coin);
+            cache.AddCoin(COutPoint(InsecureRand256(), 0), std::move(coin), false);
+            BOOST_CHECK(cache.SpendCoin(expected.front()));
+            cache.SetBestBlock(db.GetBestBlock());
+            BOOST_CHECK(cache.Flush());
+        }
+
+        // Read in order, the ranges list the same coins as a single cursor did.
+        std::vector<COutPoint> keys;
+        for (size_t i = 0; i < cursors.size(); ++i) {
+            for (; cursors[i]->Valid(); cursors[i]->Next()) {
+                COutPoint key;
+                Coin coin;
+                BOOST_CHECK(cursors[i]->GetKey(key));
+                BOOST_CHECK(cursors[i]->GetValue(coin));
+                BOOST_CHECK(CoinsRangePrefix(key.hash) >= CoinsRangeBegin(i, num_ranges));
+                BOOST_CHECK(CoinsRangePrefix(key.hash) < CoinsRangeBegin(i + 1, num_ranges));
+                keys.push_back(key);
+            }
+        }
+        BOOST_CHECK(keys == expected);
+
+        // Start the next round from the state as written.
+        expected.clear();
+        full.reset(db.Cursor());
+        for (; full->Valid(); full->Next()) {
+            COutPoint key;
+            BOOST_CHECK(full->GetKey(key));
+            expected.push_back(key);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_import)
+{
+    CCoinsViewDB db(1 << 20, true, true);
+    std::vector<COutPoint> outpoints;
+    {
+        CCoinsViewCacheTest cache(&db);
+        for (int i = 0; i < 100; ++i) {
+            outpoints.emplace_back(InsecureRand256(), i);
+            if (i % 2 == 0) continue;
+            Coin coin;
+            SetCoinsValue(i, coin);
+            cache.AddCoin(outpoints.back(), std::move(coin), false);
+        }
+        const uint64_t writes = db.GetWriteCount();
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK(db.GetWriteCount() != writes);
+    }
+
+    // Coins read from the database elsewhere can be added to a cache on top.
+    const uint64_t writes = db.GetWriteCount();
+    std::vector<Coin> coins;
+    db.GetCoins(outpoints, coins);
+    CCoinsViewCacheTest cache(&db);
+    Coin modified;
+    SetCoinsValue(1000, modified);
+    cache.AddCoin(outpoints[1], Coin(modified), true);
+    cache.ImportCoins(outpoints, coins);
+    BOOST_CHECK_EQUAL(db.GetWriteCount(), writes);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), outpoints.size() / 2);
+    // Entries already in the cache are kept.
+    BOOST_CHECK(cache.AccessCoin(outpoints[1]).out == modified.out);
+    BOOST_CHECK_EQUAL(cache.AccessCoin(outpoints[3]).out.nValue, 3);
+    // They are not dirty, so they are not written back.
+    BOOST_CHECK_EQUAL(cache.map().find(outpoints[3])->second.flags, 0);
+    cache.SelfTest();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
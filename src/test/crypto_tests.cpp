@@ -4,6 +4,7 @@
 
 #include <crypto/aes.h>
 #include <crypto/chacha20.h>
+#include <crypto/muhash.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
@@ -11,6 +12,7 @@
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
 #include <random.h>
+#include <streams.h>
 #include <util/strencodings.h>
 #include <test/test_bitcoin.h>
 
@@ -524,6 +526,30 @@ BOOST_AUTO_TEST_CASE(chacha20_testvector)
                  "fab78c9");
 }
 
+BOOST_AUTO_TEST_CASE(chacha20_multiblock)
+{
+    // Bulk output (which may generate several blocks at once) must match the
+    // same keystream produced one block at a time, including when the block
+    // counter carries from the low into the high 32-bit word.
+    const uint256 key = InsecureRand256();
+    for (uint64_t seek : {uint64_t{0}, uint64_t{7}, uint64_t{0xfffffffd}, uint64_t{0xffffffff}}) {
+        for (size_t len : {255, 256, 257, 1000, 1024}) {
+            ChaCha20 bulk(key.begin(), 32);
+            bulk.Seek(seek);
+            std::vector<unsigned char> out_bulk(len);
+            bulk.Output(out_bulk.data(), len);
+
+            ChaCha20 single(key.begin(), 32);
+            single.Seek(seek);
+            std::vector<unsigned char> out_single(len);
+            for (size_t pos = 0; pos < len; pos += 64) {
+                single.Output(out_single.data() + pos, std::min<size_t>(64, len - pos));
+            }
+            BOOST_CHECK(out_bulk == out_single);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(countbits_tests)
 {
     FastRandomContext ctx;
@@ -562,4 +588,85 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+BOOST_AUTO_TEST_CASE(sha256_forced_implementations)
+{
+    using namespace sha256_implementation;
+    std::vector<unsigned char> in(64 * 32 + 7);
+    for (unsigned char& c : in) c = InsecureRandBits(8);
+
+    // Reference results from the portable implementation.
+    SHA256AutoDetect(STANDARD);
+    unsigned char ref_hash[CSHA256::OUTPUT_SIZE], ref_d64[32 * 32];
+    CSHA256().Write(in.data(), in.size()).Finalize(ref_hash);
+    SHA256D64(ref_d64, in.data(), 32);
+
+    for (UseImplementation use : {USE_SSE4, static_cast<UseImplementation>(USE_SSE4 | USE_AVX2), USE_SHANI, USE_NEON, USE_ARMV8, USE_ALL}) {
+        SHA256AutoDetect(use);
+        unsigned char hash[CSHA256::OUTPUT_SIZE], d64[32 * 32];
+        CSHA256().Write(in.data(), in.size()).Finalize(hash);
+        SHA256D64(d64, in.data(), 32);
+        BOOST_CHECK(memcmp(hash, ref_hash, sizeof(hash)) == 0);
+        BOOST_CHECK(memcmp(d64, ref_d64, sizeof(d64)) == 0);
+    }
+    SHA256AutoDetect();
+}
+
+static MuHash3072 FromInt(unsigned char i)
+{
+    unsigned char tmp[32] = {i, 0};
+    return MuHash3072().Insert(tmp, sizeof(tmp));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    // The same set hashes the same regardless of the order of updates.
+    for (int iter = 0; iter < 4; ++iter) {
+        uint256 res;
+        int table[4];
+        for (int i = 0; i < 4; ++i) {
+            table[i] = InsecureRandBits(3);
+        }
+        for (int order = 0; order < 4; ++order) {
+            MuHash3072 acc;
+            for (int i = 0; i < 4; ++i) {
+                int t = table[i ^ order];
+                if (t & 4) {
+                    acc /= FromInt(t & 3);
+                } else {
+                    acc *= FromInt(t & 3);
+                }
+            }
+            uint256 out;
+            acc.Finalize(out.begin());
+            if (order == 0) {
+                res = out;
+            } else {
+                BOOST_CHECK(res == out);
+            }
+        }
+    }
+
+    // Removing an element undoes inserting it, also across serialization.
+    unsigned char data[32];
+    for (unsigned char& c : data) c = InsecureRandBits(8);
+    MuHash3072 acc = FromInt(1);
+    acc.Insert(data, sizeof(data));
+    CDataStream ss(SER_DISK, 0);
+    ss << acc;
+    BOOST_CHECK_EQUAL(ss.size(), 2 * Num3072::BYTE_SIZE);
+    MuHash3072 acc2;
+    ss >> acc2;
+    acc2.Remove(data, sizeof(data));
+    uint256 out1, out2;
+    acc2.Finalize(out1.begin());
+    FromInt(1).Finalize(out2.begin());
+    BOOST_CHECK(out1 == out2);
+
+    MuHash3072 z = FromInt(0);
+    z *= FromInt(1);
+    z /= FromInt(2);
+    z.Finalize(out1.begin());
+    BOOST_CHECK_EQUAL(out1.GetHex(), "10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
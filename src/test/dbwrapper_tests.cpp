@@ -42,6 +42,37 @@ BOOST_AUTO_TEST_CASE(dbwrapper)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_profiles)
+{
+    DBTuning tuning;
+    BOOST_CHECK(!GetDBProfile("fast", tuning));
+    // The bundled LevelDB is built without Snappy, so there is no compressed profile.
+    BOOST_CHECK(!GetDBProfile("compact", tuning));
+    for (const std::string profile : {"default", "randomread", "bulkwrite"}) {
+        BOOST_CHECK(GetDBProfile(profile, tuning));
+        BOOST_CHECK_LE(tuning.block_cache_percent + 2 * tuning.write_buffer_percent, 100);
+
+        fs::path ph = SetDataDir(std::string("dbwrapper_profiles_").append(profile));
+        CDBWrapper dbw(ph, (1 << 20), true, false, false, tuning);
+        for (int i = 0; i < 1000; ++i) {
+            BOOST_CHECK(dbw.Write(std::make_pair('k', i), std::vector<unsigned char>(100, (unsigned char)i)));
+        }
+        for (int i = 0; i < 1000; ++i) {
+            std::vector<unsigned char> res;
+            BOOST_CHECK(dbw.Read(std::make_pair('k', i), res));
+            BOOST_CHECK(res == std::vector<unsigned char>(100, (unsigned char)i));
+        }
+    }
+
+    // The default profile is the tuning used when none is selected.
+    BOOST_CHECK(GetDBProfile("default", tuning));
+    BOOST_CHECK_EQUAL(tuning.bloom_bits, DBTuning().bloom_bits);
+    gArgs.ForceSetArg("-dbprofile", "chainstate:randomread");
+    BOOST_CHECK_EQUAL(GetDBTuning("chainstate").bloom_bits, 16);
+    BOOST_CHECK_EQUAL(GetDBTuning("txindex").bloom_bits, DBTuning().bloom_bits);
+    gArgs.ForceSetArg("-dbprofile", "");
+}
+
 // Test batch operations
 BOOST_AUTO_TEST_CASE(dbwrapper_batch)
 {
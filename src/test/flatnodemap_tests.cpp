@@ -0,0 +1,91 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <flatnodemap.h>
+#include <random.h>
+#include <test/test_bitcoin.h>
+
+#include <map>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(flatnodemap_tests, BasicTestingSetup)
+
+namespace {
+/** Deliberately weak hash, so that many keys share probe groups and tags. */
+struct WeakHasher {
+    size_t operator()(uint32_t key) const { return key % 1024; }
+};
+typedef FlatNodeMap<uint32_t, std::string, WeakHasher> TestMap;
+} // namespace
+
+BOOST_AUTO_TEST_CASE(flatnodemap_random)
+{
+    TestMap::ResourceType resource;
+    TestMap map(&resource);
+    std::map<uint32_t, std::string> real;
+
+    for (int i = 0; i < 100000; ++i) {
+        const uint32_t key = InsecureRandRange(4000);
+        switch (InsecureRandRange(4)) {
+        case 0:
+        case 1: {
+            // Long enough not to fit std::string's inline buffer.
+            const std::string value = std::to_string(key) + std::string(40, 'x');
+            auto ret = map.try_emplace(key, value);
+            BOOST_CHECK_EQUAL(ret.second, real.emplace(key, value).second);
+            BOOST_CHECK_EQUAL(ret.first->first, key);
+            break;
+        }
+        case 2:
+            BOOST_CHECK_EQUAL(map.erase(key), real.erase(key));
+            break;
+        case 3: {
+            auto it = map.find(key);
+            auto real_it = real.find(key);
+            BOOST_CHECK_EQUAL(it == map.end(), real_it == real.end());
+            if (real_it != real.end()) BOOST_CHECK_EQUAL(it->second, real_it->second);
+            break;
+        }
+        }
+        BOOST_CHECK_EQUAL(map.size(), real.size());
+    }
+
+    size_t count = 0;
+    for (const auto& entry : map) {
+        BOOST_CHECK_EQUAL(entry.second, real.at(entry.first));
+        ++count;
+    }
+    BOOST_CHECK_EQUAL(count, real.size());
+
+    // Erasing while iterating visits every element once.
+    for (auto it = map.begin(); it != map.end(); it = map.erase(it)) {
+        BOOST_CHECK_EQUAL(real.erase(it->first), 1U);
+    }
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(real.empty());
+}
+
+BOOST_AUTO_TEST_CASE(flatnodemap_stable_references)
+{
+    TestMap::ResourceType resource;
+    TestMap map(&resource);
+    std::string& first = map[0];
+    first = "first";
+    // Growing the index many times over must not move existing elements.
+    for (uint32_t key = 1; key < 10000; ++key) {
+        map[key] = std::to_string(key);
+    }
+    BOOST_CHECK_EQUAL(&map[0], &first);
+    BOOST_CHECK_EQUAL(first, "first");
+    BOOST_CHECK(map.find(5000, WeakHasher()(5000)) == map.find(5000));
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+    BOOST_CHECK(map.find(0) == map.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,215 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coins.h>
+#include <frozencoins.h>
+#include <test/test_bitcoin.h>
+#include <txdb.h>
+
+#include <map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+Coin MakeCoin(int height)
+{
+    CScript script;
+    script << std::vector<unsigned char>(1 + InsecureRandRange(50), height & 0xff) << OP_CHECKSIG;
+    return Coin(CTxOut(InsecureRandRange(MAX_MONEY), script), height, InsecureRandBool());
+}
+
+bool SameCoin(const Coin& a, const Coin& b)
+{
+    return a.nHeight == b.nHeight && a.fCoinBase == b.fCoinBase && a.out == b.out;
+}
+
+//! Fill db with coins created at heights 1 to 100, keeping a copy in coins.
+void FillCoins(CCoinsViewDB& db, std::map<COutPoint, Coin>& coins)
+{
+    CCoinsViewCache cache(&db);
+    for (int i = 0; i < 2000; ++i) {
+        const uint256 txid = InsecureRand256();
+        // Include vout indices whose VARINT encodings have different lengths.
+        for (uint32_t n : {0u, 1u, 200u, 20000u}) {
+            if (InsecureRandBool()) continue;
+            Coin coin = MakeCoin(1 + InsecureRandRange(100));
+            coins.emplace(COutPoint(txid, n), coin);
+            cache.AddCoin(COutPoint(txid, n), std::move(coin), false);
+        }
+    }
+    cache.SetBestBlock(InsecureRand256());
+    BOOST_CHECK(cache.Flush());
+}
+
+std::vector<COutPoint> CursorKeys(CCoinsViewCursor& cursor)
+{
+    std::vector<COutPoint> keys;
+    for (; cursor.Valid(); cursor.Next()) {
+        COutPoint key;
+        BOOST_CHECK(cursor.GetKey(key));
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(frozencoins_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(frozencoins_file)
+{
+    CCoinsViewDB db(1 << 20, true, true);
+    std::map<COutPoint, Coin> coins;
+    FillCoins(db, coins);
+
+    const fs::path path = SetDataDir("frozencoins_file") / "frozen.dat";
+    uint64_t count;
+    {
+        std::unique_ptr<CCoinsViewCursor> cursor(db.Cursor());
+        BOOST_CHECK(CCoinsViewFrozen::Write(path, *cursor, 50, count));
+    }
+    CCoinsViewFrozen frozen(path);
+    BOOST_CHECK_EQUAL(frozen.GetHeight(), 50);
+    BOOST_CHECK_EQUAL(frozen.GetCoinsCount(), count);
+    BOOST_CHECK(frozen.GetBestBlock() == db.GetBestBlock());
+
+    size_t expected_count = 0;
+    for (const auto& entry : coins) {
+        const bool is_frozen = entry.second.nHeight <= 50;
+        expected_count += is_frozen;
+        Coin coin;
+        BOOST_CHECK_EQUAL(frozen.GetCoin(entry.first, coin), is_frozen);
+        BOOST_CHECK_EQUAL(frozen.HaveCoin(entry.first), is_frozen);
+        if (is_frozen) BOOST_CHECK(SameCoin(coin, entry.second));
+        const COutPoint next(entry.first.hash, entry.first.n + 1);
+        if (!coins.count(next)) BOOST_CHECK(!frozen.HaveCoin(next));
+    }
+    BOOST_CHECK_EQUAL(count, expected_count);
+    BOOST_CHECK(!frozen.HaveCoin(COutPoint(InsecureRand256(), 0)));
+
+    // The file lists the coins in the order of the database.
+    std::vector<COutPoint> expected;
+    std::unique_ptr<CCoinsViewCursor> cursor(db.Cursor());
+    for (; cursor->Valid(); cursor->Next()) {
+        COutPoint key;
+        Coin coin;
+        BOOST_CHECK(cursor->GetKey(key) && cursor->GetValue(coin));
+        if (coin.nHeight <= 50) expected.push_back(key);
+    }
+    cursor.reset(frozen.Cursor());
+    BOOST_CHECK(CursorKeys(*cursor) == expected);
+    for (size_t i = 1; i + 1 < expected.size(); ++i) {
+        BOOST_CHECK(CoinKeyLess(expected[i - 1], expected[i]));
+    }
+
+    std::vector<COutPoint> keys;
+    for (auto& range : frozen.RangeCursors(7)) {
+        std::vector<COutPoint> range_keys = CursorKeys(*range);
+        keys.insert(keys.end(), range_keys.begin(), range_keys.end());
+    }
+    BOOST_CHECK(keys == expected);
+}
+
+BOOST_AUTO_TEST_CASE(frozencoins_db)
+{
+    // The files of the datadir's database are not touched by an in-memory one.
+    const fs::path datadir_file = SetDataDir("frozencoins_db") / "chainstate" / "frozen-5.dat";
+    fs::create_directories(datadir_file.parent_path());
+    {
+        fsbridge::ofstream file(datadir_file);
+        file << "frozen";
+    }
+    CCoinsViewDB db(1 << 20, true, true);
+    BOOST_CHECK(fs::exists(datadir_file));
+    std::map<COutPoint, Coin> coins;
+    FillCoins(db, coins);
+    std::unique_ptr<CCoinsViewCursor> cursor(db.Cursor());
+    const std::vector<COutPoint> all_keys = CursorKeys(*cursor);
+
+    BOOST_CHECK_EQUAL(db.GetFrozenHeight(), -1);
+    BOOST_CHECK(db.FreezeCoins(30));
+    BOOST_CHECK_EQUAL(db.GetFrozenHeight(), 30);
+
+    // Nothing changes from the outside.
+    for (const auto& entry : coins) {
+        Coin coin;
+        BOOST_CHECK(db.GetCoin(entry.first, coin));
+        BOOST_CHECK(SameCoin(coin, entry.second));
+    }
+    cursor.reset(db.Cursor());
+    BOOST_CHECK(CursorKeys(*cursor) == all_keys);
+
+    // Spend old and new coins, and add some.
+    std::vector<COutPoint> spent_frozen;
+    {
+        CCoinsViewCache cache(&db);
+        for (auto it = coins.begin(); it != coins.end();) {
+            if (InsecureRandRange(4) == 0) {
+                if (it->second.nHeight <= 30) spent_frozen.push_back(it->first);
+                BOOST_CHECK(cache.SpendCoin(it->first));
+                it = coins.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (int i = 0; i < 100; ++i) {
+            const COutPoint outpoint(InsecureRand256(), 0);
+            Coin coin = MakeCoin(101);
+            coins.emplace(outpoint, coin);
+            cache.AddCoin(outpoint, std::move(coin), false);
+        }
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(!spent_frozen.empty());
+
+    auto check_view = [&] {
+        for (const auto& entry : coins) {
+            Coin coin;
+            BOOST_CHECK(db.GetCoin(entry.first, coin));
+            BOOST_CHECK(SameCoin(coin, entry.second));
+        }
+        for (const COutPoint& outpoint : spent_frozen) {
+            BOOST_CHECK(!db.HaveCoin(outpoint));
+        }
+        std::unique_ptr<CCoinsViewCursor> cursor(db.Cursor());
+        std::vector<COutPoint> keys = CursorKeys(*cursor);
+        BOOST_CHECK_EQUAL(keys.size(), coins.size());
+        std::vector<COutPoint> range_keys;
+        for (auto& range : db.RangeCursors(5)) {
+            std::vector<COutPoint> part = CursorKeys(*range);
+            range_keys.insert(range_keys.end(), part.begin(), part.end());
+        }
+        BOOST_CHECK(range_keys == keys);
+        for (const COutPoint& key : keys) {
+            BOOST_CHECK(coins.count(key));
+        }
+    };
+    check_view();
+
+    // A reorganization restores one of the spent frozen coins.
+    {
+        CCoinsViewCache cache(&db);
+        const COutPoint restored = spent_frozen.back();
+        spent_frozen.pop_back();
+        Coin coin = MakeCoin(10);
+        coins.emplace(restored, coin);
+        cache.AddCoin(restored, std::move(coin), false);
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+    }
+    check_view();
+
+    // Freezing more coins takes the unspent ones of the old file along.
+    BOOST_CHECK(db.FreezeCoins(80));
+    BOOST_CHECK_EQUAL(db.GetFrozenHeight(), 80);
+    check_view();
+    BOOST_CHECK(db.EstimateSize() > 0);
+    BOOST_CHECK(fs::exists(datadir_file));
+    BOOST_CHECK(!fs::exists(datadir_file.parent_path() / "frozen-80.dat"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
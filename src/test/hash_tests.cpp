@@ -146,6 +146,44 @@ BOOST_AUTO_TEST_CASE(siphash)
         BOOST_CHECK_EQUAL(SipHashUint256(k1, k2, x), sip256.Finalize());
         BOOST_CHECK_EQUAL(SipHashUint256Extra(k1, k2, x, n), sip288.Finalize());
     }
+
+    // Check consistency between the batch and single-key versions.
+    for (size_t count = 0; count <= 9; ++count) {
+        uint64_t k1 = ctx.rand64();
+        uint64_t k2 = ctx.rand64();
+        std::vector<uint256> vals(count);
+        std::vector<const uint256*> ptrs(count);
+        std::vector<uint32_t> extras(count);
+        for (size_t i = 0; i < count; ++i) {
+            vals[i] = InsecureRand256();
+            ptrs[i] = &vals[i];
+            extras[i] = ctx.rand32();
+        }
+        std::vector<uint64_t> out(count), out_extra(count);
+        SipHashUint256Many(k1, k2, ptrs.data(), out.data(), count);
+        SipHashUint256ExtraMany(k1, k2, ptrs.data(), extras.data(), out_extra.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            BOOST_CHECK_EQUAL(out[i], SipHashUint256(k1, k2, vals[i]));
+            BOOST_CHECK_EQUAL(out_extra[i], SipHashUint256Extra(k1, k2, vals[i], extras[i]));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(hash160many)
+{
+    // Compare against one-at-a-time Hash160 for batch sizes around the
+    // internal grouping and the 4-way kernel width, including empty inputs.
+    for (size_t count = 0; count <= 37; ++count) {
+        std::vector<std::vector<unsigned char>> in(count);
+        for (size_t i = 0; i < count; ++i) {
+            in[i] = insecure_rand_ctx.randbytes(i % 5 == 0 ? (i % 3) * 33 : 33);
+        }
+        std::vector<uint160> out(count);
+        Hash160Many(out.data(), in.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            BOOST_CHECK(out[i] == Hash160(in[i]));
+        }
+    }
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -749,4 +749,164 @@ BOOST_AUTO_TEST_CASE(MempoolAncestryTests)
     BOOST_CHECK_EQUAL(descendants, 6ULL);
 }
 
+static std::vector<CTransactionRef> ClusterTxs(CTxMemPool& pool, const CTransactionRef& tx, std::vector<CFeeRate>& chunkFeeRates) EXCLUSIVE_LOCKS_REQUIRED(pool.cs)
+{
+    std::vector<CTxMemPool::txiter> linearization;
+    pool.GetClusterLinearization(*pool.GetIter(tx->GetHash()), linearization, chunkFeeRates);
+    std::vector<CTransactionRef> txs;
+    for (CTxMemPool::txiter it : linearization) {
+        txs.push_back(it->GetSharedTx());
+    }
+    return txs;
+}
+
+BOOST_AUTO_TEST_CASE(MempoolClusterTest)
+{
+    CTxMemPool pool;
+    LOCK(pool.cs);
+    TestMemPoolEntryHelper entry;
+    std::vector<CFeeRate> chunkFeeRates;
+
+    // [txa].0 <- [txb]
+    //      .1 <- [txd]
+    // [txc]
+    CTransactionRef txa = make_tx(/* output_values */ {10 * COIN, 10 * COIN});
+    CTransactionRef txb = make_tx(/* output_values */ {9 * COIN}, /* inputs */ {txa});
+    CTransactionRef txc = make_tx(/* output_values */ {8 * COIN});
+    CTransactionRef txd = make_tx(/* output_values */ {7 * COIN}, /* inputs */ {txa}, /* input_indices */ {1});
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(txa));
+    pool.addUnchecked(entry.Fee(20000LL).FromTx(txb));
+    pool.addUnchecked(entry.Fee(5000LL).FromTx(txc));
+    pool.addUnchecked(entry.Fee(100LL).FromTx(txd));
+
+    // txb pays for txa, txd comes last in a chunk of its own.
+    BOOST_CHECK(ClusterTxs(pool, txd, chunkFeeRates) == std::vector<CTransactionRef>({txa, txb, txd}));
+    BOOST_CHECK_EQUAL(chunkFeeRates.size(), 2U);
+    BOOST_CHECK(chunkFeeRates[0] == CFeeRate(21000, GetVirtualTransactionSize(*txa) + GetVirtualTransactionSize(*txb)));
+    BOOST_CHECK(chunkFeeRates[1] == CFeeRate(100, GetVirtualTransactionSize(*txd)));
+    BOOST_CHECK(ClusterTxs(pool, txc, chunkFeeRates) == std::vector<CTransactionRef>({txc}));
+
+    // The lowest feerate chunk goes first, then the end of the next lowest.
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(!pool.exists(txd->GetHash()));
+    BOOST_CHECK_EQUAL(pool.size(), 3U);
+    BOOST_CHECK(ClusterTxs(pool, txa, chunkFeeRates) == std::vector<CTransactionRef>({txa, txb}));
+    BOOST_CHECK_EQUAL(chunkFeeRates.size(), 1U);
+
+    // A transaction spending from both clusters joins them.
+    //
+    // [txa].0 <- [txb].0 <- [txe]
+    // [txc].0 <--------------/
+    CTransactionRef txe = make_tx(/* output_values */ {16 * COIN}, /* inputs */ {txb, txc});
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(txe));
+    BOOST_CHECK_EQUAL(ClusterTxs(pool, txc, chunkFeeRates).size(), 4U);
+    BOOST_CHECK(ClusterTxs(pool, txe, chunkFeeRates).back() == txe);
+
+    // Once txa is mined, only txe connects txb and txc.
+    pool.removeForBlock({txa}, 1);
+    BOOST_CHECK_EQUAL(ClusterTxs(pool, txb, chunkFeeRates).size(), 3U);
+    pool.removeRecursive(*txe);
+    BOOST_CHECK(ClusterTxs(pool, txb, chunkFeeRates) == std::vector<CTransactionRef>({txb}));
+    BOOST_CHECK(ClusterTxs(pool, txc, chunkFeeRates) == std::vector<CTransactionRef>({txc}));
+
+    // Prioritisation is taken into account.
+    pool.PrioritiseTransaction(txc->GetHash(), 100000LL);
+    ClusterTxs(pool, txc, chunkFeeRates);
+    BOOST_CHECK(chunkFeeRates[0] == CFeeRate(105000, GetVirtualTransactionSize(*txc)));
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(!pool.exists(txb->GetHash()));
+    BOOST_CHECK(pool.exists(txc->GetHash()));
+}
+
+BOOST_AUTO_TEST_CASE(MempoolClusterSplitTest)
+{
+    CTxMemPool pool;
+    LOCK(pool.cs);
+    TestMemPoolEntryHelper entry;
+    std::vector<CFeeRate> chunkFeeRates;
+
+    // [txr] <- [txp] <- [txc]
+    //           [txq] <--/
+    CTransactionRef txr = make_tx(/* output_values */ {10 * COIN});
+    CTransactionRef txp = make_tx(/* output_values */ {9 * COIN}, /* inputs */ {txr});
+    CTransactionRef txq = make_tx(/* output_values */ {11 * COIN});
+    CTransactionRef txc = make_tx(/* output_values */ {19 * COIN}, /* inputs */ {txp, txq});
+    pool.addUnchecked(entry.Fee(5000LL).FromTx(txr));
+    pool.addUnchecked(entry.Fee(5000LL).FromTx(txp));
+    pool.addUnchecked(entry.Fee(50000LL).FromTx(txq));
+    pool.addUnchecked(entry.Fee(100LL).FromTx(txc));
+    BOOST_CHECK(ClusterTxs(pool, txr, chunkFeeRates) == std::vector<CTransactionRef>({txq, txr, txp, txc}));
+
+    // Removing txp and txc, the last two transactions, leaves two clusters:
+    // txc connected txq to the others.
+    pool.removeRecursive(*txp);
+    BOOST_CHECK(ClusterTxs(pool, txr, chunkFeeRates) == std::vector<CTransactionRef>({txr}));
+    BOOST_CHECK(ClusterTxs(pool, txq, chunkFeeRates) == std::vector<CTransactionRef>({txq}));
+}
+
+BOOST_AUTO_TEST_CASE(MempoolClusterSizeTest)
+{
+    CTxMemPool pool;
+    LOCK(pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    // Each transaction spends the previous one and a new one, so no
+    // transaction has more than three ancestors or descendants, but they are
+    // all in one cluster.
+    //
+    // [tx0] <- [tx2] <- [tx4] ...
+    // [tx1] <-/         /
+    //          [tx3] <-/
+    CTransactionRef prev = make_tx(/* output_values */ {10 * COIN});
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(prev));
+    for (int i = 0; i < 20; ++i) {
+        CTransactionRef other = make_tx(/* output_values */ {10 * COIN, (CAmount)i});
+        CTransactionRef tx = make_tx(/* output_values */ {10 * COIN}, /* inputs */ {prev, other});
+        pool.addUnchecked(entry.Fee(1000LL).FromTx(other));
+        pool.addUnchecked(entry.Fee(1000LL).FromTx(tx));
+        prev = tx;
+    }
+    BOOST_CHECK_EQUAL(pool.CalculateClusterSize(CTxMemPool::setEntries()), 1U);
+    BOOST_CHECK_EQUAL(pool.CalculateClusterSize({*pool.GetIter(prev->GetHash())}), pool.size() + 1);
+
+    // Joining a separate cluster adds its transactions.
+    CTransactionRef single = make_tx(/* output_values */ {5 * COIN});
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(single));
+    BOOST_CHECK_EQUAL(pool.CalculateClusterSize({*pool.GetIter(single->GetHash())}), 2U);
+    BOOST_CHECK_EQUAL(pool.CalculateClusterSize({*pool.GetIter(prev->GetHash()), *pool.GetIter(single->GetHash())}), pool.size() + 1);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolClusterSizeAfterBlockTest)
+{
+    CTxMemPool pool;
+    LOCK(pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    // [root].0 <- [child0]
+    //       .1 <- [child1]
+    //       .2 <- [child2]
+    CTransactionRef root = make_tx(/* output_values */ {10 * COIN, 10 * COIN, 10 * COIN});
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(root));
+    std::vector<CTransactionRef> children;
+    for (uint32_t i = 0; i < 3; ++i) {
+        children.push_back(make_tx(/* output_values */ {9 * COIN}, /* inputs */ {root}, /* input_indices */ {i}));
+        pool.addUnchecked(entry.Fee(1000LL).FromTx(children.back()));
+    }
+    BOOST_CHECK_EQUAL(pool.CalculateClusterSize({*pool.GetIter(children[0]->GetHash())}), 5U);
+
+    // Once the root is mined, the children are no longer connected, although
+    // nothing has split their cluster yet.
+    std::vector<CTransactionRef> block{root};
+    pool.removeForBlock(block, 1);
+    BOOST_CHECK_EQUAL(pool.size(), 3U);
+    BOOST_CHECK_EQUAL(pool.CalculateClusterSize({*pool.GetIter(children[0]->GetHash())}), 2U);
+    BOOST_CHECK_EQUAL(pool.CalculateClusterSize({*pool.GetIter(children[0]->GetHash()), *pool.GetIter(children[1]->GetHash())}), 3U);
+
+    // A transaction joining one of them does not connect the others either.
+    CTransactionRef grandchild = make_tx(/* output_values */ {8 * COIN}, /* inputs */ {children[0]});
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(grandchild));
+    BOOST_CHECK_EQUAL(pool.CalculateClusterSize({*pool.GetIter(grandchild->GetHash())}), 3U);
+    BOOST_CHECK_EQUAL(pool.CalculateClusterSize({*pool.GetIter(children[1]->GetHash())}), 2U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
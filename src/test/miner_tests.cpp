@@ -12,6 +12,7 @@
 #include <miner.h>
 #include <policy/policy.h>
 #include <pubkey.h>
+#include <script/interpreter.h>
 #include <script/standard.h>
 #include <txmempool.h>
 #include <uint256.h>
@@ -21,6 +22,7 @@
 #include <test/test_bitcoin.h>
 
 #include <memory>
+#include <set>
 
 #include <boost/test/unit_test.hpp>
 
@@ -521,4 +523,80 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+static std::set<uint256> BlockTxids(const CBlock& block)
+{
+    std::set<uint256> txids;
+    for (size_t i = 1; i < block.vtx.size(); ++i) {
+        txids.insert(block.vtx[i]->GetHash());
+    }
+    return txids;
+}
+
+BOOST_FIXTURE_TEST_CASE(BlockTemplateCache_updates, TestChain100Setup)
+{
+    const CChainParams& chainparams = Params();
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    BlockTemplateCache cache;
+
+    auto spend = [&](const CTransactionRef& prev, CAmount value) {
+        return MakeTransactionRef(CreateSignedSpend(prev->GetHash(), value));
+    };
+    auto to_mempool = [&](const CTransactionRef& tx) {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(AcceptToMemoryPool(mempool, state, tx, nullptr /* pfMissingInputs */,
+                                       nullptr /* plTxnReplaced */, true /* bypass_limits */, 0 /* nAbsurdFee */));
+        cache.TransactionAddedToMempool(tx);
+    };
+    auto check_template = [&](size_t expected_txs) {
+        std::unique_ptr<CBlockTemplate> cached = AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey, true, &cache);
+        std::unique_ptr<CBlockTemplate> full = AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey);
+        BOOST_CHECK_EQUAL(cached->block.vtx.size(), expected_txs + 1);
+        BOOST_CHECK(BlockTxids(cached->block) == BlockTxids(full->block));
+        BOOST_CHECK(cached->block.hashPrevBlock == chainActive.Tip()->GetBlockHash());
+        return cached;
+    };
+
+    // Let the first two coinbase outputs mature.
+    CreateAndProcessBlock({}, scriptPubKey);
+    check_template(0);
+
+    // New transactions are added to the cached template, after their parents.
+    CTransactionRef parent = spend(m_coinbase_txns[0], 40 * COIN);
+    CTransactionRef child = spend(parent, 39 * COIN);
+    CTransactionRef other = spend(m_coinbase_txns[1], 40 * COIN);
+    to_mempool(parent);
+    check_template(1);
+    to_mempool(child);
+    to_mempool(other);
+    std::unique_ptr<CBlockTemplate> pblocktemplate = check_template(3);
+    BOOST_CHECK(pblocktemplate->block.vtx[1] == parent);
+
+    // Transactions that left the mempool are dropped along with their descendants.
+    {
+        LOCK(mempool.cs);
+        mempool.removeRecursive(*parent);
+    }
+    pblocktemplate = check_template(1);
+    BOOST_CHECK(pblocktemplate->block.vtx[1] == other);
+
+    // A new tip makes the cache select the transactions again.
+    CreateAndProcessBlock({}, scriptPubKey);
+    check_template(1);
+
+    // A parent that only its child paid for goes when the child leaves the
+    // mempool, as a full selection would not take it on its own.
+    CTransactionRef free_parent = spend(m_coinbase_txns[0], 50 * COIN);
+    CTransactionRef paying_child = spend(free_parent, 49 * COIN);
+    to_mempool(free_parent);
+    to_mempool(paying_child);
+    check_template(3);
+    {
+        LOCK(mempool.cs);
+        mempool.removeRecursive(*paying_child);
+    }
+    pblocktemplate = check_template(1);
+    BOOST_CHECK(pblocktemplate->block.vtx[1] == other);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
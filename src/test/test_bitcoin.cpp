@@ -8,12 +8,15 @@
 #include <consensus/consensus.h>
 #include <consensus/params.h>
 #include <consensus/validation.h>
+#include <crypto/aes.h>
 #include <crypto/sha256.h>
+#include <crypto/sha512.h>
 #include <miner.h>
 #include <net_processing.h>
 #include <pow.h>
 #include <rpc/register.h>
 #include <rpc/server.h>
+#include <script/interpreter.h>
 #include <script/sigcache.h>
 #include <streams.h>
 #include <ui_interface.h>
@@ -52,6 +55,8 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
     : m_path_root(fs::temp_directory_path() / "test_bitcoin" / strprintf("%lu_%i", (unsigned long)GetTime(), (int)(InsecureRandRange(1 << 30))))
 {
     SHA256AutoDetect();
+    SHA512AutoDetect();
+    AESAutoDetect();
     RandomInit();
     ECC_Start();
     SetupEnvironment();
@@ -174,6 +179,27 @@ TestChain100Setup::CreateAndProcessBlock(const std::vector<CMutableTransaction>&
     return result;
 }
 
+CMutableTransaction TestChain100Setup::CreateSignedSpend(const uint256& txid, CAmount value)
+{
+    CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction tx;
+    tx.nVersion = 1;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(txid, 0);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = value;
+    tx.vout[0].scriptPubKey = scriptPubKey;
+
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    if (!coinbaseKey.Sign(hash, vchSig)) {
+        throw std::runtime_error("CreateSignedSpend: signing failed");
+    }
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig << vchSig;
+    return tx;
+}
+
 TestChain100Setup::~TestChain100Setup()
 {
 }
@@ -91,6 +91,12 @@ struct TestChain100Setup : public TestingSetup {
     CBlock CreateAndProcessBlock(const std::vector<CMutableTransaction>& txns,
                                  const CScript& scriptPubKey);
 
+    // Create a transaction spending output 0 of txid, which must pay to
+    // coinbaseKey like the coinbase transactions do, to an output of value
+    // paying to coinbaseKey again. The output of m_coinbase_txns[i] can be
+    // spent once the chain has COINBASE_MATURITY + i blocks.
+    CMutableTransaction CreateSignedSpend(const uint256& txid, CAmount value);
+
     ~TestChain100Setup();
 
     std::vector<CTransactionRef> m_coinbase_txns; // For convenience, coinbase transactions
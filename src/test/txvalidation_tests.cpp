@@ -58,4 +58,35 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_reject_coinbase, TestChain100Setup)
     BOOST_CHECK_EQUAL(nDoS, 100);
 }
 
+/**
+ * Ensure that the mempool won't accept transactions that make a cluster too large.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_reject_large_cluster, TestChain100Setup)
+{
+    gArgs.ForceSetArg("-limitclustercount", "2");
+    CMutableTransaction parent = CreateSignedSpend(m_coinbase_txns[0]->GetHash(), 49 * COIN);
+    CMutableTransaction child = CreateSignedSpend(parent.GetHash(), 48 * COIN);
+    CMutableTransaction grandchild = CreateSignedSpend(child.GetHash(), 47 * COIN);
+
+    LOCK(cs_main);
+    for (const CMutableTransaction& tx : {parent, child}) {
+        CValidationState state;
+        BOOST_CHECK(AcceptToMemoryPool(mempool, state, MakeTransactionRef(tx),
+                nullptr /* pfMissingInputs */,
+                nullptr /* plTxnReplaced */,
+                true /* bypass_limits */,
+                0 /* nAbsurdFee */));
+    }
+
+    CValidationState state;
+    BOOST_CHECK(!AcceptToMemoryPool(mempool, state, MakeTransactionRef(grandchild),
+            nullptr /* pfMissingInputs */,
+            nullptr /* plTxnReplaced */,
+            true /* bypass_limits */,
+            0 /* nAbsurdFee */));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "too-large-mempool-cluster");
+    BOOST_CHECK_EQUAL(mempool.size(), 2U);
+    gArgs.ForceSetArg("-limitclustercount", std::to_string(DEFAULT_CLUSTER_LIMIT));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -19,7 +19,7 @@
 
 #include <boost/test/unit_test.hpp>
 
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks);
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks, const std::vector<Coin>* spent_coins = nullptr);
 
 BOOST_AUTO_TEST_SUITE(tx_validationcache_tests)
 
@@ -91,6 +91,33 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain100Setup)
     BOOST_CHECK_EQUAL(mempool.size(), 0U);
 }
 
+BOOST_FIXTURE_TEST_CASE(block_dependent_txs, TestChain100Setup)
+{
+    // ConnectBlock checks the inputs of transactions that only spend older
+    // coins in parallel. Make sure transactions spending outputs of the same
+    // block are still checked against the outputs created before them.
+
+    CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    // Let the first two coinbase outputs mature.
+    CreateAndProcessBlock({}, scriptPubKey);
+
+    CMutableTransaction parent = CreateSignedSpend(m_coinbase_txns[0]->GetHash(), 11*CENT);
+    CMutableTransaction child = CreateSignedSpend(parent.GetHash(), 10*CENT);
+    CMutableTransaction other = CreateSignedSpend(m_coinbase_txns[1]->GetHash(), 11*CENT);
+
+    // The child can't come before its parent.
+    CBlock block = CreateAndProcessBlock({child, other, parent}, scriptPubKey);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() != block.GetHash());
+
+    // Nor spend more than its parent's output.
+    CMutableTransaction greedy = CreateSignedSpend(parent.GetHash(), 12*CENT);
+    block = CreateAndProcessBlock({parent, other, greedy}, scriptPubKey);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() != block.GetHash());
+
+    block = CreateAndProcessBlock({parent, other, child}, scriptPubKey);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+}
+
 // Run CheckInputs (using pcoinsTip) on the given transaction, for all script
 // flags.  Test that CheckInputs passes for all flags that don't overlap with
 // the failing_flags argument, but otherwise fails.
@@ -6,7 +6,9 @@
 #include <txdb.h>
 
 #include <chainparams.h>
+#include <frozencoins.h>
 #include <hash.h>
+#include <memusage.h>
 #include <random.h>
 #include <pow.h>
 #include <shutdown.h>
@@ -20,11 +22,14 @@
 
 static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
+static const char DB_FROZEN_SPENT = 'T';
+static const char DB_FROZEN_COINS = 'Z';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
+static const char DB_SNAPSHOT_LOADING = 'S';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
@@ -34,7 +39,7 @@ namespace {
 struct CoinEntry {
     COutPoint* outpoint;
     char key;
-    explicit CoinEntry(const COutPoint* ptr) : outpoint(const_cast<COutPoint*>(ptr)), key(DB_COIN)  {}
+    explicit CoinEntry(const COutPoint* ptr, char key_in = DB_COIN) : outpoint(const_cast<COutPoint*>(ptr)), key(key_in)  {}
 
     template<typename Stream>
     void Serialize(Stream &s) const {
@@ -51,21 +56,231 @@ struct CoinEntry {
     }
 };
 
+/** Description of the frozen coins file in use, kept in the coin database. */
+struct FrozenCoinsInfo {
+    int height = -1;
+    uint256 block;
+    uint64_t coins_count = 0;
+    //! Set until the coins and tombstones made redundant by the file are removed.
+    bool cleanup_pending = false;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(height);
+        READWRITE(block);
+        READWRITE(coins_count);
+        READWRITE(cleanup_pending);
+    }
+};
+
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true)
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true, GetDBTuning("chainstate"))
 {
+    if (fMemory) {
+        // An in-memory database must not touch the files of the one in the
+        // datadir, so its frozen coins go to a directory of its own.
+        m_frozen_dir = fs::temp_directory_path() / "frozencoins" / fs::unique_path();
+        m_frozen_dir_owned = true;
+        return;
+    }
+    m_frozen_dir = GetDataDir() / "chainstate";
+    FrozenCoinsInfo info;
+    if (!db.Read(DB_FROZEN_COINS, info)) {
+        // Without a database entry any frozen coins file is stale.
+        CleanUpFrozenCoins();
+        return;
+    }
+    m_frozen = MakeUnique<CCoinsViewFrozen>(GetFrozenPath(info.height));
+    if (m_frozen->GetBestBlock() != info.block || m_frozen->GetCoinsCount() != info.coins_count) {
+        throw std::runtime_error(strprintf("Frozen coins file %s does not belong to the coin database", GetFrozenPath(info.height).string()));
+    }
+    // Finish an interrupted FreezeCoins().
+    if (info.cleanup_pending && !CleanUpFrozenCoins()) {
+        throw std::runtime_error("Cannot remove the coins moved to the frozen coins file");
+    }
+}
+
+CCoinsViewDB::~CCoinsViewDB()
+{
+    {
+        LOCK(m_read_mutex);
+        m_stop_readers = true;
+    }
+    m_read_cv.notify_all();
+    for (std::thread& thread : m_reader_threads) {
+        thread.join();
+    }
+    {
+        LOCK(m_pending_mutex);
+        m_stop_writer = true;
+    }
+    m_pending_cv.notify_all();
+    if (m_writer_thread.joinable()) {
+        m_writer_thread.join();
+    }
+    if (m_frozen_dir_owned) {
+        m_frozen.reset();
+        try {
+            fs::remove_all(m_frozen_dir);
+        } catch (const fs::filesystem_error& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+    }
+}
+
+void CCoinsViewDB::StartBackgroundWriter()
+{
+    assert(!m_writer_thread.joinable());
+    m_writer_thread = std::thread(&TraceThread<std::function<void()>>, "coindbwrite",
+                                  std::bind(&CCoinsViewDB::ThreadWriteCoins, this));
+}
+
+void CCoinsViewDB::ThreadWriteCoins()
+{
+    WAIT_LOCK(m_pending_mutex, lock);
+    while (true) {
+        m_pending_cv.wait(lock, [this] { return m_stop_writer || (m_pending && !m_write_failed); });
+        // Pending writes are finished before stopping, so nothing is lost on shutdown.
+        if (!m_pending || m_write_failed) return;
+
+        std::shared_ptr<const PendingWrite> pending = m_pending;
+        bool ok = false;
+        lock.unlock();
+        try {
+            ok = WriteCoins(*pending);
+        } catch (const std::runtime_error& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        lock.lock();
+        if (ok) {
+            m_pending.reset();
+        } else {
+            // Keep serving reads from the pending write: the database does
+            // not have it. The next BatchWrite() reports the failure.
+            LogPrintf("%s: failed to write to coin database\n", __func__);
+            m_write_failed = true;
+        }
+        m_pending_cv.notify_all();
+    }
+}
+
+bool CCoinsViewDB::WaitForPendingWrite() const
+{
+    WAIT_LOCK(m_pending_mutex, lock);
+    m_pending_cv.wait(lock, [this] { return !m_pending || m_write_failed; });
+    return !m_write_failed;
+}
+
+size_t CCoinsViewDB::PendingWriteUsage() const
+{
+    LOCK(m_pending_mutex);
+    return m_pending ? m_pending->usage : 0;
 }
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
-    return db.Read(CoinEntry(&outpoint), coin);
+    {
+        LOCK(m_pending_mutex);
+        if (m_pending) {
+            auto it = m_pending->coins.find(outpoint);
+            if (it != m_pending->coins.end()) {
+                if (it->second.IsSpent()) return false;
+                coin = it->second.Expand();
+                return true;
+            }
+        }
+    }
+    if (db.Read(CoinEntry(&outpoint), coin)) return true;
+    return m_frozen && m_frozen->GetCoin(outpoint, coin) && !db.Exists(CoinEntry(&outpoint, DB_FROZEN_SPENT));
+}
+
+void CCoinsViewDB::StartReaderThreads(int num_threads)
+{
+    assert(m_reader_threads.empty());
+    for (int i = 0; i < num_threads; ++i) {
+        m_reader_threads.emplace_back(&TraceThread<std::function<void()>>, "coindbread",
+                                      std::bind(&CCoinsViewDB::ThreadReadCoins, this));
+    }
+}
+
+void CCoinsViewDB::ReadCoins(ReadBatch& batch) const
+{
+    try {
+        size_t i;
+        while (!batch.failed && (i = batch.next++) < batch.outpoints.size()) {
+            if (!GetCoin(batch.outpoints[i], batch.coins[i])) batch.coins[i].Clear();
+        }
+    } catch (const std::runtime_error& e) {
+        // Let the calling thread redo the reads, so that it sees the error itself.
+        batch.failed = true;
+    }
+}
+
+void CCoinsViewDB::ThreadReadCoins()
+{
+    WAIT_LOCK(m_read_mutex, lock);
+    uint64_t last_seq = 0;
+    while (true) {
+        m_read_cv.wait(lock, [&] { return m_stop_readers || (m_read_batch && m_read_batch_seq != last_seq); });
+        if (m_stop_readers) return;
+        last_seq = m_read_batch_seq;
+        ReadBatch* batch = m_read_batch;
+        ++m_read_active;
+        lock.unlock();
+        ReadCoins(*batch);
+        lock.lock();
+        if (--m_read_active == 0) m_read_cv.notify_all();
+    }
+}
+
+void CCoinsViewDB::GetCoins(const std::vector<COutPoint>& outpoints, std::vector<Coin>& coins) const
+{
+    // Below this many lookups, waking up the readers costs more than it saves.
+    static const size_t MIN_PARALLEL_READS = 8;
+    coins.resize(outpoints.size());
+    ReadBatch batch(outpoints, coins);
+    {
+        LOCK(m_read_mutex);
+        // Only one batch is served by the readers at a time; others read on their own.
+        if (m_reader_threads.empty() || m_read_batch || outpoints.size() < MIN_PARALLEL_READS) {
+            batch.failed = true;
+        } else {
+            m_read_batch = &batch;
+            ++m_read_batch_seq;
+        }
+    }
+    if (!batch.failed) {
+        m_read_cv.notify_all();
+        ReadCoins(batch);
+        WAIT_LOCK(m_read_mutex, lock);
+        m_read_batch = nullptr;
+        m_read_cv.wait(lock, [this] { return m_read_active == 0; });
+    }
+    if (batch.failed) {
+        CCoinsView::GetCoins(outpoints, coins);
+    }
 }
 
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
-    return db.Exists(CoinEntry(&outpoint));
+    {
+        LOCK(m_pending_mutex);
+        if (m_pending) {
+            auto it = m_pending->coins.find(outpoint);
+            if (it != m_pending->coins.end()) return !it->second.IsSpent();
+        }
+    }
+    if (db.Exists(CoinEntry(&outpoint))) return true;
+    return m_frozen && m_frozen->HaveCoin(outpoint) && !db.Exists(CoinEntry(&outpoint, DB_FROZEN_SPENT));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
+    {
+        LOCK(m_pending_mutex);
+        if (m_pending) return m_pending->best_block;
+    }
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
         return uint256();
@@ -73,6 +288,8 @@ uint256 CCoinsViewDB::GetBestBlock() const {
 }
 
 std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
+    // Head blocks describe a write that was interrupted, not one still in progress.
+    WaitForPendingWrite();
     std::vector<uint256> vhashHeadBlocks;
     if (!db.Read(DB_HEAD_BLOCKS, vhashHeadBlocks)) {
         return std::vector<uint256>();
@@ -81,18 +298,48 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    assert(!hashBlock.IsNull());
+    // Let the previous write release its memory before building this one.
+    if (!WaitForPendingWrite()) return false;
+
+    ++m_write_count;
+    auto write = std::make_shared<PendingWrite>();
+    write->best_block = hashBlock;
+    write->coins.reserve(mapCoins.size());
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); it = mapCoins.erase(it)) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            CompressedCoin& coin = write->coins[it->first];
+            coin = std::move(it->second.coin);
+            write->usage += coin.DynamicMemoryUsage();
+        }
+        write->count++;
+    }
+    write->usage += memusage::DynamicUsage(write->coins);
+
+    if (!m_writer_thread.joinable()) return WriteCoins(*write);
+
+    {
+        LOCK(m_pending_mutex);
+        m_pending = std::move(write);
+    }
+    m_pending_cv.notify_all();
+    return true;
+}
+
+bool CCoinsViewDB::WriteCoins(const PendingWrite& write) {
     CDBBatch batch(db);
-    size_t count = 0;
     size_t changed = 0;
     size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
-    assert(!hashBlock.IsNull());
+    const uint256& hashBlock = write.best_block;
 
-    uint256 old_tip = GetBestBlock();
-    if (old_tip.IsNull()) {
+    // Read the database directly: GetBestBlock() would return the write itself.
+    uint256 old_tip;
+    if (!db.Read(DB_BEST_BLOCK, old_tip)) {
+        old_tip.SetNull();
         // We may be in the middle of replaying.
-        std::vector<uint256> old_heads = GetHeadBlocks();
-        if (old_heads.size() == 2) {
+        std::vector<uint256> old_heads;
+        if (db.Read(DB_HEAD_BLOCKS, old_heads) && old_heads.size() == 2) {
             assert(old_heads[0] == hashBlock);
             old_tip = old_heads[1];
         }
@@ -105,18 +352,18 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
 
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
-        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            CoinEntry entry(&it->first);
-            if (it->second.coin.IsSpent())
-                batch.Erase(entry);
-            else
-                batch.Write(entry, it->second.coin);
-            changed++;
+    for (const auto& coin : write.coins) {
+        CoinEntry entry(&coin.first);
+        if (coin.second.IsSpent())
+            batch.Erase(entry);
+        else
+            batch.Write(entry, coin.second);
+        // Spending a frozen coin leaves a tombstone. If a reorganization
+        // restores the coin, its entry in LevelDB takes precedence.
+        if (coin.second.IsSpent() && m_frozen && m_frozen->HaveCoin(coin.first)) {
+            batch.Write(CoinEntry(&coin.first, DB_FROZEN_SPENT), uint8_t{0});
         }
-        count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        changed++;
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -137,16 +384,182 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
 
     LogPrint(BCLog::COINDB, "Writing final batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
     bool ret = db.WriteBatch(batch);
-    LogPrint(BCLog::COINDB, "Committed %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
+    LogPrint(BCLog::COINDB, "Committed %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)write.count);
     return ret;
 }
 
 size_t CCoinsViewDB::EstimateSize() const
 {
-    return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
+    return db.EstimateSize(DB_COIN, (char)(DB_COIN+1)) + (m_frozen ? m_frozen->EstimateSize() : 0);
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe) {
+fs::path CCoinsViewDB::GetFrozenPath(int height) const
+{
+    return m_frozen_dir / strprintf("frozen-%d.dat", height);
+}
+
+int CCoinsViewDB::GetFrozenHeight() const
+{
+    return m_frozen ? m_frozen->GetHeight() : -1;
+}
+
+bool CCoinsViewDB::FreezeCoins(int max_height)
+{
+    assert(max_height >= GetFrozenHeight());
+    if (!WaitForPendingWrite() || !GetHeadBlocks().empty()) return false;
+    ++m_write_count;
+
+    const fs::path path = GetFrozenPath(max_height);
+    TryCreateDirectories(path.parent_path());
+    LogPrintf("Freezing coins created up to height %d in %s\n", max_height, path.string());
+    FrozenCoinsInfo info;
+    {
+        // The new file takes over the frozen coins of the old one that are unspent.
+        std::unique_ptr<CCoinsViewCursor> cursor(Cursor());
+        if (!CCoinsViewFrozen::Write(path, *cursor, max_height, info.coins_count)) return false;
+        info.block = cursor->GetBestBlock();
+    }
+    info.height = max_height;
+    std::unique_ptr<CCoinsViewFrozen> frozen = MakeUnique<CCoinsViewFrozen>(path);
+
+    // Switch to the new file. Until the cleanup is done, the coins it shares
+    // with LevelDB are found in LevelDB first, and they are the same there.
+    info.cleanup_pending = true;
+    if (!db.Write(DB_FROZEN_COINS, info, true)) return false;
+    m_frozen = std::move(frozen);
+    LogPrintf("Froze %u coins\n", info.coins_count);
+    return CleanUpFrozenCoins();
+}
+
+bool CCoinsViewDB::CleanUpFrozenCoins()
+{
+    CDBBatch batch(db);
+    size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    size_t erased = 0;
+    auto erase = [&](const COutPoint& outpoint, char key) {
+        batch.Erase(CoinEntry(&outpoint, key));
+        ++erased;
+        if (batch.SizeEstimate() > batch_size) {
+            db.WriteBatch(batch);
+            batch.Clear();
+        }
+    };
+
+    if (m_frozen) {
+        std::unique_ptr<CDBIterator> it(db.NewIterator());
+        COutPoint outpoint;
+        CoinEntry entry(&outpoint);
+        // The tombstones are those of coins of an older file. The new file does
+        // not have those coins, except ones since restored to LevelDB, which
+        // are erased from there below.
+        for (it->Seek(DB_FROZEN_SPENT); it->Valid() && it->GetKey(entry) && entry.key == DB_FROZEN_SPENT; it->Next()) {
+            erase(outpoint, DB_FROZEN_SPENT);
+        }
+        for (it->Seek(DB_COIN); it->Valid() && it->GetKey(entry) && entry.key == DB_COIN; it->Next()) {
+            Coin coin;
+            if (!it->GetValue(coin)) return error("%s: unable to read coin", __func__);
+            if ((int)coin.nHeight <= m_frozen->GetHeight() && m_frozen->HaveCoin(outpoint)) {
+                erase(outpoint, DB_COIN);
+            }
+        }
+
+        FrozenCoinsInfo info;
+        info.height = m_frozen->GetHeight();
+        info.block = m_frozen->GetBestBlock();
+        info.coins_count = m_frozen->GetCoinsCount();
+        batch.Write(DB_FROZEN_COINS, info);
+        if (!db.WriteBatch(batch, true)) return false;
+        LogPrintf("Removed %u coins and tombstones made redundant by the frozen coins file\n", erased);
+    }
+
+    // Remove older files, and any left by an interrupted FreezeCoins().
+    const fs::path current = m_frozen ? GetFrozenPath(m_frozen->GetHeight()) : fs::path();
+    if (!fs::is_directory(m_frozen_dir)) return true;
+    try {
+        for (fs::directory_iterator it(m_frozen_dir); it != fs::directory_iterator(); ++it) {
+            const std::string name = it->path().filename().string();
+            if (name.compare(0, 7, "frozen-") == 0 && it->path() != current) {
+                fs::remove(it->path());
+            }
+        }
+    } catch (const fs::filesystem_error& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+    }
+    return true;
+}
+
+bool CCoinsViewDB::StartSnapshot(const uint256& base) {
+    assert(!base.IsNull());
+    if (!WaitForPendingWrite()) return false;
+    ++m_write_count;
+    // Without a best block the coins written from now on are not used, and
+    // if the load does not finish, the marker gets them removed.
+    return db.Write(DB_SNAPSHOT_LOADING, base, true);
+}
+
+bool CCoinsViewDB::IsLoadingSnapshot() const {
+    return db.Exists(DB_SNAPSHOT_LOADING);
+}
+
+bool CCoinsViewDB::WriteSnapshotCoins(const std::vector<std::pair<COutPoint, Coin>>& coins) {
+    assert(IsLoadingSnapshot());
+    ++m_write_count;
+
+    CDBBatch batch(db);
+    size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
+    for (const auto& coin : coins) {
+        batch.Write(CoinEntry(&coin.first), coin.second);
+        if (batch.SizeEstimate() > batch_size) {
+            LogPrint(BCLog::COINDB, "Writing partial snapshot batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
+            if (!db.WriteBatch(batch)) return false;
+            batch.Clear();
+            if (crash_simulate) {
+                static FastRandomContext rng;
+                if (rng.randrange(crash_simulate) == 0) {
+                    LogPrintf("Simulating a crash. Goodbye.\n");
+                    _Exit(0);
+                }
+            }
+        }
+    }
+    return db.WriteBatch(batch);
+}
+
+bool CCoinsViewDB::FinishSnapshot(const uint256& base) {
+    assert(!base.IsNull());
+    ++m_write_count;
+
+    CDBBatch batch(db);
+    batch.Erase(DB_SNAPSHOT_LOADING);
+    batch.Write(DB_BEST_BLOCK, base);
+    return db.WriteBatch(batch, true);
+}
+
+bool CCoinsViewDB::ClearSnapshot() {
+    if (!WaitForPendingWrite()) return false;
+    ++m_write_count;
+
+    CDBBatch batch(db);
+    size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+    COutPoint outpoint;
+    CoinEntry entry(&outpoint);
+    for (pcursor->Seek(DB_COIN); pcursor->Valid() && pcursor->GetKey(entry) && entry.key == DB_COIN; pcursor->Next()) {
+        batch.Erase(entry);
+        if (batch.SizeEstimate() > batch_size) {
+            if (!db.WriteBatch(batch)) return false;
+            batch.Clear();
+        }
+    }
+    // Only drop the marker once all coins are gone.
+    batch.Erase(DB_SNAPSHOT_LOADING);
+    if (!db.WriteBatch(batch, true)) return false;
+    db.CompactRange(DB_COIN, DB_SNAPSHOT_LOADING);
+    return true;
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe, false, GetDBTuning("blockindex")) {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -170,24 +583,82 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
-    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
+    return RangeCursors(1).at(0).release();
+}
+
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsViewDB::RangeCursors(size_t num_ranges) const
+{
+    num_ranges = std::max<size_t>(1, std::min<size_t>(num_ranges, COINS_RANGE_PREFIXES));
+    // The cursors read the database directly, so it must include any pending write.
+    WaitForPendingWrite();
+    // All cursors read from one snapshot, so together they see a single state
+    // of the database even if it is written to while they are iterated.
+    const std::shared_ptr<const leveldb::Snapshot> snapshot = db.GetSnapshot();
+    const uint256 best_block = GetBestBlock();
+    std::vector<std::unique_ptr<CCoinsViewCursor>> frozen;
+    if (m_frozen) frozen = m_frozen->RangeCursors(num_ranges);
+
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COIN);
-    // Cache key of first record
-    if (i->pcursor->Valid()) {
-        CoinEntry entry(&i->keyTmp.second);
-        i->pcursor->GetKey(entry);
-        i->keyTmp.first = entry.key;
+    CDBWrapper& mutable_db = const_cast<CDBWrapper&>(db);
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    for (size_t i = 0; i < num_ranges; ++i) {
+        std::unique_ptr<CCoinsViewDBCursor> cursor(new CCoinsViewDBCursor(snapshot, mutable_db.NewIterator(snapshot.get()), best_block, CoinsRangeBegin(i + 1, num_ranges)));
+        if (m_frozen) {
+            cursor->m_frozen = std::move(frozen[i]);
+            cursor->m_spent.reset(mutable_db.NewIterator(snapshot.get()));
+        }
+        cursor->Seek(CoinsRangeBegin(i, num_ranges));
+        cursors.push_back(std::move(cursor));
+    }
+    return cursors;
+}
+
+void CCoinsViewDBCursor::Seek(uint32_t begin)
+{
+    COutPoint start(uint256(), 0);
+    *start.hash.begin() = begin >> 8;
+    *(start.hash.begin() + 1) = begin & 0xff;
+    pcursor->Seek(CoinEntry(&start));
+    if (m_spent) m_spent->Seek(CoinEntry(&start, DB_FROZEN_SPENT));
+    CacheKey();
+    Settle();
+}
+
+void CCoinsViewDBCursor::CacheKey()
+{
+    CoinEntry entry(&keyTmp.second);
+    if (!pcursor->Valid() || !pcursor->GetKey(entry) || entry.key != DB_COIN || CoinsRangePrefix(keyTmp.second.hash) >= m_end) {
+        keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
     } else {
-        i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
+        keyTmp.first = entry.key;
+    }
+}
+
+void CCoinsViewDBCursor::Settle()
+{
+    m_current_frozen = false;
+    COutPoint frozen_key;
+    while (FrozenValid() && m_frozen->GetKey(frozen_key)) {
+        // Move to the first tombstone not before the frozen coin; both are in key order.
+        COutPoint spent;
+        CoinEntry entry(&spent);
+        while (m_spent->Valid() && m_spent->GetKey(entry) && entry.key == DB_FROZEN_SPENT && CoinKeyLess(spent, frozen_key)) {
+            m_spent->Next();
+        }
+        if (!m_spent->Valid() || !m_spent->GetKey(entry) || entry.key != DB_FROZEN_SPENT || spent != frozen_key) {
+            // A coin in LevelDB with the same key comes first and takes precedence.
+            m_current_frozen = keyTmp.first != DB_COIN || CoinKeyLess(frozen_key, keyTmp.second);
+            return;
+        }
+        m_frozen->Next();
     }
-    return i;
 }
 
 bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 {
+    if (m_current_frozen) return m_frozen->GetKey(key);
     // Return cached key
     if (keyTmp.first == DB_COIN) {
         key = keyTmp.second;
@@ -198,28 +669,35 @@ bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 
 bool CCoinsViewDBCursor::GetValue(Coin &coin) const
 {
+    if (m_current_frozen) return m_frozen->GetValue(coin);
     return pcursor->GetValue(coin);
 }
 
 unsigned int CCoinsViewDBCursor::GetValueSize() const
 {
+    if (m_current_frozen) return m_frozen->GetValueSize();
     return pcursor->GetValueSize();
 }
 
 bool CCoinsViewDBCursor::Valid() const
 {
-    return keyTmp.first == DB_COIN;
+    return keyTmp.first == DB_COIN || m_current_frozen;
 }
 
 void CCoinsViewDBCursor::Next()
 {
-    pcursor->Next();
-    CoinEntry entry(&keyTmp.second);
-    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
-        keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
+    if (m_current_frozen) {
+        m_frozen->Next();
     } else {
-        keyTmp.first = entry.key;
+        COutPoint frozen_key;
+        if (FrozenValid() && m_frozen->GetKey(frozen_key) && frozen_key == keyTmp.second) {
+            // Skip the frozen coin shadowed by the current one.
+            m_frozen->Next();
+        }
+        pcursor->Next();
+        CacheKey();
     }
+    Settle();
 }
 
 bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
@@ -10,15 +10,21 @@
 #include <dbwrapper.h>
 #include <chain.h>
 #include <primitives/block.h>
+#include <sync.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 class CBlockIndex;
 class CCoinsViewDBCursor;
+class CCoinsViewFrozen;
 class uint256;
 
 //! No need to periodic flush if at least this much space still available.
@@ -39,25 +45,149 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
-
-/** CCoinsView backed by the coin database (chainstate/) */
+//! -dbbackgroundwrite default
+static const bool DEFAULT_DB_BACKGROUND_WRITE = true;
+//! -dbreadthreads default
+static const int DEFAULT_DB_READ_THREADS = 4;
+//! Maximum number of coin database reader threads
+static const int MAX_DB_READ_THREADS = 64;
+//! -freezecoins default (blocks, 0 = off)
+static const int DEFAULT_FREEZE_COINS_DEPTH = 0;
+//! Rewrite the frozen coins file at startup once this many more blocks could be frozen.
+static const int MIN_FREEZE_ADVANCE = 2016;
+
+/**
+ * CCoinsView backed by the coin database (chainstate/)
+ *
+ * Once StartBackgroundWriter() is called, BatchWrite() only takes the dirty
+ * coins out of the given map and returns; a background thread writes them to
+ * LevelDB. Until that write has completed, reads of those coins are answered
+ * from the pending write, so the view always reflects the last BatchWrite().
+ * At most one write is in flight: BatchWrite() first waits for the previous one.
+ *
+ * With StartReaderThreads(), GetCoins() spreads its lookups over a pool of
+ * threads, so that many LevelDB reads (each possibly waiting for the disk)
+ * are outstanding at once.
+ *
+ * FreezeCoins() moves the coins created up to some height out of LevelDB into
+ * a read-only, memory-mapped CCoinsViewFrozen file. Old coins are rarely
+ * spent, and there they are no longer rewritten by every compaction. Spending
+ * a frozen coin records a tombstone for it in LevelDB; coins in LevelDB take
+ * precedence over frozen ones.
+ */
 class CCoinsViewDB final : public CCoinsView
 {
+    /** Changes handed to BatchWrite(), with spent coins standing for erasures. */
+    struct PendingWrite {
+        std::unordered_map<COutPoint, CompressedCoin, SaltedOutpointHasher> coins;
+        uint256 best_block;
+        size_t count = 0;
+        //! Dynamic memory usage of coins, see PendingWriteUsage().
+        size_t usage = 0;
+    };
+
+    mutable Mutex m_pending_mutex;
+    mutable std::condition_variable m_pending_cv;
+    //! Write not yet committed to the database, if any.
+    std::shared_ptr<const PendingWrite> m_pending GUARDED_BY(m_pending_mutex);
+    //! Set if a background write failed; the pending write is then kept forever.
+    bool m_write_failed GUARDED_BY(m_pending_mutex) = false;
+    bool m_stop_writer GUARDED_BY(m_pending_mutex) = false;
+    std::thread m_writer_thread;
+
+    //! Commit a write to the database. Must not run concurrently with itself.
+    bool WriteCoins(const PendingWrite& write);
+    void ThreadWriteCoins();
+
+    /** A GetCoins() call, worked on by the calling thread and the reader threads. */
+    struct ReadBatch {
+        const std::vector<COutPoint>& outpoints;
+        std::vector<Coin>& coins;
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};
+        ReadBatch(const std::vector<COutPoint>& outpoints_in, std::vector<Coin>& coins_in) : outpoints(outpoints_in), coins(coins_in) {}
+    };
+
+    mutable Mutex m_read_mutex;
+    mutable std::condition_variable m_read_cv;
+    //! Batch the reader threads should join, if any, and a counter identifying it.
+    mutable ReadBatch* m_read_batch GUARDED_BY(m_read_mutex) = nullptr;
+    mutable uint64_t m_read_batch_seq GUARDED_BY(m_read_mutex) = 0;
+    //! Number of reader threads currently working on m_read_batch.
+    mutable int m_read_active GUARDED_BY(m_read_mutex) = 0;
+    bool m_stop_readers GUARDED_BY(m_read_mutex) = false;
+    std::vector<std::thread> m_reader_threads;
+
+    //! Number of writes to the database started so far.
+    std::atomic<uint64_t> m_write_count{0};
+
+    void ReadCoins(ReadBatch& batch) const;
+    void ThreadReadCoins();
+
+    //! Coins created up to some height, if FreezeCoins() was used. Only
+    //! replaced by FreezeCoins(), which must not run concurrently with reads.
+    std::unique_ptr<CCoinsViewFrozen> m_frozen;
+    //! Directory of the frozen coins files, and whether it is a temporary one
+    //! to remove on destruction (for an in-memory database).
+    fs::path m_frozen_dir;
+    bool m_frozen_dir_owned = false;
+
+    //! Location of the frozen coins file for the given height.
+    fs::path GetFrozenPath(int height) const;
+    //! Remove the coins and tombstones made redundant by a new frozen coins
+    //! file, and any older file.
+    bool CleanUpFrozenCoins();
+
 protected:
     CDBWrapper db;
 public:
     explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CCoinsViewDB();
+
+    //! Move the database writes of BatchWrite() to a background thread.
+    void StartBackgroundWriter();
+    //! Wait until no write is in flight. Returns false if a background write failed.
+    bool WaitForPendingWrite() const;
+    //! Memory held by the write in flight until it is committed. It is not
+    //! part of any cache's usage, but must be counted against -dbcache.
+    size_t PendingWriteUsage() const;
+    //! Serve GetCoins() with num_threads additional threads.
+    void StartReaderThreads(int num_threads);
+    //! Changes whenever a write to the database starts. Coins read while it
+    //! stays the same are still current.
+    uint64_t GetWriteCount() const { return m_write_count; }
+
+    //! Height up to which coins are frozen, or -1 if none are.
+    int GetFrozenHeight() const;
+    //! Move the coins created up to max_height, which must not be below
+    //! GetFrozenHeight(), into a new frozen coins file. The database must not
+    //! be written to meanwhile.
+    bool FreezeCoins(int max_height);
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    void GetCoins(const std::vector<COutPoint>& outpoints, std::vector<Coin>& coins) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
+    //! Callers must prevent writes until it returns, e.g. by holding cs_main.
+    std::vector<std::unique_ptr<CCoinsViewCursor>> RangeCursors(size_t num_ranges) const override;
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+    //! Mark an empty database as being loaded from a UTXO snapshot of the chain up to base.
+    bool StartSnapshot(const uint256& base);
+    //! Whether a snapshot load was started and neither finished nor cleared.
+    bool IsLoadingSnapshot() const;
+    //! Write coins of the snapshot being loaded.
+    bool WriteSnapshotCoins(const std::vector<std::pair<COutPoint, Coin>>& coins);
+    //! Mark the database as consistent with the snapshot base block.
+    bool FinishSnapshot(const uint256& base);
+    //! Remove the coins of a snapshot load that did not finish, leaving the database empty.
+    bool ClearSnapshot();
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -74,10 +204,29 @@ public:
     void Next() override;
 
 private:
-    CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
-        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
+    CCoinsViewDBCursor(const std::shared_ptr<const leveldb::Snapshot>& snapshot, CDBIterator* pcursorIn, const uint256 &hashBlockIn, uint32_t end):
+        CCoinsViewCursor(hashBlockIn), m_snapshot(snapshot), pcursor(pcursorIn), m_end(end) {}
+
+    //! Position the cursor at the first coin whose txid prefix is at least begin.
+    void Seek(uint32_t begin);
+    //! Cache the key under the iterator, or invalidate the cursor past its range.
+    void CacheKey();
+    //! Skip spent frozen coins, and choose where the current coin comes from.
+    void Settle();
+    bool FrozenValid() const { return m_frozen && m_frozen->Valid(); }
+
+    //! Snapshot the iterator reads from, if any. Declared first so it outlives the iterator.
+    std::shared_ptr<const leveldb::Snapshot> m_snapshot;
     std::unique_ptr<CDBIterator> pcursor;
     std::pair<char, COutPoint> keyTmp;
+    //! Txid prefix (see CoinsRangePrefix()) at which the range of the cursor ends.
+    uint32_t m_end = COINS_RANGE_PREFIXES;
+    //! Frozen coins of the same range, merged with those of LevelDB, and an
+    //! iterator over the tombstones of the spent ones.
+    std::unique_ptr<CCoinsViewCursor> m_frozen;
+    std::unique_ptr<CDBIterator> m_spent;
+    //! Whether the current coin is a frozen one
+    bool m_current_frozen = false;
 
     friend class CCoinsViewDB;
 };
@@ -208,6 +208,40 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
     return true;
 }
 
+size_t CTxMemPool::CalculateClusterSize(const setEntries& setAncestors) const
+{
+    // The ancestors are all in the clusters of the parents. A clean cluster
+    // is connected, so it counts whole. A dirty one may have fallen apart
+    // since transactions left it, so only the part connected to the
+    // ancestors counts.
+    std::set<const TxCluster*> clusters;
+    setEntries visited;
+    std::vector<txiter> todo;
+    size_t nSize = 1;
+    for (txiter it : setAncestors) {
+        const TxCluster* cluster = mapLinks.find(it)->second.cluster.get();
+        if (!cluster->fDirty) {
+            if (clusters.insert(cluster).second) {
+                nSize += cluster->txs.size();
+            }
+        } else if (visited.insert(it).second) {
+            todo.push_back(it);
+        }
+    }
+    while (!todo.empty()) {
+        txiter it = todo.back();
+        todo.pop_back();
+        ++nSize;
+        const TxLinks& links = mapLinks.find(it)->second;
+        for (const setEntries* neighbours : {&links.parents, &links.children}) {
+            for (txiter neighbour : *neighbours) {
+                if (visited.insert(neighbour).second) todo.push_back(neighbour);
+            }
+        }
+    }
+    return nSize;
+}
+
 void CTxMemPool::UpdateAncestorsOf(bool add, txiter it, setEntries &setAncestors)
 {
     setEntries parentIters = GetMemPoolParents(it);
@@ -359,7 +393,11 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
     // Used by AcceptToMemoryPool(), which DOES do
     // all the appropriate checks.
     indexed_transaction_set::iterator newit = mapTx.insert(entry).first;
-    mapLinks.insert(make_pair(newit, TxLinks()));
+    TxLinks& newlinks = mapLinks.insert(make_pair(newit, TxLinks())).first->second;
+    newlinks.cluster = std::make_shared<TxCluster>();
+    newlinks.cluster->txs.push_back(newit);
+    setDirtyClusters.insert(newlinks.cluster);
+    cachedClusterUsage += ClusterUsage(*newlinks.cluster);
 
     // Update transaction for any feeDelta created by PrioritiseTransaction
     // TODO: refactor so that the fee delta is calculated before inserting
@@ -422,6 +460,30 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
     totalTxSize -= it->GetTxSize();
     cachedInnerUsage -= it->DynamicMemoryUsage();
     cachedInnerUsage -= memusage::DynamicUsage(mapLinks[it].parents) + memusage::DynamicUsage(mapLinks[it].children);
+
+    const clusterRef cluster = mapLinks[it].cluster;
+    cachedClusterUsage -= ClusterUsage(*cluster);
+    if (cluster->txs.size() == 1) {
+        if (cluster->fDirty) {
+            setDirtyClusters.erase(cluster);
+        } else {
+            setClustersByLastChunk.erase(cluster.get());
+        }
+    } else if (!cluster->fDirty && cluster->txs.back() == it) {
+        // Without its last transaction the linearization is still valid,
+        // only the chunks need to be computed again. It has no children, and
+        // RemoveStaged() marked the cluster dirty if it had more than one
+        // parent, so it did not connect other transactions.
+        setClustersByLastChunk.erase(cluster.get());
+        cluster->txs.pop_back();
+        ChunkCluster(*cluster);
+        setClustersByLastChunk.insert(cluster.get());
+        cachedClusterUsage += ClusterUsage(*cluster);
+    } else {
+        MarkClusterDirty(cluster);
+        cluster->txs.erase(std::find(cluster->txs.begin(), cluster->txs.end(), it));
+        cachedClusterUsage += ClusterUsage(*cluster);
+    }
     mapLinks.erase(it);
     mapTx.erase(it);
     nTransactionsUpdated++;
@@ -577,6 +639,9 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
 
 void CTxMemPool::_clear()
 {
+    setClustersByLastChunk.clear();
+    setDirtyClusters.clear();
+    cachedClusterUsage = 0;
     mapLinks.clear();
     mapTx.clear();
     mapNextTx.clear();
@@ -616,6 +681,8 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
 
     uint64_t checkTotal = 0;
     uint64_t innerUsage = 0;
+    uint64_t clusterUsage = 0;
+    std::set<const TxCluster*> clusters;
 
     CCoinsViewCache mempoolDuplicate(const_cast<CCoinsViewCache*>(pcoins));
     const int64_t spendheight = GetSpendHeight(mempoolDuplicate);
@@ -630,6 +697,35 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
         assert(linksiter != mapLinks.end());
         const TxLinks &links = linksiter->second;
         innerUsage += memusage::DynamicUsage(links.parents) + memusage::DynamicUsage(links.children);
+        // Check that it is in its cluster, along with its parents and before them
+        // unless the cluster changed since it was linearized.
+        const TxCluster& cluster = *links.cluster;
+        const auto cluster_pos = std::find(cluster.txs.begin(), cluster.txs.end(), it);
+        assert(cluster_pos != cluster.txs.end());
+        for (txiter parent : links.parents) {
+            assert(mapLinks.find(parent)->second.cluster == links.cluster);
+            if (!cluster.fDirty) assert(std::find(cluster.txs.begin(), cluster_pos, parent) != cluster_pos);
+        }
+        if (clusters.insert(&cluster).second) {
+            clusterUsage += ClusterUsage(cluster);
+            assert(cluster.fDirty ? setDirtyClusters.count(links.cluster) : setClustersByLastChunk.count(links.cluster.get()));
+            if (!cluster.fDirty) {
+                assert(!cluster.chunks.empty() && cluster.chunks.back().nEnd == cluster.txs.size());
+                // A linearized cluster is connected.
+                setEntries setReached{it};
+                std::vector<txiter> vToVisit{it};
+                while (!vToVisit.empty()) {
+                    const TxLinks& visit_links = mapLinks.find(vToVisit.back())->second;
+                    vToVisit.pop_back();
+                    for (const setEntries* neighbours : {&visit_links.parents, &visit_links.children}) {
+                        for (txiter neighbour : *neighbours) {
+                            if (setReached.insert(neighbour).second) vToVisit.push_back(neighbour);
+                        }
+                    }
+                }
+                assert(setReached.size() == cluster.txs.size());
+            }
+        }
         bool fDependsWait = false;
         setEntries setParentCheck;
         for (const CTxIn &txin : tx.vin) {
@@ -717,6 +813,8 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
 
     assert(totalTxSize == checkTotal);
     assert(innerUsage == cachedInnerUsage);
+    assert(clusterUsage == cachedClusterUsage);
+    assert(clusters.size() == setClustersByLastChunk.size() + setDirtyClusters.size());
 }
 
 bool CTxMemPool::CompareDepthAndScore(const uint256& hasha, const uint256& hashb)
@@ -822,6 +920,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
         txiter it = mapTx.find(hash);
         if (it != mapTx.end()) {
             mapTx.modify(it, update_fee_delta(delta));
+            MarkClusterDirty(mapLinks[it].cluster);
             // Now update all ancestors' modified fees with descendants
             setEntries setAncestors;
             uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -911,11 +1010,17 @@ bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, Coin &coin) const {
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage + memusage::DynamicUsage(setClustersByLastChunk) + memusage::DynamicUsage(setDirtyClusters) + cachedClusterUsage;
 }
 
 void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason) {
     AssertLockHeld(cs);
+    // Removing a transaction with several parents may split its cluster.
+    // Decide that now, as UpdateForRemoveFromMempool() severs the links to
+    // the parents that are removed as well.
+    for (txiter it : stage) {
+        if (mapLinks[it].parents.size() > 1) MarkClusterDirty(mapLinks[it].cluster);
+    }
     UpdateForRemoveFromMempool(stage, updateDescendants);
     for (txiter it : stage) {
         removeUnchecked(it, reason);
@@ -952,6 +1057,7 @@ void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add)
     setEntries s;
     if (add && mapLinks[entry].children.insert(child).second) {
         cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
+        MergeClusters(entry, child);
     } else if (!add && mapLinks[entry].children.erase(child)) {
         cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
     }
@@ -967,6 +1073,236 @@ void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add)
     }
 }
 
+bool CTxMemPool::CompareClusterByLastChunk::operator()(const TxCluster* a, const TxCluster* b) const
+{
+    const TxCluster::Chunk& chunk_a = a->chunks.back();
+    const TxCluster::Chunk& chunk_b = b->chunks.back();
+    double f1 = (double)chunk_a.nModFees * chunk_b.nSize;
+    double f2 = (double)chunk_b.nModFees * chunk_a.nSize;
+    if (f1 == f2) {
+        return std::less<const TxCluster*>()(a, b);
+    }
+    return f1 < f2;
+}
+
+size_t CTxMemPool::ClusterUsage(const TxCluster& cluster)
+{
+    return memusage::MallocUsage(sizeof(TxCluster)) + memusage::DynamicUsage(cluster.txs) + memusage::DynamicUsage(cluster.chunks);
+}
+
+void CTxMemPool::MarkClusterDirty(const clusterRef& cluster)
+{
+    if (cluster->fDirty) return;
+    setClustersByLastChunk.erase(cluster.get());
+    cluster->fDirty = true;
+    setDirtyClusters.insert(cluster);
+}
+
+void CTxMemPool::MergeClusters(txiter a, txiter b)
+{
+    clusterRef into = mapLinks[a].cluster;
+    clusterRef from = mapLinks[b].cluster;
+    if (into == from) return;
+    if (into->txs.size() < from->txs.size()) std::swap(into, from);
+    MarkClusterDirty(into);
+    if (from->fDirty) {
+        setDirtyClusters.erase(from);
+    } else {
+        setClustersByLastChunk.erase(from.get());
+    }
+    cachedClusterUsage -= ClusterUsage(*into) + ClusterUsage(*from);
+    for (txiter it : from->txs) {
+        mapLinks[it].cluster = into;
+        into->txs.push_back(it);
+    }
+    cachedClusterUsage += ClusterUsage(*into);
+}
+
+void CTxMemPool::UpdateClusters()
+{
+    for (const clusterRef& cluster : setDirtyClusters) {
+        cachedClusterUsage -= ClusterUsage(*cluster);
+        std::vector<txiter> txs;
+        txs.swap(cluster->txs);
+        // Transactions may have left the cluster, so it may now consist of
+        // several connected components.
+        setEntries visited;
+        for (txiter start : txs) {
+            if (!visited.insert(start).second) continue;
+            clusterRef component = cluster->txs.empty() ? cluster : std::make_shared<TxCluster>();
+            component->txs.push_back(start);
+            for (size_t i = 0; i < component->txs.size(); ++i) {
+                const TxLinks& links = mapLinks[component->txs[i]];
+                for (const setEntries* neighbours : {&links.parents, &links.children}) {
+                    for (txiter neighbour : *neighbours) {
+                        if (visited.insert(neighbour).second) component->txs.push_back(neighbour);
+                    }
+                }
+            }
+            for (txiter it : component->txs) {
+                mapLinks[it].cluster = component;
+            }
+            LinearizeCluster(*component);
+            component->fDirty = false;
+            setClustersByLastChunk.insert(component.get());
+            cachedClusterUsage += ClusterUsage(*component);
+        }
+    }
+    setDirtyClusters.clear();
+}
+
+// Linearize a cluster by repeatedly picking the remaining transaction whose
+// remaining ancestors have the highest feerate, the way the block assembler
+// picks packages, and adding those ancestors in a topological order that
+// prefers higher feerate transactions. Large clusters only get the
+// topological order.
+void CTxMemPool::LinearizeCluster(TxCluster& cluster) const
+{
+    std::vector<txiter>& txs = cluster.txs;
+    std::sort(txs.begin(), txs.end(), CompareIteratorByHash());
+    const size_t n = txs.size();
+    std::map<txiter, size_t, CompareIteratorByHash> positions;
+    for (size_t i = 0; i < n; ++i) {
+        positions.emplace(txs[i], i);
+    }
+    std::vector<std::vector<size_t>> parents(n), children(n);
+    for (size_t i = 0; i < n; ++i) {
+        for (txiter parent : GetMemPoolParents(txs[i])) {
+            const size_t p = positions.at(parent);
+            parents[i].push_back(p);
+            children[p].push_back(i);
+        }
+    }
+    auto higher_feerate = [&](size_t a, size_t b) {
+        double f1 = (double)txs[a]->GetModifiedFee() * txs[b]->GetTxSize();
+        double f2 = (double)txs[b]->GetModifiedFee() * txs[a]->GetTxSize();
+        return f1 > f2 || (f1 == f2 && a < b);
+    };
+
+    std::vector<size_t> order;
+    order.reserve(n);
+    std::vector<bool> added(n, false);
+    // Append the transactions i with in_set[i] in a topological order,
+    // assuming their parents outside of the set were added already.
+    auto add_in_order = [&](const std::vector<bool>& in_set) {
+        std::vector<size_t> missing(n, 0);
+        std::vector<size_t> ready;
+        for (size_t i = 0; i < n; ++i) {
+            if (!in_set[i]) continue;
+            for (size_t p : parents[i]) {
+                missing[i] += !added[p];
+            }
+            if (missing[i] == 0) ready.push_back(i);
+        }
+        auto lower_feerate = [&](size_t a, size_t b) { return higher_feerate(b, a); };
+        std::make_heap(ready.begin(), ready.end(), lower_feerate);
+        while (!ready.empty()) {
+            std::pop_heap(ready.begin(), ready.end(), lower_feerate);
+            const size_t i = ready.back();
+            ready.pop_back();
+            added[i] = true;
+            order.push_back(i);
+            for (size_t c : children[i]) {
+                if (in_set[c] && --missing[c] == 0) {
+                    ready.push_back(c);
+                    std::push_heap(ready.begin(), ready.end(), lower_feerate);
+                }
+            }
+        }
+    };
+
+    if (n > MAX_CLUSTER_LINEARIZE_SIZE) {
+        add_in_order(std::vector<bool>(n, true));
+    } else {
+        // Find all ancestors, visiting parents before their children.
+        add_in_order(std::vector<bool>(n, true));
+        std::vector<std::vector<bool>> ancestors(n, std::vector<bool>(n, false));
+        for (size_t i : order) {
+            for (size_t p : parents[i]) {
+                ancestors[i][p] = true;
+                for (size_t a = 0; a < n; ++a) {
+                    if (ancestors[p][a]) ancestors[i][a] = true;
+                }
+            }
+        }
+        order.clear();
+        added.assign(n, false);
+
+        std::vector<CAmount> nModFeesWithAncestors(n);
+        std::vector<int64_t> nSizeWithAncestors(n);
+        for (size_t i = 0; i < n; ++i) {
+            nModFeesWithAncestors[i] = txs[i]->GetModifiedFee();
+            nSizeWithAncestors[i] = txs[i]->GetTxSize();
+            for (size_t a = 0; a < n; ++a) {
+                if (!ancestors[i][a]) continue;
+                nModFeesWithAncestors[i] += txs[a]->GetModifiedFee();
+                nSizeWithAncestors[i] += txs[a]->GetTxSize();
+            }
+        }
+        while (order.size() < n) {
+            size_t best = n;
+            for (size_t i = 0; i < n; ++i) {
+                if (added[i]) continue;
+                if (best == n || (double)nModFeesWithAncestors[i] * nSizeWithAncestors[best] > (double)nModFeesWithAncestors[best] * nSizeWithAncestors[i]) {
+                    best = i;
+                }
+            }
+            std::vector<bool> in_set(n, false);
+            for (size_t a = 0; a < n; ++a) {
+                in_set[a] = !added[a] && (a == best || ancestors[best][a]);
+            }
+            const size_t nOrdered = order.size();
+            add_in_order(in_set);
+            // Take the added transactions out of their descendants' ancestor sets.
+            for (size_t j = nOrdered; j < order.size(); ++j) {
+                const size_t a = order[j];
+                for (size_t i = 0; i < n; ++i) {
+                    if (added[i] || !ancestors[i][a]) continue;
+                    nModFeesWithAncestors[i] -= txs[a]->GetModifiedFee();
+                    nSizeWithAncestors[i] -= txs[a]->GetTxSize();
+                }
+            }
+        }
+    }
+
+    std::vector<txiter> linearization;
+    linearization.reserve(n);
+    for (size_t i : order) {
+        linearization.push_back(txs[i]);
+    }
+    txs.swap(linearization);
+    ChunkCluster(cluster);
+}
+
+void CTxMemPool::ChunkCluster(TxCluster& cluster)
+{
+    // Merge each transaction into the chunks before it while it raises their feerate.
+    cluster.chunks.clear();
+    for (size_t i = 0; i < cluster.txs.size(); ++i) {
+        TxCluster::Chunk chunk{cluster.txs[i]->GetModifiedFee(), (int64_t)cluster.txs[i]->GetTxSize(), i + 1};
+        while (!cluster.chunks.empty() &&
+               (double)chunk.nModFees * cluster.chunks.back().nSize > (double)cluster.chunks.back().nModFees * chunk.nSize) {
+            chunk.nModFees += cluster.chunks.back().nModFees;
+            chunk.nSize += cluster.chunks.back().nSize;
+            cluster.chunks.pop_back();
+        }
+        cluster.chunks.push_back(chunk);
+    }
+    cluster.chunks.shrink_to_fit();
+}
+
+void CTxMemPool::GetClusterLinearization(txiter it, std::vector<txiter>& linearization, std::vector<CFeeRate>& chunkFeeRates)
+{
+    AssertLockHeld(cs);
+    UpdateClusters();
+    const TxCluster& cluster = *mapLinks[it].cluster;
+    linearization = cluster.txs;
+    chunkFeeRates.clear();
+    for (const TxCluster::Chunk& chunk : cluster.chunks) {
+        chunkFeeRates.emplace_back(chunk.nModFees, chunk.nSize);
+    }
+}
+
 const CTxMemPool::setEntries & CTxMemPool::GetMemPoolParents(txiter entry) const
 {
     assert (entry != mapTx.end());
@@ -1021,19 +1357,24 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
     unsigned nTxnRemoved = 0;
     CFeeRate maxFeeRateRemoved(0);
     while (!mapTx.empty() && DynamicMemoryUsage() > sizelimit) {
-        indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
-
-        // We set the new mempool min fee to the feerate of the removed set, plus the
+        // Evict the last transaction of the cluster that ends in the chunk
+        // with the lowest feerate. Coming last in the linearization, it has no
+        // descendants.
+        UpdateClusters();
+        const TxCluster& cluster = **setClustersByLastChunk.begin();
+        const TxCluster::Chunk& chunk = cluster.chunks.back();
+
+        // We set the new mempool min fee to the feerate of the chunk, plus the
         // "minimum reasonable fee rate" (ie some value under which we consider txn
         // to have 0 fee). This way, we don't allow txn to enter mempool with feerate
         // equal to txn which were removed with no block in between.
-        CFeeRate removed(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
+        CFeeRate removed(chunk.nModFees, chunk.nSize);
         removed += incrementalRelayFee;
         trackPackageRemoved(removed);
         maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
 
         setEntries stage;
-        CalculateDescendants(mapTx.project<0>(it), stage);
+        CalculateDescendants(cluster.txs.back(), stage);
         nTxnRemoved += stage.size();
 
         std::vector<CTransaction> txn;
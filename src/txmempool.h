@@ -33,6 +33,8 @@ extern CCriticalSection cs_main;
 
 /** Fake height value used in Coin to signify they are only in the memory pool (since 0.8) */
 static const uint32_t MEMPOOL_HEIGHT = 0x7FFFFFFF;
+/** Clusters with more transactions than this are linearized in a cheaper, topological-only way */
+static const size_t MAX_CLUSTER_LINEARIZE_SIZE = 100;
 
 struct LockPoints
 {
@@ -438,6 +440,26 @@ public:
  * CalculateMemPoolAncestors() takes configurable limits that are designed to
  * prevent these calculations from being too CPU intensive.
  *
+ * Clusters:
+ *
+ * Transactions connected through parent/child links in mapLinks share a
+ * TxCluster. Each cluster caches a linearization: an order of its
+ * transactions that is valid in a block, preferring higher feerate
+ * ancestor sets first, split into chunks of decreasing feerate. Adding a
+ * transaction merges the clusters of its parents into one, and any change
+ * to a cluster marks it dirty. Dirty clusters are split into their
+ * connected components and linearized again when needed. TrimToSize()
+ * evicts the last transaction of the cluster that ends in the lowest
+ * feerate chunk.
+ *
+ * Updating a cluster takes time at least linear in its size, so
+ * AcceptToMemoryPool() limits the connected component a new transaction
+ * joins to -limitclustercount transactions (see CalculateClusterSize()).
+ * A dirty TxCluster may hold several such components until it is split.
+ * Only a reorganization, which adds back the transactions of disconnected
+ * blocks whatever their clusters, can make a component grow beyond the
+ * limit; new transactions cannot join it until it shrinks.
+ *
  */
 class CTxMemPool
 {
@@ -504,17 +526,55 @@ public:
 private:
     typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
 
+    /** Connected transactions and their linearization, see "Clusters" above */
+    struct TxCluster {
+        struct Chunk {
+            CAmount nModFees;
+            int64_t nSize;
+            //! Index in txs just past the last transaction of the chunk
+            size_t nEnd;
+        };
+        //! The transactions, in the order of the linearization unless fDirty
+        std::vector<txiter> txs;
+        std::vector<Chunk> chunks;
+        bool fDirty = true;
+    };
+    typedef std::shared_ptr<TxCluster> clusterRef;
+
+    struct CompareClusterByLastChunk {
+        bool operator()(const TxCluster* a, const TxCluster* b) const;
+    };
+
     struct TxLinks {
         setEntries parents;
         setEntries children;
+        clusterRef cluster;
     };
 
     typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
     txlinksMap mapLinks;
 
+    //! Linearized clusters, by the feerate of their last chunk
+    std::set<TxCluster*, CompareClusterByLastChunk> setClustersByLastChunk;
+    //! Clusters that changed since they were last linearized
+    std::set<clusterRef> setDirtyClusters;
+    uint64_t cachedClusterUsage; //!< sum of dynamic memory usage of all clusters
+
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
 
+    /** Remove a cluster from setClustersByLastChunk until it is linearized again. */
+    void MarkClusterDirty(const clusterRef& cluster) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Move the transactions of the smaller of the clusters of a and b into the other one. */
+    void MergeClusters(txiter a, txiter b) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Split the dirty clusters into connected components and linearize them. */
+    void UpdateClusters() EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Order the transactions of a cluster and compute its chunks. */
+    void LinearizeCluster(TxCluster& cluster) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Compute the chunks of a cluster from the order of its transactions. */
+    static void ChunkCluster(TxCluster& cluster);
+    static size_t ClusterUsage(const TxCluster& cluster);
+
     std::vector<indexed_transaction_set::const_iterator> GetSortedDepthAndScore() const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
 public:
@@ -608,6 +668,12 @@ public:
      */
     bool CalculateMemPoolAncestors(const CTxMemPoolEntry& entry, setEntries& setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string& errString, bool fSearchForParents = true) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    /** Number of transactions in the cluster a new transaction with the given
+     *  in-mempool ancestors would form, itself included. Dirty clusters are
+     *  walked rather than counted whole, as they may have fallen apart.
+     */
+    size_t CalculateClusterSize(const setEntries& setAncestors) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     /** Populate setDescendants with all in-mempool descendants of hash.
      *  Assumes that setDescendants includes all in-mempool descendants of anything
      *  already in it.  */
@@ -630,6 +696,10 @@ public:
     /** Expire all transaction (and their dependencies) in the mempool older than time. Return the number of removed transactions. */
     int Expire(int64_t time);
 
+    /** Get the transactions of the cluster of it in the order of its
+      * linearization, and the feerates of its chunks. */
+    void GetClusterLinearization(txiter it, std::vector<txiter>& linearization, std::vector<CFeeRate>& chunkFeeRates) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     /**
      * Calculate the ancestor and descendant count for the given transaction.
      * The counts include the transaction itself.
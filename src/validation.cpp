@@ -41,8 +41,11 @@
 #include <validationinterface.h>
 #include <warnings.h>
 
+#include <algorithm>
+#include <deque>
 #include <future>
 #include <sstream>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
@@ -89,6 +92,43 @@ enum DisconnectResult
 
 class ConnectTrace;
 
+/**
+ * Blocks read from disk by a background thread, ahead of their connection.
+ * The thread also runs CheckBlock() on them, which does not depend on the
+ * chain state, and looks up the coins they spend in the coin database.
+ */
+class BlockReadAhead
+{
+public:
+    //! Blocks to read, in order, with their positions on disk.
+    BlockReadAhead(std::vector<std::pair<const CBlockIndex*, CDiskBlockPos>> to_read, const Consensus::Params& params, const CCoinsViewDB* coins_db);
+    //! Interrupts the thread and waits for it.
+    ~BlockReadAhead();
+
+    BlockReadAhead(const BlockReadAhead&) = delete;
+    BlockReadAhead& operator=(const BlockReadAhead&) = delete;
+
+    //! Wait for the thread. The results below may only be used afterwards.
+    void Join();
+
+    //! The blocks read, a prefix of those requested.
+    std::vector<std::pair<const CBlockIndex*, std::shared_ptr<const CBlock>>> m_blocks;
+    //! Coins spent by the blocks, as found in the coin database.
+    std::vector<COutPoint> m_prevouts;
+    std::vector<Coin> m_coins;
+    //! CCoinsViewDB::GetWriteCount() before the coins were looked up.
+    const uint64_t m_coins_db_writes;
+
+private:
+    const std::vector<std::pair<const CBlockIndex*, CDiskBlockPos>> m_to_read;
+    const Consensus::Params& m_params;
+    const CCoinsViewDB* const m_coins_db;
+    std::atomic<bool> m_interrupt{false};
+    std::thread m_thread;
+
+    void Run();
+};
+
 /**
  * CChainState stores and provides an API to update our local knowledge of the
  * current best chain and header tree.
@@ -150,6 +190,11 @@ private:
      */
     CCriticalSection m_cs_chainstate;
 
+    /** Blocks read by ReadAheadBlocks() that are still to be connected, in order. */
+    std::deque<std::pair<const CBlockIndex*, std::shared_ptr<const CBlock>>> m_blocks_read_ahead;
+    /** The blocks following m_blocks_read_ahead, being read in the background. */
+    std::unique_ptr<BlockReadAhead> m_block_read_ahead_job;
+
 public:
     CChain chainActive;
     BlockMap mapBlockIndex;
@@ -188,9 +233,13 @@ public:
 
     void UnloadBlockIndex();
 
+    /** Drop the blocks read ahead, and stop reading more. */
+    void StopReadAhead() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 private:
     bool ActivateBestChainStep(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexMostWork, const std::shared_ptr<const CBlock>& pblock, bool& fInvalidFound, ConnectTrace& connectTrace) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     bool ConnectTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexNew, const std::shared_ptr<const CBlock>& pblock, ConnectTrace& connectTrace, DisconnectedBlockTransactions &disconnectpool) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    std::shared_ptr<const CBlock> ReadAheadBlocks(const CChainParams& chainparams, const CBlockIndex* pindex, const CBlockIndex* pindexMostWork) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     CBlockIndex* AddToBlockIndex(const CBlockHeader& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /** Create a new block index entry for a given block hash */
@@ -308,7 +357,7 @@ enum class FlushStateMode {
 static bool FlushStateToDisk(const CChainParams& chainParams, CValidationState &state, FlushStateMode mode, int nManualPruneHeight=0);
 static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPruneHeight);
 static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight);
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks = nullptr);
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks = nullptr, const std::vector<Coin>* spent_coins = nullptr);
 static FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 
 bool CheckFinalTx(const CTransaction &tx, int flags)
@@ -524,7 +573,7 @@ static void UpdateMempoolForReorg(DisconnectedBlockTransactions &disconnectpool,
 // Used to avoid mempool polluting consensus critical paths if CCoinsViewMempool
 // were somehow broken and returning the wrong scriptPubKeys
 static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, const CTxMemPool& pool,
-                 unsigned int flags, bool cacheSigStore, PrecomputedTransactionData& txdata) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+                 unsigned int flags, bool cacheSigStore, PrecomputedTransactionData& txdata, const std::vector<Coin>& spent_coins) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     AssertLockHeld(cs_main);
 
     // pool.cs should be locked already, but go ahead and re-take the lock here
@@ -533,8 +582,9 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
     LOCK(pool.cs);
 
     assert(!tx.IsCoinBase());
-    for (const CTxIn& txin : tx.vin) {
-        const Coin& coin = view.AccessCoin(txin.prevout);
+    for (size_t i = 0; i < tx.vin.size(); ++i) {
+        const CTxIn& txin = tx.vin[i];
+        const Coin& coin = spent_coins[i];
 
         // At this point we haven't actually checked if the coins are all
         // available (or shouldn't assume we have, since CheckInputs does).
@@ -554,7 +604,7 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
         }
     }
 
-    return CheckInputs(tx, state, view, true, flags, cacheSigStore, true, txdata);
+    return CheckInputs(tx, state, view, true, flags, cacheSigStore, true, txdata, nullptr, &spent_coins);
 }
 
 static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
@@ -682,20 +732,24 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         if (!CheckSequenceLocks(pool, tx, STANDARD_LOCKTIME_VERIFY_FLAGS, &lp))
             return state.DoS(0, false, REJECT_NONSTANDARD, "non-BIP68-final");
 
+        // All inputs exist. The view stores the spent coins compressed, so
+        // expand them once for the checks below.
+        const std::vector<Coin> spent_coins = GetSpentCoins(tx, view);
+
         CAmount nFees = 0;
-        if (!Consensus::CheckTxInputs(tx, state, view, GetSpendHeight(view), nFees)) {
+        if (!Consensus::CheckTxInputs(tx, state, spent_coins, GetSpendHeight(view), nFees)) {
             return error("%s: Consensus::CheckTxInputs: %s, %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
         }
 
         // Check for non-standard pay-to-script-hash in inputs
-        if (fRequireStandard && !AreInputsStandard(tx, view))
+        if (fRequireStandard && !AreInputsStandard(tx, spent_coins))
             return state.Invalid(false, REJECT_NONSTANDARD, "bad-txns-nonstandard-inputs");
 
         // Check for non-standard witness in P2WSH
-        if (tx.HasWitness() && fRequireStandard && !IsWitnessStandard(tx, view))
+        if (tx.HasWitness() && fRequireStandard && !IsWitnessStandard(tx, spent_coins))
             return state.DoS(0, false, REJECT_NONSTANDARD, "bad-witness-nonstandard", true);
 
-        int64_t nSigOpsCost = GetTransactionSigOpCost(tx, view, STANDARD_SCRIPT_VERIFY_FLAGS);
+        int64_t nSigOpsCost = GetTransactionSigOpCost(tx, spent_coins, STANDARD_SCRIPT_VERIFY_FLAGS);
 
         // nModifiedFees includes any fee deltas from PrioritiseTransaction
         CAmount nModifiedFees = nFees;
@@ -704,8 +758,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         // Keep track of transactions that spend a coinbase, which we re-scan
         // during reorgs to ensure COINBASE_MATURITY is still met.
         bool fSpendsCoinbase = false;
-        for (const CTxIn &txin : tx.vin) {
-            const Coin &coin = view.AccessCoin(txin.prevout);
+        for (const Coin& coin : spent_coins) {
             if (coin.IsCoinBase()) {
                 fSpendsCoinbase = true;
                 break;
@@ -750,6 +803,14 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         if (!pool.CalculateMemPoolAncestors(entry, setAncestors, nLimitAncestors, nLimitAncestorSize, nLimitDescendants, nLimitDescendantSize, errString)) {
             return state.DoS(0, false, REJECT_NONSTANDARD, "too-long-mempool-chain", false, errString);
         }
+        // The ancestor and descendant limits do not bound clusters: each
+        // transaction spending two others can join clusters indefinitely.
+        const size_t nClusterSize = pool.CalculateClusterSize(setAncestors);
+        const size_t nLimitCluster = gArgs.GetArg("-limitclustercount", DEFAULT_CLUSTER_LIMIT);
+        if (nClusterSize > nLimitCluster) {
+            return state.DoS(0, false, REJECT_NONSTANDARD, "too-large-mempool-cluster", false,
+                strprintf("cluster of %u transactions exceeds limit of %u", nClusterSize, nLimitCluster));
+        }
 
         // A transaction that spends outputs that would be replaced by it is invalid. Now
         // that we have the set of all ancestors we can detect this
@@ -890,13 +951,13 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
         PrecomputedTransactionData txdata(tx);
-        if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata)) {
+        if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata, nullptr, &spent_coins)) {
             // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
             // need to turn both off, and compare against just turning off CLEANSTACK
             // to see if the failure is specifically due to witness validation.
             CValidationState stateDummy; // Want reported failures to be from first CheckInputs
-            if (!tx.HasWitness() && CheckInputs(tx, stateDummy, view, true, scriptVerifyFlags & ~(SCRIPT_VERIFY_WITNESS | SCRIPT_VERIFY_CLEANSTACK), true, false, txdata) &&
-                !CheckInputs(tx, stateDummy, view, true, scriptVerifyFlags & ~SCRIPT_VERIFY_CLEANSTACK, true, false, txdata)) {
+            if (!tx.HasWitness() && CheckInputs(tx, stateDummy, view, true, scriptVerifyFlags & ~(SCRIPT_VERIFY_WITNESS | SCRIPT_VERIFY_CLEANSTACK), true, false, txdata, nullptr, &spent_coins) &&
+                !CheckInputs(tx, stateDummy, view, true, scriptVerifyFlags & ~SCRIPT_VERIFY_CLEANSTACK, true, false, txdata, nullptr, &spent_coins)) {
                 // Only the witness is missing, so the transaction itself may be fine.
                 state.SetCorruptionPossible();
             }
@@ -919,7 +980,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         // invalid blocks (using TestBlockValidity), however allowing such
         // transactions into the mempool can be exploited as a DoS attack.
         unsigned int currentBlockScriptVerifyFlags = GetBlockScriptFlags(chainActive.Tip(), chainparams.GetConsensus());
-        if (!CheckInputsFromMempoolAndCache(tx, state, view, pool, currentBlockScriptVerifyFlags, true, txdata)) {
+        if (!CheckInputsFromMempoolAndCache(tx, state, view, pool, currentBlockScriptVerifyFlags, true, txdata, spent_coins)) {
             return error("%s: BUG! PLEASE REPORT THIS! CheckInputs failed against latest-block but not STANDARD flags %s, %s",
                     __func__, hash.ToString(), FormatStateMessage(state));
         }
@@ -1322,6 +1383,21 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, CTxUndo &txund
     AddCoins(inputs, tx, nHeight);
 }
 
+/** Like UpdateCoins(), moving the coins spent by tx from spent_coins (see GetSpentCoins()) into txundo. */
+static void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, CTxUndo &txundo, int nHeight, std::vector<Coin>&& spent_coins)
+{
+    if (!tx.IsCoinBase()) {
+        assert(spent_coins.size() == tx.vin.size());
+        txundo.vprevout.reserve(tx.vin.size());
+        for (size_t i = 0; i < tx.vin.size(); ++i) {
+            bool is_spent = inputs.SpendCoin(tx.vin[i].prevout);
+            assert(is_spent);
+            txundo.vprevout.push_back(std::move(spent_coins[i]));
+        }
+    }
+    AddCoins(inputs, tx, nHeight);
+}
+
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight)
 {
     CTxUndo txundo;
@@ -1368,7 +1444,7 @@ void InitScriptExecutionCache() {
  *
  * Non-static (and re-declared) in src/test/txvalidationcache_tests.cpp
  */
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks, const std::vector<Coin>* spent_coins) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     if (!tx.IsCoinBase())
     {
@@ -1400,9 +1476,13 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                 return true;
             }
 
+            std::vector<Coin> coins_from_inputs;
+            if (!spent_coins) {
+                coins_from_inputs = GetSpentCoins(tx, inputs);
+                spent_coins = &coins_from_inputs;
+            }
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
-                const COutPoint &prevout = tx.vin[i].prevout;
-                const Coin& coin = inputs.AccessCoin(prevout);
+                const Coin& coin = (*spent_coins)[i];
                 assert(!coin.IsSpent());
 
                 // We very carefully only pass in things to CScriptCheck which
@@ -1480,7 +1560,9 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
-static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
+} // namespace
+
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
 {
     CDiskBlockPos pos = pindex->GetUndoPos();
     if (pos.IsNull()) {
@@ -1511,6 +1593,8 @@ static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
     return true;
 }
 
+namespace {
+
 /** Abort with a message */
 static bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
 {
@@ -1673,13 +1757,161 @@ static bool WriteUndoDataForBlock(const CBlockUndo& blockundo, CValidationState&
     return true;
 }
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+namespace {
+
+/** What a CTxInputsCheck found out about a transaction. */
+struct TxInputsResult
+{
+    //! Whether all checks passed; if not, ConnectBlock() repeats them in order to report the failure.
+    bool fOk = false;
+    CAmount nFee = 0;
+    int64_t nSigOpsCost = 0;
+    //! The coins spent by the transaction, in input order.
+    std::vector<Coin> spent_coins;
+};
+
+/**
+ * Closure representing the input checks of one transaction that does not
+ * spend outputs created earlier in its block: the amounts and maturity of the
+ * spent coins, BIP68 sequence locks and the sigop cost. These only read the
+ * view, which already holds the coins (see PrefetchBlockInputs()), so they can
+ * run in parallel while ConnectBlock() waits for them.
+ */
+class CTxInputsCheck
+{
+private:
+    const CTransaction* ptx;
+    const CCoinsViewCache* pview;
+    const CBlockIndex* pindex;
+    int nLockTimeFlags;
+    unsigned int nFlags;
+    TxInputsResult* presult;
+
+public:
+    CTxInputsCheck() : ptx(nullptr), pview(nullptr), pindex(nullptr), nLockTimeFlags(0), nFlags(0), presult(nullptr) {}
+    CTxInputsCheck(const CTransaction& tx, const CCoinsViewCache& view, const CBlockIndex& index, int nLockTimeFlagsIn, unsigned int nFlagsIn, TxInputsResult& result) :
+        ptx(&tx), pview(&view), pindex(&index), nLockTimeFlags(nLockTimeFlagsIn), nFlags(nFlagsIn), presult(&result) {}
+
+    //! Always succeeds, failures are left to ConnectBlock() to find again.
+    bool operator()()
+    {
+        const CTransaction& tx = *ptx;
+        std::vector<Coin> spent_coins(tx.vin.size());
+        std::vector<int> prevheights(tx.vin.size());
+        for (size_t i = 0; i < tx.vin.size(); ++i) {
+            if (!pview->GetCoinInCache(tx.vin[i].prevout, spent_coins[i])) return true;
+            prevheights[i] = spent_coins[i].nHeight;
+        }
+        CValidationState state;
+        CAmount nFee = 0;
+        if (!Consensus::CheckTxInputs(tx, state, spent_coins, pindex->nHeight, nFee)) return true;
+        if (!SequenceLocks(tx, nLockTimeFlags, &prevheights, *pindex)) return true;
+        presult->nFee = nFee;
+        presult->nSigOpsCost = GetTransactionSigOpCost(tx, spent_coins, nFlags);
+        presult->spent_coins = std::move(spent_coins);
+        presult->fOk = true;
+        return true;
+    }
+
+    void swap(CTxInputsCheck& check)
+    {
+        std::swap(ptx, check.ptx);
+        std::swap(pview, check.pview);
+        std::swap(pindex, check.pindex);
+        std::swap(nLockTimeFlags, check.nLockTimeFlags);
+        std::swap(nFlags, check.nFlags);
+        std::swap(presult, check.presult);
+    }
+};
+
+/**
+ * A check run by the script check threads: either the scripts of one input
+ * (CScriptCheck) or the inputs of one transaction (CTxInputsCheck).
+ */
+class CBlockCheck
+{
+private:
+    CScriptCheck m_script_check;
+    CTxInputsCheck m_inputs_check;
+    bool m_is_inputs_check;
+
+public:
+    CBlockCheck() : m_is_inputs_check(false) {}
+    explicit CBlockCheck(CScriptCheck&& check) : m_is_inputs_check(false) { m_script_check.swap(check); }
+    explicit CBlockCheck(CTxInputsCheck&& check) : m_is_inputs_check(true) { m_inputs_check.swap(check); }
+
+    bool operator()()
+    {
+        return m_is_inputs_check ? m_inputs_check() : m_script_check();
+    }
+
+    void swap(CBlockCheck& check)
+    {
+        m_script_check.swap(check.m_script_check);
+        m_inputs_check.swap(check.m_inputs_check);
+        std::swap(m_is_inputs_check, check.m_is_inputs_check);
+    }
+};
+
+} // namespace
+
+static CCheckQueue<CBlockCheck> scriptcheckqueue(128, MAX_SCRIPTCHECK_THREADS);
 
 void ThreadScriptCheck() {
     RenameThread("bitcoin-scriptch");
     scriptcheckqueue.Thread();
 }
 
+//! Hand the script checks of a transaction to the script check threads.
+static void AddScriptChecks(CCheckQueueControl<CBlockCheck>& control, std::vector<CScriptCheck>& checks)
+{
+    std::vector<CBlockCheck> block_checks;
+    block_checks.reserve(checks.size());
+    for (CScriptCheck& check : checks) {
+        block_checks.emplace_back(std::move(check));
+    }
+    control.Add(block_checks);
+}
+
+/**
+ * Check the inputs of the transactions of block that only spend coins from
+ * before the block, in parallel. The transactions that spend outputs of
+ * earlier transactions in the block depend on their UpdateCoins() and are
+ * left to ConnectBlock()'s ordered pass, as are the ones that fail.
+ */
+static void CheckIndependentTxInputs(const CBlock& block, const CCoinsViewCache& view, const CBlockIndex& index, int nLockTimeFlags, unsigned int flags, std::vector<TxInputsResult>& results)
+{
+    std::vector<uint256> txids;
+    txids.reserve(block.vtx.size());
+    for (const auto& tx : block.vtx) {
+        txids.push_back(tx->GetHash());
+    }
+    std::sort(txids.begin(), txids.end());
+
+    results.assign(block.vtx.size(), TxInputsResult());
+    CCheckQueueControl<CBlockCheck> control(&scriptcheckqueue);
+    std::vector<CBlockCheck> vChecks;
+    for (size_t i = 1; i < block.vtx.size(); ++i) {
+        const CTransaction& tx = *block.vtx[i];
+        bool fDependent = false;
+        for (const CTxIn& txin : tx.vin) {
+            if (std::binary_search(txids.begin(), txids.end(), txin.prevout.hash)) {
+                fDependent = true;
+                break;
+            }
+        }
+        if (fDependent) continue;
+        vChecks.emplace_back(CTxInputsCheck(tx, view, index, nLockTimeFlags, flags, results[i]));
+        // Hand out the checks in small batches to spread them over the workers' queues.
+        if (vChecks.size() == 16) {
+            control.Add(vChecks);
+            vChecks.clear();
+        }
+    }
+    control.Add(vChecks);
+    control.Wait();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1790,6 +2022,40 @@ static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 static int64_t nBlocksTotal = 0;
 
+/** Return the coins spent by consecutive blocks, except for outputs created
+ *  within the blocks themselves. */
+static std::vector<COutPoint> GetBlockInputs(const std::vector<const CBlock*>& blocks)
+{
+    std::vector<uint256> txids;
+    for (const CBlock* block : blocks) {
+        for (const auto& tx : block->vtx) {
+            txids.push_back(tx->GetHash());
+        }
+    }
+    std::sort(txids.begin(), txids.end());
+
+    std::vector<COutPoint> prevouts;
+    for (const CBlock* block : blocks) {
+        for (const auto& tx : block->vtx) {
+            if (tx->IsCoinBase()) continue;
+            for (const CTxIn& txin : tx->vin) {
+                if (!std::binary_search(txids.begin(), txids.end(), txin.prevout.hash)) {
+                    prevouts.push_back(txin.prevout);
+                }
+            }
+        }
+    }
+    return prevouts;
+}
+
+/** Load the coins spent by consecutive blocks into view before their
+ *  transactions are processed. Outputs created within the blocks themselves
+ *  are skipped, as they are added to the view while connecting them. */
+static void PrefetchBlockInputs(const std::vector<const CBlock*>& blocks, const CCoinsViewCache& view)
+{
+    view.Prefetch(GetBlockInputs(blocks));
+}
+
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
@@ -1971,8 +2237,6 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     CBlockUndo blockundo;
 
-    CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
-
     std::vector<int> prevheights;
     CAmount nFees = 0;
     int nInputs = 0;
@@ -1980,17 +2244,40 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
     std::vector<PrecomputedTransactionData> txdata;
     txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
+    PrefetchBlockInputs({&block}, view);
+    std::vector<TxInputsResult> txinputs(block.vtx.size());
+    if (nScriptCheckThreads) {
+        CheckIndependentTxInputs(block, view, *pindex, nLockTimeFlags, flags, txinputs);
+    }
+    // Only now, as CheckIndependentTxInputs() uses the same queue.
+    CCheckQueueControl<CBlockCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = *(block.vtx[i]);
 
         nInputs += tx.vin.size();
 
+        // The inputs checked in parallel may since have been spent by an
+        // earlier transaction of the block.
+        const bool fInputsChecked = txinputs[i].fOk && view.HaveInputs(tx);
+        // The view stores the coins compressed: expand each spent coin only
+        // once, for all of the checks below and the undo data.
+        std::vector<Coin> spent_coins;
         if (!tx.IsCoinBase())
         {
             CAmount txfee = 0;
-            if (!Consensus::CheckTxInputs(tx, state, view, pindex->nHeight, txfee)) {
-                return error("%s: Consensus::CheckTxInputs: %s, %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
+            if (fInputsChecked) {
+                txfee = txinputs[i].nFee;
+                spent_coins = std::move(txinputs[i].spent_coins);
+            } else {
+                if (!view.HaveInputs(tx)) {
+                    return state.DoS(100, error("%s: inputs missing/spent in %s", __func__, tx.GetHash().ToString()),
+                                     REJECT_INVALID, "bad-txns-inputs-missingorspent");
+                }
+                spent_coins = GetSpentCoins(tx, view);
+                if (!Consensus::CheckTxInputs(tx, state, spent_coins, pindex->nHeight, txfee)) {
+                    return error("%s: Consensus::CheckTxInputs: %s, %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
+                }
             }
             nFees += txfee;
             if (!MoneyRange(nFees)) {
@@ -2001,14 +2288,16 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             // Check that transaction is BIP68 final
             // BIP68 lock checks (as opposed to nLockTime checks) must
             // be in ConnectBlock because they require the UTXO set
-            prevheights.resize(tx.vin.size());
-            for (size_t j = 0; j < tx.vin.size(); j++) {
-                prevheights[j] = view.AccessCoin(tx.vin[j].prevout).nHeight;
-            }
+            if (!fInputsChecked) {
+                prevheights.resize(tx.vin.size());
+                for (size_t j = 0; j < tx.vin.size(); j++) {
+                    prevheights[j] = spent_coins[j].nHeight;
+                }
 
-            if (!SequenceLocks(tx, nLockTimeFlags, &prevheights, *pindex)) {
-                return state.DoS(100, error("%s: contains a non-BIP68-final transaction", __func__),
-                                 REJECT_INVALID, "bad-txns-nonfinal");
+                if (!SequenceLocks(tx, nLockTimeFlags, &prevheights, *pindex)) {
+                    return state.DoS(100, error("%s: contains a non-BIP68-final transaction", __func__),
+                                     REJECT_INVALID, "bad-txns-nonfinal");
+                }
             }
         }
 
@@ -2016,7 +2305,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         // * legacy (always)
         // * p2sh (when P2SH enabled in flags and excludes coinbase)
         // * witness (when witness enabled in flags and excludes coinbase)
-        nSigOpsCost += GetTransactionSigOpCost(tx, view, flags);
+        nSigOpsCost += fInputsChecked ? txinputs[i].nSigOpsCost : GetTransactionSigOpCost(tx, spent_coins, flags);
         if (nSigOpsCost > MAX_BLOCK_SIGOPS_COST)
             return state.DoS(100, error("ConnectBlock(): too many sigops"),
                              REJECT_INVALID, "bad-blk-sigops");
@@ -2026,17 +2315,17 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         {
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], nScriptCheckThreads ? &vChecks : nullptr))
+            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], nScriptCheckThreads ? &vChecks : nullptr, &spent_coins))
                 return error("ConnectBlock(): CheckInputs on %s failed with %s",
                     tx.GetHash().ToString(), FormatStateMessage(state));
-            control.Add(vChecks);
+            AddScriptChecks(control, vChecks);
         }
 
         CTxUndo undoDummy;
         if (i > 0) {
             blockundo.vtxundo.push_back(CTxUndo());
         }
-        UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
+        UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight, std::move(spent_coins));
     }
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint(BCLog::BENCH, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs (%.2fms/blk)]\n", (unsigned)block.vtx.size(), MILLI * (nTime3 - nTime2), MILLI * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : MILLI * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * MICRO, nTimeConnect * MILLI / nBlocksTotal);
@@ -2091,6 +2380,7 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
     LOCK(cs_main);
     static int64_t nLastWrite = 0;
     static int64_t nLastFlush = 0;
+    static bool fSyncedSinceFlush = false;
     std::set<int> setFilesToPrune;
     bool full_flush_completed = false;
     try {
@@ -2122,8 +2412,17 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             nLastFlush = nNow;
         }
         int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
-        int64_t cacheSize = pcoinsTip->DynamicMemoryUsage();
+        // A background write keeps a copy of the coins it writes until it is committed.
+        size_t nPendingWriteUsage = pcoinsdbview->PendingWriteUsage();
+        int64_t cacheSize = pcoinsTip->DynamicMemoryUsage() + nPendingWriteUsage;
         int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
+        if (mode == FlushStateMode::IF_NEEDED && cacheSize > nTotalSpace && nPendingWriteUsage > 0) {
+            // Rather than emptying the cache, wait for the write to release its copy.
+            if (!pcoinsdbview->WaitForPendingWrite()) {
+                return AbortNode(state, "Failed to write to coin database");
+            }
+            cacheSize = pcoinsTip->DynamicMemoryUsage();
+        }
         // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
         bool fCacheLarge = mode == FlushStateMode::PERIODIC && cacheSize > std::max((9 * nTotalSpace) / 10, nTotalSpace - MAX_BLOCK_COINSDB_USAGE * 1024 * 1024);
         // The cache is over the limit, we have to write now.
@@ -2132,10 +2431,14 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
         bool fPeriodicWrite = mode == FlushStateMode::PERIODIC && nNow > nLastWrite + (int64_t)DATABASE_WRITE_INTERVAL * 1000000;
         // It's been very long since we flushed the cache. Do this infrequently, to optimize cache usage.
         bool fPeriodicFlush = mode == FlushStateMode::PERIODIC && nNow > nLastFlush + (int64_t)DATABASE_FLUSH_INTERVAL * 1000000;
-        // Combine all conditions that result in a full cache flush.
-        fDoFullFlush = (mode == FlushStateMode::ALWAYS) || fCacheLarge || fCacheCritical || fPeriodicFlush || fFlushForPrune;
+        // Combine all conditions that result in a full cache flush, which empties the cache.
+        fDoFullFlush = (mode == FlushStateMode::ALWAYS) || fCacheCritical || fFlushForPrune;
+        // The cache is getting full or hasn't been written for long, but its contents are still
+        // useful: write its changes but keep it warm. When the cache is large, doing this once
+        // ahead of the critical flush leaves that flush (under cs_main, mid-block) little to write.
+        bool fDoSync = !fDoFullFlush && (fPeriodicFlush || (fCacheLarge && !fSyncedSinceFlush));
         // Write blocks and block index to disk.
-        if (fDoFullFlush || fPeriodicWrite) {
+        if (fDoFullFlush || fDoSync || fPeriodicWrite) {
             // Depend on nMinDiskSpace to ensure we can write block index
             if (!CheckDiskSpace(0, true))
                 return state.Error("out of disk space");
@@ -2159,9 +2462,14 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
                     return AbortNode(state, "Failed to write to block index database");
                 }
             }
-            // Finally remove any pruned files
-            if (fFlushForPrune)
+            // Finally remove any pruned files. A coins write still in progress may
+            // need their blocks to be replayed after a crash, so let it finish first.
+            if (fFlushForPrune) {
+                if (!pcoinsdbview->WaitForPendingWrite()) {
+                    return AbortNode(state, "Failed to write to coin database");
+                }
                 UnlinkPrunedFiles(setFilesToPrune);
+            }
             nLastWrite = nNow;
         }
         // Flush best chain related state. This can only be done if the blocks / block index write was also done.
@@ -2176,8 +2484,22 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             // Flush the chainstate (which may refer to block index entries).
             if (!pcoinsTip->Flush())
                 return AbortNode(state, "Failed to write to coin database");
+            // Indexes and wallets record the chain as flushed below, so the
+            // coins must be on disk, not just handed to the background writer.
+            if (!pcoinsdbview->WaitForPendingWrite())
+                return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
+            fSyncedSinceFlush = false;
             full_flush_completed = true;
+        } else if (fDoSync && !pcoinsTip->GetBestBlock().IsNull()) {
+            if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
+                return state.Error("out of disk space");
+            // Write the dirty coins (in the background, see CCoinsViewDB) and keep the cache.
+            // The write may not be done yet, so this does not count as a completed flush.
+            if (!pcoinsTip->Sync())
+                return AbortNode(state, "Failed to write to coin database");
+            nLastFlush = nNow;
+            fSyncedSinceFlush = true;
         }
     }
     if (full_flush_completed) {
@@ -2538,6 +2860,140 @@ void CChainState::PruneBlockIndexCandidates() {
     assert(!setBlockIndexCandidates.empty());
 }
 
+/** Number of blocks whose inputs ReadAheadBlocks() loads into pcoinsTip together. */
+static const int BLOCK_READ_AHEAD = 8;
+
+BlockReadAhead::BlockReadAhead(std::vector<std::pair<const CBlockIndex*, CDiskBlockPos>> to_read, const Consensus::Params& params, const CCoinsViewDB* coins_db)
+    : m_coins_db_writes(coins_db->GetWriteCount()), m_to_read(std::move(to_read)), m_params(params), m_coins_db(coins_db)
+{
+    m_thread = std::thread(&BlockReadAhead::Run, this);
+}
+
+BlockReadAhead::~BlockReadAhead()
+{
+    m_interrupt = true;
+    Join();
+}
+
+void BlockReadAhead::Join()
+{
+    if (m_thread.joinable()) m_thread.join();
+}
+
+void BlockReadAhead::Run()
+{
+    RenameThread("bitcoin-readahead");
+    std::vector<const CBlock*> blocks;
+    for (const auto& entry : m_to_read) {
+        if (m_interrupt) return;
+        // Not ReadBlockFromDisk(CBlock&, const CBlockIndex*, ...), which takes
+        // cs_main: the positions were looked up by the caller.
+        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        if (!ReadBlockFromDisk(*pblock, entry.second, m_params) || pblock->GetHash() != entry.first->GetBlockHash()) break;
+        // If the block passes, it is marked as checked and ConnectBlock()
+        // skips these checks. Otherwise ConnectBlock() repeats them and
+        // reports the failure.
+        CValidationState state;
+        CheckBlock(*pblock, state, m_params);
+        blocks.push_back(pblock.get());
+        m_blocks.emplace_back(entry.first, std::move(pblock));
+    }
+    if (m_interrupt || blocks.empty()) return;
+
+    m_prevouts = GetBlockInputs(blocks);
+    try {
+        m_coins_db->GetCoins(m_prevouts, m_coins);
+    } catch (const std::runtime_error& e) {
+        // The lookups are repeated while connecting, where errors are handled.
+        m_prevouts.clear();
+        m_coins.clear();
+    }
+}
+
+/**
+ * Return the block at pindex, the next one to connect towards pindexMostWork.
+ *
+ * Blocks are read in groups of up to BLOCK_READ_AHEAD. The coins spent by a
+ * group are loaded into pcoinsTip together, so the cache misses are looked up
+ * in the coin database in parallel (see CCoinsViewDB::GetCoins) instead of one
+ * at a time while connecting. While a group is being connected, a
+ * BlockReadAhead reads and checks the next one and looks up its coins in the
+ * background. Those coins are only used if the coin database was not written
+ * to since; they are not dirty, so pcoinsTip stays consistent whatever happens
+ * to the blocks.
+ *
+ * Returns nullptr if the block could not be read, in which case ConnectTip()
+ * reads it itself and reports the error.
+ */
+std::shared_ptr<const CBlock> CChainState::ReadAheadBlocks(const CChainParams& chainparams, const CBlockIndex* pindex, const CBlockIndex* pindexMostWork)
+{
+    // Blocks read ahead that are no longer next in line (after a reorg, or a
+    // failed connection) are dropped.
+    while (!m_blocks_read_ahead.empty() && m_blocks_read_ahead.front().first != pindex) {
+        m_blocks_read_ahead.pop_front();
+    }
+
+    if (m_blocks_read_ahead.empty() && m_block_read_ahead_job) {
+        int64_t nTimeStart = GetTimeMicros();
+        std::unique_ptr<BlockReadAhead> job = std::move(m_block_read_ahead_job);
+        job->Join();
+        if (!job->m_blocks.empty() && job->m_blocks.front().first == pindex) {
+            std::vector<const CBlock*> blocks;
+            for (auto& entry : job->m_blocks) {
+                blocks.push_back(entry.second.get());
+                m_blocks_read_ahead.emplace_back(entry.first, std::move(entry.second));
+            }
+            if (pcoinsdbview->GetWriteCount() == job->m_coins_db_writes && !job->m_prevouts.empty()) {
+                pcoinsTip->ImportCoins(job->m_prevouts, job->m_coins);
+            } else {
+                PrefetchBlockInputs(blocks, *pcoinsTip);
+            }
+            LogPrint(BCLog::BENCH, "  - Wait for %u blocks read ahead: %.2fms\n", (unsigned int)blocks.size(), (GetTimeMicros() - nTimeStart) * MILLI);
+        }
+    }
+
+    if (m_blocks_read_ahead.empty()) {
+        int64_t nTimeStart = GetTimeMicros();
+        std::vector<const CBlock*> blocks;
+        for (int height = pindex->nHeight; height < pindex->nHeight + BLOCK_READ_AHEAD && height <= pindexMostWork->nHeight; ++height) {
+            const CBlockIndex* pindexRead = pindexMostWork->GetAncestor(height);
+            if (!(pindexRead->nStatus & BLOCK_HAVE_DATA)) break;
+            std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+            if (!ReadBlockFromDisk(*pblockRead, pindexRead, chainparams.GetConsensus())) break;
+            blocks.push_back(pblockRead.get());
+            m_blocks_read_ahead.emplace_back(pindexRead, std::move(pblockRead));
+        }
+        PrefetchBlockInputs(blocks, *pcoinsTip);
+        LogPrint(BCLog::BENCH, "  - Read ahead %u blocks and prefetch their inputs: %.2fms\n", (unsigned int)blocks.size(), (GetTimeMicros() - nTimeStart) * MILLI);
+    }
+
+    if (m_blocks_read_ahead.empty()) return nullptr;
+
+    // Start reading the group after this one.
+    if (!m_block_read_ahead_job && pcoinsdbview) {
+        std::vector<std::pair<const CBlockIndex*, CDiskBlockPos>> to_read;
+        const int nNextHeight = m_blocks_read_ahead.back().first->nHeight + 1;
+        for (int height = nNextHeight; height < nNextHeight + BLOCK_READ_AHEAD && height <= pindexMostWork->nHeight; ++height) {
+            const CBlockIndex* pindexRead = pindexMostWork->GetAncestor(height);
+            if (!(pindexRead->nStatus & BLOCK_HAVE_DATA)) break;
+            to_read.emplace_back(pindexRead, pindexRead->GetBlockPos());
+        }
+        if (!to_read.empty()) {
+            m_block_read_ahead_job.reset(new BlockReadAhead(std::move(to_read), chainparams.GetConsensus(), pcoinsdbview.get()));
+        }
+    }
+
+    std::shared_ptr<const CBlock> pblock = std::move(m_blocks_read_ahead.front().second);
+    m_blocks_read_ahead.pop_front();
+    return pblock;
+}
+
+void CChainState::StopReadAhead()
+{
+    m_blocks_read_ahead.clear();
+    m_block_read_ahead_job.reset();
+}
+
 /**
  * Try to make some progress towards making pindexMostWork the active block.
  * pblock is either nullptr or a pointer to a CBlock corresponding to pindexMostWork.
@@ -2581,7 +3037,10 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
 
         // Connect new blocks.
         for (CBlockIndex *pindexConnect : reverse_iterate(vpindexToConnect)) {
-            if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
+            std::shared_ptr<const CBlock> pblockConnect = pindexConnect == pindexMostWork ? pblock : ReadAheadBlocks(chainparams, pindexConnect, pindexMostWork);
+            if (!ConnectTip(state, chainparams, pindexConnect, pblockConnect, connectTrace, disconnectpool)) {
+                // The blocks read ahead build on this one.
+                StopReadAhead();
                 if (state.IsInvalid()) {
                     // The block violates a consensus rule.
                     if (!state.CorruptionPossible()) {
@@ -3524,27 +3983,86 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
     return true;
 }
 
+/**
+ * Verify the scripts of a new block that extends the active tip on the script
+ * check threads, before it is connected. Only called once AcceptBlock has
+ * stored the block, so its header passed the contextual checks and its
+ * proof of work counts. Only inputs spending coins already in pcoinsTip are
+ * checked. Valid signatures are added to the signature cache, so the checks
+ * in ConnectBlock (which run under cs_main) mostly become cache hits. The
+ * results are otherwise discarded: ConnectBlock remains the one that decides
+ * validity.
+ */
+static void PreVerifyBlockSignatures(const CChainParams& chainparams, const CBlock& block, const CBlockIndex* pindex)
+{
+    if (!nScriptCheckThreads) return;
+
+    int64_t nTimeStart = GetTimeMicros();
+    std::vector<PrecomputedTransactionData> txdata;
+    std::vector<CScriptCheck> checks;
+    {
+        LOCK(cs_main);
+        // Initial block download is covered by ConnectBlock's own parallel checks
+        // (and often skipped by -assumevalid); this targets latency at the tip.
+        if (IsInitialBlockDownload()) return;
+        if (pindex->pprev != chainActive.Tip() || (pindex->nStatus & BLOCK_FAILED_MASK)) return;
+
+        const unsigned int flags = GetBlockScriptFlags(pindex, chainparams.GetConsensus());
+
+        // CScriptCheck keeps a pointer into txdata, so it must not reallocate.
+        txdata.reserve(block.vtx.size());
+        for (const auto& tx : block.vtx) {
+            if (tx->IsCoinBase()) continue;
+            txdata.emplace_back(*tx);
+            for (unsigned int i = 0; i < tx->vin.size(); i++) {
+                const Coin& coin = pcoinsTip->AccessCoin(tx->vin[i].prevout);
+                if (coin.IsSpent()) continue;
+                checks.emplace_back(coin.out, *tx, i, flags, true /* cacheStore */, &txdata.back());
+            }
+        }
+    }
+    if (checks.empty()) return;
+
+    // Must not be called with cs_main held: ConnectBlock acquires the queue's
+    // control while holding cs_main.
+    CCheckQueueControl<CBlockCheck> control(&scriptcheckqueue);
+    const size_t nChecks = checks.size();
+    AddScriptChecks(control, checks);
+    control.Wait();
+    LogPrint(BCLog::BENCH, "  - Pre-verify %u txins: %.2fms\n", (unsigned)nChecks, (GetTimeMicros() - nTimeStart) * MILLI);
+}
+
 bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool *fNewBlock)
 {
     AssertLockNotHeld(cs_main);
 
     {
         CBlockIndex *pindex = nullptr;
+        bool new_block = false;
         if (fNewBlock) *fNewBlock = false;
         CValidationState state;
         // Ensure that CheckBlock() passes before calling AcceptBlock, as
         // belt-and-suspenders.
         bool ret = CheckBlock(*pblock, state, chainparams.GetConsensus());
 
-        LOCK(cs_main);
+        {
+            LOCK(cs_main);
 
-        if (ret) {
-            // Store to disk
-            ret = g_chainstate.AcceptBlock(pblock, state, chainparams, &pindex, fForceProcessing, nullptr, fNewBlock);
+            if (ret) {
+                // Store to disk
+                ret = g_chainstate.AcceptBlock(pblock, state, chainparams, &pindex, fForceProcessing, nullptr, &new_block);
+            }
+            if (fNewBlock) *fNewBlock = new_block;
+            if (!ret) {
+                GetMainSignals().BlockChecked(*pblock, state);
+                return error("%s: AcceptBlock FAILED (%s)", __func__, FormatStateMessage(state));
+            }
         }
-        if (!ret) {
-            GetMainSignals().BlockChecked(*pblock, state);
-            return error("%s: AcceptBlock FAILED (%s)", __func__, FormatStateMessage(state));
+
+        // Not before AcceptBlock: a block whose header was not checked
+        // against the chain (e.g. its difficulty) costs nothing to make.
+        if (new_block) {
+            PreVerifyBlockSignatures(chainparams, *pblock, pindex);
         }
     }
 
@@ -4258,11 +4776,18 @@ bool RewindBlockIndex(const CChainParams& params) {
 }
 
 void CChainState::UnloadBlockIndex() {
+    StopReadAhead();
     nBlockSequenceId = 1;
     m_failed_blocks.clear();
     setBlockIndexCandidates.clear();
 }
 
+void StopBlockReadAhead()
+{
+    LOCK(cs_main);
+    g_chainstate.StopReadAhead();
+}
+
 // May NOT be used after any connections are up as much
 // of the peer-processing logic assumes a consistent
 // block index state
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the -coinstatsindex option and gettxoutsetinfo's hash_type and hash_or_height arguments.
+
+- Compare the statistics from the index with a full scan of the chainstate,
+  including for earlier blocks.
+- Check that the index follows a reorganization.
+"""
+import time
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+)
+
+SCAN_ONLY_FIELDS = ['transactions', 'disk_size']
+
+
+def index_fields(stats):
+    return {k: v for k, v in stats.items() if k not in SCAN_ONLY_FIELDS}
+
+
+class CoinStatsIndexTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.extra_args = [[], ["-coinstatsindex"]]
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def wait_for_index(self, node):
+        # The index catches up in the background after startup.
+        for _ in range(100):
+            try:
+                return node.gettxoutsetinfo('muhash')
+            except Exception:
+                time.sleep(0.1)
+        return node.gettxoutsetinfo('muhash')
+
+    def run_test(self):
+        scan_node = self.nodes[0]
+        index_node = self.nodes[1]
+
+        self.log.info("Compare the index with a full scan")
+        self.wait_for_index(index_node)
+        scan_node.sendtoaddress(scan_node.getnewaddress(), 10)
+        raw = scan_node.createrawtransaction([], [{"data": "00ff"}, {scan_node.getnewaddress(): 1}])
+        funded = scan_node.fundrawtransaction(raw)
+        scan_node.sendrawtransaction(scan_node.signrawtransactionwithwallet(funded['hex'])['hex'])
+        scan_node.generate(1)
+        self.sync_all()
+        expected = scan_node.gettxoutsetinfo('muhash')
+        assert_equal(index_node.gettxoutsetinfo('muhash'), index_fields(expected))
+        assert_equal(index_node.gettxoutsetinfo('none'), index_fields({k: v for k, v in expected.items() if k != 'muhash'}))
+        # The legacy hash still scans the chainstate.
+        assert_equal(index_node.gettxoutsetinfo(), scan_node.gettxoutsetinfo())
+
+        self.log.info("Query statistics of an earlier block")
+        height = expected['height']
+        scan_node.generate(2)
+        self.sync_all()
+        for hash_or_height in [height, expected['bestblock']]:
+            assert_equal(index_node.gettxoutsetinfo('muhash', hash_or_height), index_fields(expected))
+        assert_raises_rpc_error(-8, "Target block height", index_node.gettxoutsetinfo, 'muhash', height + 100)
+        assert_raises_rpc_error(-8, "requires -coinstatsindex", scan_node.gettxoutsetinfo, 'muhash', height)
+        assert_raises_rpc_error(-8, "requires -coinstatsindex", index_node.gettxoutsetinfo, 'hash_serialized_2', height)
+        assert_raises_rpc_error(-8, "is not a valid hash_type", index_node.gettxoutsetinfo, 'sha3')
+
+        self.log.info("Follow a reorganization")
+        tip = index_node.getbestblockhash()
+        index_node.invalidateblock(tip)
+        scan_node.invalidateblock(tip)
+        index_node.generate(2)
+        self.sync_all()
+        assert_equal(index_node.gettxoutsetinfo('muhash'), index_fields(scan_node.gettxoutsetinfo('muhash')))
+
+        self.log.info("Keep the index across restarts")
+        self.restart_node(1)
+        assert_equal(self.wait_for_index(index_node), index_fields(scan_node.gettxoutsetinfo('muhash')))
+
+
+if __name__ == '__main__':
+    CoinStatsIndexTest().main()
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the -freezecoins option.
+
+- Move the old coins to a frozen coins file at startup and check that the
+  chainstate looks the same from the outside.
+- Spend frozen coins, reorganize across the spend, and freeze again.
+- Start without the option and check that the frozen coins are kept.
+"""
+import os
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+
+
+def frozen_files(node):
+    chainstate = os.path.join(node.datadir, 'regtest', 'chainstate')
+    return sorted(f for f in os.listdir(chainstate) if f.startswith('frozen-'))
+
+
+class FreezeCoinsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        node = self.nodes[0]
+        address = node.getnewaddress()
+        node.generatetoaddress(10, address)
+        expected = node.gettxoutsetinfo()
+        assert_equal(frozen_files(node), [])
+
+        self.log.info("Freeze the coins older than 100 blocks")
+        self.restart_node(0, extra_args=['-freezecoins=100'])
+        assert_equal(frozen_files(node), ['frozen-110.dat'])
+        assert_equal(node.gettxoutsetinfo(), expected)
+
+        self.log.info("Spend frozen coins")
+        node.sendtoaddress(node.getnewaddress(), 1000)
+        tip = node.generatetoaddress(1, address)[0]
+        spent = node.gettxoutsetinfo()
+        assert spent['txouts'] != expected['txouts']
+
+        self.log.info("Restore the spent coins in a reorganization")
+        node.invalidateblock(tip)
+        assert_equal(node.gettxoutsetinfo()['hash_serialized_2'], expected['hash_serialized_2'])
+        node.reconsiderblock(tip)
+        assert_equal(node.gettxoutsetinfo(), spent)
+
+        self.log.info("Keep the frozen coins across restarts")
+        self.restart_node(0)
+        assert_equal(node.gettxoutsetinfo(), spent)
+        assert_equal(frozen_files(node), ['frozen-110.dat'])
+
+        self.log.info("Freeze more coins")
+        node.generatetoaddress(5, address)
+        expected = node.gettxoutsetinfo()
+        self.restart_node(0, extra_args=['-freezecoins=10'])
+        assert_equal(frozen_files(node), ['frozen-%d.dat' % (expected['height'] - 10)])
+        assert_equal(node.gettxoutsetinfo(), expected)
+
+
+if __name__ == '__main__':
+    FreezeCoinsTest().main()
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test dumping the UTXO set with dumptxoutset and loading it with -loadutxosnapshot.
+
+- Dump the UTXO set and check the result against gettxoutsetinfo.
+- Restart with -reindex-chainstate -loadutxosnapshot and check the loaded chainstate.
+- Check that a snapshot whose hash is not the expected one, or whose coins do
+  not match its hash, is rejected, and that the chainstate is rebuilt from the
+  blocks on the next start.
+- Interrupt loading a snapshot, and check that the partially loaded coins are
+  removed on the next start.
+"""
+import os
+import shutil
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.test_node import ErrorMatch
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+    wait_until,
+)
+
+# Offset of the serialized hash in the snapshot metadata:
+# magic (4), version (2), base block hash (32), coins count (8).
+HASH_SERIALIZED_OFFSET = 46
+
+
+def utxo_set_info(node):
+    # The field 'disk_size' is non-deterministic and can thus not be
+    # compared between chainstates.
+    res = node.gettxoutsetinfo()
+    del res['disk_size']
+    return res
+
+
+def flip_byte(path, offset):
+    with open(path, 'r+b') as f:
+        f.seek(offset)
+        byte = f.read(1)
+        f.seek(offset)
+        f.write(bytes([byte[0] ^ 0xff]))
+
+
+class UTXOSnapshotTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generatetoaddress(10, node.get_deterministic_priv_key().address)
+        expected = utxo_set_info(node)
+
+        self.log.info("Dump the UTXO set")
+        res = node.dumptxoutset('utxo.dat')
+        assert_equal(res['coins_written'], expected['txouts'])
+        assert_equal(res['base_hash'], expected['bestblock'])
+        assert_equal(res['base_height'], expected['height'])
+        assert_equal(res['hash_serialized_2'], expected['hash_serialized_2'])
+        snapshot_path = res['path']
+        assert os.path.isfile(snapshot_path)
+        assert not os.path.exists(snapshot_path + '.incomplete')
+        assert_raises_rpc_error(-8, "already exists", node.dumptxoutset, 'utxo.dat')
+
+        self.log.info("Load the snapshot into an empty chainstate")
+        snapshot_arg = '-loadutxosnapshot={}:{}'.format(snapshot_path, res['hash_serialized_2'])
+        self.restart_node(0, extra_args=['-reindex-chainstate', snapshot_arg])
+        assert_equal(node.getblockcount(), expected['height'])
+        assert_equal(utxo_set_info(node), expected)
+
+        self.log.info("Connect blocks on top of the loaded snapshot")
+        node.generatetoaddress(2, node.get_deterministic_priv_key().address)
+        assert_equal(node.gettxoutsetinfo()['height'], expected['height'] + 2)
+        expected = utxo_set_info(node)
+        res = node.dumptxoutset('utxo2.dat')
+        self.stop_node(0)
+
+        self.log.info("Require the hash of the snapshot")
+        node.assert_start_raises_init_error(['-reindex-chainstate', '-loadutxosnapshot=' + res['path']], "must be of the form <file>:<hash>", match=ErrorMatch.PARTIAL_REGEX)
+
+        self.log.info("Reject a snapshot whose hash is not the expected one")
+        bad_path = os.path.join(node.datadir, 'bad_utxo.dat')
+        shutil.copyfile(res['path'], bad_path)
+        flip_byte(bad_path, HASH_SERIALIZED_OFFSET)
+        node.assert_start_raises_init_error(['-reindex-chainstate', '-loadutxosnapshot={}:{}'.format(bad_path, res['hash_serialized_2'])], "does not match the expected", match=ErrorMatch.PARTIAL_REGEX)
+        self.start_node(0)
+        self.check_rebuilt(expected)
+
+        self.log.info("Reject a snapshot whose coins do not match its hash")
+        shutil.copyfile(res['path'], bad_path)
+        flip_byte(bad_path, os.path.getsize(bad_path) - 1)
+        self.stop_node(0)
+        node.assert_start_raises_init_error(['-reindex-chainstate', '-loadutxosnapshot={}:{}'.format(bad_path, res['hash_serialized_2'])], "coins hash to", match=ErrorMatch.PARTIAL_REGEX)
+        self.start_node(0)
+        self.check_rebuilt(expected)
+
+        self.log.info("Interrupt loading a snapshot")
+        self.stop_node(0)
+        # Simulate a crash after the first batch of coins is written.
+        node.start(extra_args=['-reindex-chainstate', '-loadutxosnapshot={}:{}'.format(res['path'], res['hash_serialized_2']), '-dbcrashratio=1', '-dbbatchsize=1'])
+        node.wait_until_stopped()
+        with node.assert_debug_log(["Removing the coins of an interrupted UTXO snapshot load"]):
+            self.start_node(0)
+        self.check_rebuilt(expected)
+
+    def check_rebuilt(self, expected):
+        """Check that the chainstate is rebuilt from the blocks after a failed load."""
+        node = self.nodes[0]
+        wait_until(lambda: node.getblockcount() == expected['height'])
+        assert_equal(utxo_set_info(node), expected)
+
+
+if __name__ == '__main__':
+    UTXOSnapshotTest().main()
@@ -177,6 +177,9 @@ BASE_SCRIPTS = [
     'p2p_unrequested_blocks.py',
     'feature_includeconf.py',
     'rpc_scantxoutset.py',
+    'feature_utxo_snapshot.py',
+    'feature_coinstatsindex.py',
+    'feature_freezecoins.py',
     'feature_logging.py',
     'p2p_node_network_limited.py',
     'feature_blocksdir.py',